@@ -0,0 +1,35 @@
+#ifndef BUILD_PROFILE_H
+#define BUILD_PROFILE_H
+
+//
+// ビルドプロファイルごとの機能の有無
+//
+// platformio.ini の各環境の build_flags で -D して切り替える。指定が無い場合は全て有効(lab相当)になる。
+//
+// production : 製品用。デバッグページとTRACEログを含まない (フラッシュ/RAMとループの時間が最小)
+// diagnostic : 不具合の調査用。productionにダッシュボード、テレメトリと長いログ履歴を加える
+// lab        : 開発用。全てのページとTRACEログを含む
+//
+// ログのレベル(LOG_LEVEL_MIN)とログページの行数(UI_LOG_ROWS)も、プロファイルごとに指定する。
+//
+
+#ifndef BUILD_PROFILE
+#define BUILD_PROFILE "lab"  // About画面に表示するプロファイル名
+#endif
+
+// デバッグ系のページ (デバッグ設定/デバッグ/PCFDD/スケジューラ/I2C) と、各モジュールからそれらへの表示
+#ifndef FEATURE_DEBUG_PAGES
+#define FEATURE_DEBUG_PAGES 1
+#endif
+
+// グラフのダッシュボードと、そのための計測値の記録タスク
+#ifndef FEATURE_DASHBOARD
+#define FEATURE_DASHBOARD 1
+#endif
+
+// SWIO(SDI)のデバッグリンクへのテレメトリ (src/telemetry/telemetry.h)
+#ifndef FEATURE_TELEMETRY
+#define FEATURE_TELEMETRY 1
+#endif
+
+#endif  // BUILD_PROFILE_H
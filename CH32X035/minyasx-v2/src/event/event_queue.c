@@ -0,0 +1,95 @@
+#include "event/event_queue.h"
+
+#include "build_profile.h"
+#include "log/log_ring.h"
+#include "pcfdd/pcfdd_control.h"
+#include "telemetry/telemetry.h"
+#include "timebase/timebase.h"
+
+// コンパイラによる順序の入れ替えを防ぐ (シングルコアなのでこれで十分)
+#define EVENT_BARRIER() __asm__ volatile("" ::: "memory")
+
+#define EVENT_QUEUE_MASK (EVENT_QUEUE_SIZE - 1)
+
+static event_t event_buf[EVENT_QUEUE_SIZE];
+static volatile uint8_t event_head = 0;  // 次に書き込む位置 (Producerのみが更新)
+static volatile uint8_t event_tail = 0;  // 次に読み出す位置 (Consumerのみが更新)
+
+static event_stats_t event_stats;
+
+bool event_post(event_type_t type, uint8_t drive, uint16_t arg) {
+    uint8_t head = event_head;
+    uint8_t used = (uint8_t)(head - event_tail);
+    if (used >= EVENT_QUEUE_SIZE) {
+        // キューあふれ
+        event_stats.dropped++;
+        if (type < EVENT_TYPE_MAX) {
+            event_stats.dropped_by_type[type]++;
+        }
+        return false;
+    }
+    event_t* ev = &event_buf[head & EVENT_QUEUE_MASK];
+    ev->timestamp = time_us();
+    ev->type = type;
+    ev->drive = drive;
+    ev->arg = arg;
+    // 中身を書き終えてからheadを進める
+    EVENT_BARRIER();
+    event_head = head + 1;
+
+    event_stats.posted++;
+    if (used + 1 > event_stats.high_water) {
+        event_stats.high_water = used + 1;
+    }
+    return true;
+}
+
+bool event_pop(event_t* ev) {
+    uint8_t tail = event_tail;
+    if (tail == event_head) {
+        return false;  // 空
+    }
+    EVENT_BARRIER();
+    *ev = event_buf[tail & EVENT_QUEUE_MASK];
+    // 読み出し終えてからtailを進める
+    EVENT_BARRIER();
+    event_tail = tail + 1;
+    return true;
+}
+
+void event_dispatch(minyasx_context_t* ctx) {
+    event_t ev;
+    while (event_pop(&ev)) {
+        event_stats.dispatched++;
+        LOG_TRACE("EV %s D%d %x\n", event_type_to_string(ev.type), ev.drive, ev.arg);
+#if FEATURE_TELEMETRY
+        telemetry_event(&ev);
+#endif
+        pcfdd_handle_event(ctx, &ev);
+    }
+}
+
+const event_stats_t* event_get_stats(void) {
+    return &event_stats;
+}
+
+const char* event_type_to_string(event_type_t type) {
+    switch (type) {
+    case EVENT_DRIVE_SELECT:
+        return "SEL";
+    case EVENT_DRIVE_DESELECT:
+        return "DESEL";
+    case EVENT_EJECT_REQUEST:
+        return "EJECT";
+    case EVENT_MASK_CHANGE:
+        return "MASK";
+    case EVENT_DISK_CHANGE:
+        return "DSKCHG";
+    case EVENT_INDEX_TIMEOUT:
+        return "IDXTO";
+    case EVENT_SPEED_CHANGE:
+        return "SPEED";
+    default:
+        return "???";
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "minyasx.h"
+
+//
+// 割り込みルーチン → メインループ のイベントキュー
+//
+// 割り込みルーチンは drive_status_t などの共有状態を直接書き換えず、
+// タイムスタンプ付きのイベントをこのキューに積むだけにする。
+// 状態の変更はメインループの event_dispatch() で、発生順に行う。
+//
+// キューは Single Producer / Single Consumer のロックフリーリングバッファで、
+// Producer は「割り込みコンテキスト」、Consumer はメインループとする。
+// イベントを積む割り込み(EXTI7_0, SysTick, TIM3)はいずれも同じ優先度で互いにネストしないので、
+// Producer は1つとみなせる。優先度を上げている EXTI15_8 からは event_post() を呼ばないこと。
+//
+
+typedef enum {
+    EVENT_NONE = 0,
+    EVENT_DRIVE_SELECT,    // X68000側のDRIVE_SELECTがアサートされた
+    EVENT_DRIVE_DESELECT,  // X68000側のDRIVE_SELECTがディアサートされた
+    EVENT_EJECT_REQUEST,   // X68000からのEJECT要求 (OPTION_SELECT時にEJECTがLow)
+    EVENT_MASK_CHANGE,     // EJECT_MASK / LED_BLINK の変化 (arg: EVENT_MASK_xxx)
+    EVENT_DISK_CHANGE,     // PC FDDのDISK_CHANGEが一定時間継続した
+    EVENT_INDEX_TIMEOUT,   // INDEXパルスが一定時間来なかった
+    EVENT_SPEED_CHANGE,    // 9SCDRV方式の回転数切り替え (arg: fdd_rpm_mode_t)
+    EVENT_TYPE_MAX,
+} event_type_t;
+
+// EVENT_MASK_CHANGE の arg のビット
+#define EVENT_MASK_EJECT_MASKED (1 << 0)
+#define EVENT_MASK_LED_BLINK (1 << 1)
+
+typedef struct {
+    uint32_t timestamp;  // 発生時刻 (time_us(), usec)
+    uint8_t type;        // event_type_t
+    uint8_t drive;       // 0=ドライブA, 1=ドライブB
+    uint16_t arg;        // イベントごとの引数
+} event_t;
+
+// キューの段数 (2のべき乗にすること)
+#define EVENT_QUEUE_SIZE 32
+
+typedef struct {
+    uint32_t posted;                           // 積まれたイベント数
+    uint32_t dispatched;                       // 処理したイベント数
+    uint32_t dropped;                          // キューあふれで捨てたイベント数
+    uint32_t dropped_by_type[EVENT_TYPE_MAX];  // 種類別の破棄数
+    uint8_t high_water;                        // キューの最大使用段数
+} event_stats_t;
+
+/**
+ * イベントを積みます (割り込みルーチンから呼ぶ)
+ * キューが一杯の場合は捨ててfalseを返します
+ */
+bool event_post(event_type_t type, uint8_t drive, uint16_t arg);
+
+/**
+ * イベントを1つ取り出します (メインループから呼ぶ)
+ * キューが空の場合はfalseを返します
+ */
+bool event_pop(event_t* ev);
+
+/**
+ * キューに溜まったイベントをすべて取り出し、発生順に処理します
+ */
+void event_dispatch(minyasx_context_t* ctx);
+
+const event_stats_t* event_get_stats(void);
+
+const char* event_type_to_string(event_type_t type);
+
+#endif  // EVENT_QUEUE_H
@@ -2,7 +2,7 @@
 #define _FUNCONFIG_H
 
 #define FUNCONF_USE_5V_VDD 1
-// #define FUNCONF_USE_DEBUGPRINTF 1
+#define FUNCONF_USE_DEBUGPRINTF 0  // FEATURE_TELEMETRY と同時には使えない (どちらもDMDATA0/1を使う)
 // #define FUNCONF_DEBUGPRINTF_TIMEOUT (1<<31) // Wait for a very very long time.
 #define FUNCONF_SYSTICK_USE_HCLK 1  // Systick = 48MHz
 
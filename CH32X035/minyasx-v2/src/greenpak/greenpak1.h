@@ -2,4 +2,6 @@
 #include <stdint.h>
 #define GREENPAK1_BASE 0x0000
 #define GREENPAK1_SIZE 256
+#define GREENPAK1_VERIFY_SIZE 240
+#define GREENPAK1_STAMP 0x88A5
 extern const uint8_t GREENPAK1_IMAGE[GREENPAK1_SIZE];
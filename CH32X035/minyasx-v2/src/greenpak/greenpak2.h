@@ -2,4 +2,6 @@
 #include <stdint.h>
 #define GREENPAK2_BASE 0x0000
 #define GREENPAK2_SIZE 256
+#define GREENPAK2_VERIFY_SIZE 240
+#define GREENPAK2_STAMP 0x0E61
 extern const uint8_t GREENPAK2_IMAGE[GREENPAK2_SIZE];
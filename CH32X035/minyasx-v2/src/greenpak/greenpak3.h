@@ -2,4 +2,6 @@
 #include <stdint.h>
 #define GREENPAK3_BASE 0x0000
 #define GREENPAK3_SIZE 256
+#define GREENPAK3_VERIFY_SIZE 240
+#define GREENPAK3_STAMP 0x47BC
 extern const uint8_t GREENPAK3_IMAGE[GREENPAK3_SIZE];
@@ -2,4 +2,6 @@
 #include <stdint.h>
 #define GREENPAK4_BASE 0x0000
 #define GREENPAK4_SIZE 256
+#define GREENPAK4_VERIFY_SIZE 240
+#define GREENPAK4_STAMP 0x9AE7
 extern const uint8_t GREENPAK4_IMAGE[GREENPAK4_SIZE];
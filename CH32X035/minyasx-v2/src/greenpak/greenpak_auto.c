@@ -9,50 +9,46 @@
 #include "greenpak/greenpak4.h"
 #include "greenpak_control.h"
 #include "greenpak_program.h"
+#include "i2c/i2c_async.h"
 #include "i2c/i2c_ch32x035.h"
+#include "timebase/timebase.h"
 #include "ui/ui_control.h"
+#include "wdt/wdt_control.h"
 
-#define GP_PAGE 16   // 1回の書込みチャンク（必要なら調整）
-#define CMP_CHUNK 1  // 比較時の読出しチャンク
+#define CMP_CHUNK 80             // 比較時の読出しチャンク (240バイトを3回のバーストで読む)
+#define GP_READY_TIMEOUT_MS 500  // 書換え後のリセットからACKが返るまでの待ち上限
 
 // 画像テーブル（サイズ0はスキップ）
+// verify_size はビルド時に tools/hex4_to_greenpak.py が計算した値
 typedef struct {
     uint16_t base;
     uint16_t size;
     const uint8_t *image;
+    uint16_t verify_size;  // 検証するバイト数 (末尾16バイトは除く)
+    uint16_t stamp;        // イメージ全体のハッシュ (EEPROMに記録して起動時に比較する)
 } gp_img_t;
 
 static const gp_img_t gp_img[4] = {
-    {GREENPAK1_BASE, GREENPAK1_SIZE, GREENPAK1_IMAGE},
-    {GREENPAK2_BASE, GREENPAK2_SIZE, GREENPAK2_IMAGE},
-    {GREENPAK3_BASE, GREENPAK3_SIZE, GREENPAK3_IMAGE},
-    {GREENPAK4_BASE, GREENPAK4_SIZE, GREENPAK4_IMAGE},
+    {GREENPAK1_BASE, GREENPAK1_SIZE, GREENPAK1_IMAGE, GREENPAK1_VERIFY_SIZE, GREENPAK1_STAMP},
+    {GREENPAK2_BASE, GREENPAK2_SIZE, GREENPAK2_IMAGE, GREENPAK2_VERIFY_SIZE, GREENPAK2_STAMP},
+    {GREENPAK3_BASE, GREENPAK3_SIZE, GREENPAK3_IMAGE, GREENPAK3_VERIFY_SIZE, GREENPAK3_STAMP},
+    {GREENPAK4_BASE, GREENPAK4_SIZE, GREENPAK4_IMAGE, GREENPAK4_VERIFY_SIZE, GREENPAK4_STAMP},
 };
 
-// 連続書込み（ページ分割, STOPはwriteBufferが発行）
-void gp_write_seq(uint8_t addr7, uint16_t start, const uint8_t *data, uint16_t len) {
-    uint16_t off = 0;
-    while (off < len) {
-        uint16_t n = len - off;
-        if (n > GP_PAGE) n = GP_PAGE;
+// 次回起動時の全数検証の要求 (ソフトウェアリセットを跨いで残すため.noinitに置く)
+#define GP_FULL_VERIFY_MAGIC 0x47505646  // 'GPVF'
+static uint32_t gp_full_verify_req __attribute__((section(".noinit")));
 
-        I2C_start((addr7 << 1) | 0);        // START + SLA+W（8bitアドレス）:contentReference[oaicite:9]{index=9}
-        I2C_write((uint8_t)(start + off));  // 内部アドレス（多くのGreenPAKはオートインクリメント）:contentReference[oaicite:10]{index=10}
-        I2C_writeBuffer((uint8_t *)&data[off], n);  // データ送出→STOPまで:contentReference[oaicite:11]{index=11}
-
-        off += n;
-    }
-}
-
-// 連続読出し（STOPはreadBufferが発行）
-static void gp_read_seq(uint8_t nvm_addr7, uint16_t start, uint8_t *dst, uint16_t len) {
-    I2C_start((nvm_addr7 << 1) | 0);  // 書きモードで内部アドレスをセット
-    I2C_write((uint8_t)start);
-    I2C_restart((nvm_addr7 << 1) | 1);  // 再スタートして読出しへ切替:contentReference[oaicite:12]{index=12}
-    I2C_readBuffer(dst, len);           // 連続受信→最後にSTOP:contentReference[oaicite:13]{index=13}
+// 連続読出し（戻り値は i2c_err_t）
+static int gp_read_seq(uint8_t nvm_addr7, uint16_t start, uint8_t *dst, uint16_t len) {
+    // 書きモードで内部アドレスをセットし、再スタートして読出しへ切替
+    uint8_t reg = (uint8_t)start;
+    return I2C_transfer(nvm_addr7, &reg, 1, dst, len);
 }
 
-static int gp_compare_image(uint8_t addr7, uint16_t base, const uint8_t *img, uint16_t size) {
+// NVMをバーストで読み、イメージと比較する (違いが見つかった所で打ち切る)
+static int gp_compare_image(uint8_t addr7, const gp_img_t *img) {
+    uint16_t size = img->verify_size;
     if (size == 0) return 1;  // 空なら一致扱い
 
     uint8_t nvm_addr7 = (uint8_t)((addr7 & 0xfc) | 0x02);  // NVMアドレスに変換 (addrは0x08,0x10,0x18,0x20,0x28のいずれか)
@@ -61,11 +57,15 @@ static int gp_compare_image(uint8_t addr7, uint16_t base, const uint8_t *img, ui
     while (done < size) {
         uint16_t n = size - done;
         if (n > CMP_CHUNK) n = CMP_CHUNK;
-        gp_read_seq(nvm_addr7, base + done, buf, n);
-        if (memcmp(buf, &img[done], n) != 0) {
-            ui_print(UI_PAGE_LOG, "mismatch at ");
-            ui_printD(UI_PAGE_LOG, base + done);
-            ui_write(UI_PAGE_LOG, '\n');
+        if (gp_read_seq(nvm_addr7, img->base + done, buf, n) != I2C_ERR_NONE) {
+            ui_printf(UI_PAGE_LOG, "read err at %d\n", img->base + done);
+            return 0;  // 読めなければ不一致扱い
+        }
+        if (memcmp(buf, &img->image[done], n) != 0) {
+            // ログ用に最初に違っていた位置を探す
+            int i = 0;
+            while (buf[i] == img->image[done + i]) i++;
+            ui_printf(UI_PAGE_LOG, "diff at %d\n", img->base + done + i);
             return 0;  // 不一致
         }
         done += n;
@@ -87,14 +87,57 @@ void greenpak_force_program_verify(uint8_t addr, uint8_t unit) {
     ui_print(UI_PAGE_LOG, "  @0x");
     ui_printH(UI_PAGE_LOG, addr);
     ui_write(UI_PAGE_LOG, '\n');
-    gp_program_with_erase(addr, gp_img[unit].base, gp_img[unit].image, gp_img[unit].size);
+    int pages = gp_program_with_erase(addr, gp_img[unit].base, gp_img[unit].image, gp_img[unit].size);
+    if (!gp_wait_ready(gp_target_addr[unit], GP_READY_TIMEOUT_MS)) {
+        ui_print(UI_PAGE_LOG, "no ack ");
+    } else if (pages >= 0) {
+        gp_stamp_write(gp_target_addr[unit], gp_img[unit].stamp);
+    }
     ui_print(UI_PAGE_LOG, "done");
     return;
 }
 
+void greenpak_request_full_verify(void) {
+    gp_full_verify_req = GP_FULL_VERIFY_MAGIC;
+}
+
+int greenpak_verify_all(void) {
+    int ng = 0;
+    for (int i = 0; i < 4; i++) {
+        if (gp_img[i].size == 0) continue;
+        if (!I2C_probe(gp_target_addr[i]) || !gp_compare_image(gp_target_addr[i], &gp_img[i])) {
+            ui_printf(UI_PAGE_LOG, "GP%d verify NG\n", i + 1);
+            ng++;
+            // 電源を切ると.noinitの要求は消えるので、スタンプも消して次回の起動で必ず全数検証させる
+            if (!gp_stamp_clear(gp_target_addr[i])) {
+                ui_printf(UI_PAGE_LOG, "stamp clr NG:%d\n", i + 1);
+            }
+        }
+    }
+    if (ng) {
+        // 書き換えは起動時にしかできないので、次回の起動で全数検証→書き換えさせる
+        greenpak_request_full_verify();
+    }
+    return ng;
+}
+
+// スタンプが今のイメージと一致していれば、NVMの検証を省略できる
+static int gp_stamp_matches(int unit) {
+    uint16_t stamp;
+    return gp_stamp_read(gp_target_addr[unit], &stamp) && stamp == gp_img[unit].stamp;
+}
+
 void greenpak_autoprogram_verify(void) {
+    uint32_t start_ms = time_ms();
     ui_clear(UI_PAGE_DEBUG);
 
+    // 要求があった時と、ウォッチドッグでリセットされた時はスタンプを信用せず全数検証する
+    bool full = (gp_full_verify_req == GP_FULL_VERIFY_MAGIC) || wdt_get_info()->wdt_reset;
+    gp_full_verify_req = 0;
+    if (full) {
+        ui_print(UI_PAGE_LOG, "GP full verify\n");
+    }
+
     // まず既定の最終配置（0x12, 0x1A, 0x22, 0x2A）と 0x0A（作業用）をスキャン
     int present[4] = {
         I2C_probe(gp_target_addr[0]),
@@ -131,7 +174,6 @@ void greenpak_autoprogram_verify(void) {
         ui_print(UI_PAGE_LOG, "clr ");
     }
     ui_write(UI_PAGE_LOG, '\n');
-    Delay_Ms(1500);
 
     // すべて見えている場合でも「差分があれば上書き」する
     for (;;) {
@@ -141,7 +183,12 @@ void greenpak_autoprogram_verify(void) {
         // 居るものは verify→差分があれば上書き（最終番地側へ書く）
         for (int i = 0; i < 4; i++) {
             if (present[i] && gp_img[i].size > 0) {
-                int same = gp_compare_image(gp_target_addr[i], gp_img[i].base, gp_img[i].image, gp_img[i].size - 0x10);
+                if (!full && gp_stamp_matches(i)) {
+                    // スタンプだけ読んで済ませる (前回書き込んだイメージから変わっていない)
+                    ui_printf(UI_PAGE_LOG, "firm is ok:%d (stamp)\n", i + 1);
+                    continue;
+                }
+                int same = gp_compare_image(gp_target_addr[i], &gp_img[i]);
                 if (same) {
                     ui_print(UI_PAGE_LOG, "firm is ok:");
                     ui_printD(UI_PAGE_LOG, i + 1);
@@ -150,15 +197,21 @@ void greenpak_autoprogram_verify(void) {
                     ui_print(UI_PAGE_LOG, "reprogramming:");
                     ui_printD(UI_PAGE_LOG, i + 1);
                     ui_write(UI_PAGE_LOG, '\n');
-                    gp_program_with_erase(gp_target_addr[i], gp_img[i].base, gp_img[i].image, gp_img[i].size);
+                    int pages = gp_program_with_erase(gp_target_addr[i], gp_img[i].base, gp_img[i].image, gp_img[i].size);
+                    same = gp_wait_ready(gp_target_addr[i], GP_READY_TIMEOUT_MS) && (pages >= 0);
                     ui_print(UI_PAGE_LOG, "done");
                     ui_write(UI_PAGE_LOG, '\n');
                 }
+                // 次回からはスタンプだけで判断できるように記録しておく (一致していれば書かない)
+                if (same && !gp_stamp_matches(i) && !gp_stamp_write(gp_target_addr[i], gp_img[i].stamp)) {
+                    ui_printf(UI_PAGE_LOG, "stamp NG:%d\n", i + 1);
+                }
             }
         }
 
         if (all_seen) {
             // 全員在席＋必要なら上書き済み → 完了
+            ui_printf(UI_PAGE_LOG, "GP verify %dms\n", (int)time_elapsed(time_ms(), start_ms));
             return;
         }
 
@@ -197,8 +250,10 @@ void greenpak_autoprogram_verify(void) {
             ui_write(UI_PAGE_LOG, '\n');
         }
 
-        // 再スキャン（当該ICが最終番地に現れるはず）
-        present[target] = I2C_probe(gp_target_addr[target]);
+        // 再スキャン（リセット後、当該ICが最終番地に現れるのを待つ）
+        present[target] = gp_wait_ready(gp_target_addr[target], GP_READY_TIMEOUT_MS);
+        // 新しく書いたICは次のループで全数検証してからスタンプを記録する
+        full = true;
         // 次ループへ
     }
 }
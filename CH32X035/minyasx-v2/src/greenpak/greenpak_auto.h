@@ -7,4 +7,16 @@ void greenpak_force_program_verify(uint8_t addr, uint8_t unit);
 
 void greenpak_autoprogram_verify();
 
+/**
+ * 次回の起動時に、スタンプを使わずNVMを全数検証するように要求します
+ * (ソフトウェアリセットでは残り、電源を切ると消えます)
+ */
+void greenpak_request_full_verify(void);
+
+/**
+ * 最終番地にいる全GreenPAKのNVMを今すぐ検証し、不一致の台数を返します
+ * 不一致だったGreenPAKはEEPROMのスタンプを消すので、電源を切っても次回の起動時に全数検証→書き換えが行われます
+ */
+int greenpak_verify_all(void);
+
 #endif  // GREENPAK_AUTO_H
\ No newline at end of file
@@ -1,7 +1,12 @@
 #include "greenpak_control.h"
 
 #include <stdint.h>
+#include <string.h>
 
+#include "build_profile.h"
+#include "i2c/i2c_profile.h"
+#include "i2c/i2c_stats.h"
+#include "timebase/timebase.h"
 #include "ui/ui_control.h"
 
 // GreenPAKのI2Cアドレス（7bit）
@@ -9,25 +14,23 @@
 const uint8_t gp_target_addr_cleared = 0x01;  // クリア済み
 const uint8_t gp_target_addr_default = 0x08;  // 作業用
 const uint8_t gp_target_addr[4] = {0x10, 0x18, 0x20, 0x28};
-static uint8_t gp_virtual_input_cache[4] = {0, 0, 0, 0};  // 仮想入力キャッシュ
 
 uint8_t gp_reg_get(uint8_t addr7, uint8_t reg) {
     uint8_t reg_addr7 = (uint8_t)((addr7 & 0xfc) + 1);  // 0x00を使わないために+1する
-    uint8_t val;
-    I2C_start((reg_addr7 << 1) | 0);    // SLA+W  :contentReference[oaicite:3]{index=3}
-    I2C_write(reg);                     // レジスタ番号
-    I2C_restart((reg_addr7 << 1) | 1);  // SLA+R
-    val = I2C_read(0);                  // NACKで1バイト読む
-    I2C_stop();                         // STOP   :contentReference[oaicite:7]{index=7}
+    uint8_t val = 0;
+    I2C_transfer(reg_addr7, &reg, 1, &val, 1);  // レジスタ番号を書いてから1バイト読む
     return val;
 }
 
+int gp_reg_read_burst(uint8_t addr7, uint8_t reg, uint8_t *buf, uint16_t len) {
+    uint8_t reg_addr7 = (uint8_t)((addr7 & 0xfc) + 1);  // 0x00を使わないために+1する
+    return I2C_transfer(reg_addr7, &reg, 1, buf, len);
+}
+
 void gp_reg_set(uint8_t addr7, uint8_t reg, uint8_t val) {
     uint8_t reg_addr7 = (uint8_t)((addr7 & 0xfc) + 1);  // 0x00を使わないために+1する
-    I2C_start((reg_addr7 << 1) | 0);                    // SLA+W  :contentReference[oaicite:1]{index=1}
-    I2C_write(reg);                                     // レジスタ番号
-    I2C_write(val);                                     // 書き込みデータ
-    I2C_stop();                                         // STOP   :contentReference[oaicite:2]{index=2}
+    uint8_t buf[2] = {reg, val};                        // レジスタ番号, 書き込みデータ
+    I2C_transfer(reg_addr7, buf, 2, NULL, 0);
 }
 
 uint8_t gp_addr_w(uint8_t addr7) {
@@ -38,6 +41,7 @@ uint8_t gp_addr_r(uint8_t addr7) {
     return (addr7 << 1) | 1;
 }
 
+#if FEATURE_DEBUG_PAGES
 // nibble→HEX
 static inline char hex1(uint8_t v) {
     v &= 0xF;
@@ -100,10 +104,8 @@ void greenpak_dump_oled_with_addr(uint8_t addr) {
     uint8_t nvm_addr7 = (addr & 0xfc) | 0x02;  // NVMアドレスに変換 (addrは0x08,0x10,0x18,0x20,0x28のいずれか)
 
     // --- GreenPAK(0x0A) 先頭から256Bを読み出し ---
-    I2C_start(gp_addr_w(nvm_addr7));    // 書き込み  :contentReference[oaicite:10]{index=10}
-    I2C_write(0x00);                    // 内部アドレス=0x00  :contentReference[oaicite:11]{index=11}
-    I2C_restart(gp_addr_r(nvm_addr7));  // リスタートで読み出しに切替  :contentReference[oaicite:12]{index=12}
-    I2C_readBuffer(buf, 256);           // 読み終わると I2C_stop() が呼ばれる  :contentReference[oaicite:13]{index=13}
+    const uint8_t start = 0x00;                    // 内部アドレス=0x00
+    I2C_transfer(nvm_addr7, &start, 1, buf, 256);  // リスタートで読み出しに切替 (DMAで受信)
 
     // --- 4ページを交互に表示（64Bずつ） ---
     ui_clear(UI_PAGE_DEBUG);
@@ -122,10 +124,180 @@ void greenpak_dump_oled_with_addr(uint8_t addr) {
     oled_dump_page(buf, nvm_addr7, 0xC0);  // 0xC0..0xFF
     Delay_Ms(1000);
 }
+#endif  // FEATURE_DEBUG_PAGES
+
+//
+// レジスタのシャドウ (GP_SHADOW_BASE..GP_SHADOW_BASE+GP_SHADOW_SIZE-1)
+//
+typedef struct {
+    uint8_t reg[GP_SHADOW_SIZE];  // 最後に書いた(書く予定の)値
+    uint16_t valid;               // デバイスと一致していることが分かっているレジスタ
+    uint16_t dirty;               // まだデバイスに書いていないレジスタ
+} gp_shadow_t;
+
+static gp_shadow_t gp_shadow[4];
+static gp_shadow_stats_t gp_shadow_stats;
+
+#define GP_VIN_IDX (GP_REG_VIRTUAL_INPUT - GP_SHADOW_BASE)
+#define GP_VIN_BIT (1 << GP_VIN_IDX)
+
+//
+// Virtual Input(0x7a)の書き込み
+// X68000から見える信号(DISK_IN, READYなど)なので、ユニットごとの専用の記述子でURGENTとして積む。
+// 割り込みルーチンからも積めるように、キューで待っている間は値だけを差し替え、
+// 実行中に来た値は完了コールバックで積み直す。
+//
+typedef struct {
+    i2c_xfer_t xfer;
+    uint8_t buf[2];          // レジスタ番号, 値
+    volatile uint8_t next;   // 実行中に来た次の値
+    volatile bool has_next;  // nextが有効
+} gp_vin_writer_t;
+
+static gp_vin_writer_t gp_vin_writer[4];
+
+// 完了コールバック (I2C割り込みのコンテキスト)
+static void gp_vin_done(i2c_xfer_t *x) {
+    int unit = (int)(intptr_t)x->arg;
+    gp_vin_writer_t *w = &gp_vin_writer[unit];
+    if (x->status == I2C_XFER_DONE) {
+        gp_shadow_stats.bursts++;
+        gp_shadow_stats.bytes++;
+    } else {
+        // 書けなかった場合は、次のflushで書き直す
+        gp_shadow[unit].valid &= ~GP_VIN_BIT;
+        gp_shadow[unit].dirty |= GP_VIN_BIT;
+        gp_shadow_stats.errors++;
+    }
+    if (w->has_next) {
+        w->has_next = false;
+        w->buf[1] = w->next;
+        i2c_submit(x);
+    }
+}
+
+// Virtual Inputの書き込みを積む (割り込み禁止中に呼ぶこと)
+static void gp_vin_post_locked(int unit, uint8_t val) {
+    gp_vin_writer_t *w = &gp_vin_writer[unit];
+    if (w->xfer.status == I2C_XFER_BUSY) {
+        // 送信中なので、終わってから積み直す
+        w->next = val;
+        w->has_next = true;
+        return;
+    }
+    w->buf[1] = val;
+    if (w->xfer.status == I2C_XFER_QUEUED) {
+        // まだ開始していないので、値の差し替えだけでよい
+        return;
+    }
+    w->buf[0] = GP_REG_VIRTUAL_INPUT;
+    w->xfer.addr7 = (uint8_t)((gp_target_addr[unit] & 0xfc) + 1);  // 0x00を使わないために+1する
+    w->xfer.wbuf = w->buf;
+    w->xfer.wlen = 2;
+    w->xfer.rbuf = NULL;
+    w->xfer.rlen = 0;
+    w->xfer.callback = gp_vin_done;
+    w->xfer.arg = (void *)(intptr_t)unit;
+    w->xfer.prio = I2C_PRIO_URGENT;
+    w->xfer.cls = I2C_CLASS_GP_VIN;
+    i2c_submit(&w->xfer);
+}
+
+// Virtual Inputの書き込みが終わるのを待つ
+static void gp_vin_wait(int unit) {
+    gp_vin_writer_t *w = &gp_vin_writer[unit];
+    while (i2c_xfer_pending(&w->xfer) || w->has_next) {
+        // 止まったトランザクションは打ち切られるので、ここで待ち続けることはない
+        i2c_async_check_timeout();
+    }
+}
+
+static inline bool gp_shadow_in_range(int unit, uint8_t reg) {
+    return unit >= 0 && unit < 4 && reg >= GP_SHADOW_BASE && reg < GP_SHADOW_BASE + GP_SHADOW_SIZE;
+}
+
+void gp_shadow_write(int unit, uint8_t reg, uint8_t val) {
+    if (!gp_shadow_in_range(unit, reg)) return;  // 範囲外
+    gp_shadow_t *sh = &gp_shadow[unit];
+    uint8_t idx = reg - GP_SHADOW_BASE;
+    uint16_t bit = 1 << idx;
+    uint32_t mstatus = irq_save();
+    gp_shadow_stats.requests++;
+    if ((sh->valid & bit) && !(sh->dirty & bit) && sh->reg[idx] == val) {
+        // デバイスの値と同じなので書く必要がない
+        gp_shadow_stats.skipped++;
+    } else {
+        sh->reg[idx] = val;
+        sh->dirty |= bit;
+    }
+    irq_restore(mstatus);
+}
+
+uint8_t gp_shadow_read(int unit, uint8_t reg) {
+    if (!gp_shadow_in_range(unit, reg)) return 0;  // 範囲外
+    return gp_shadow[unit].reg[reg - GP_SHADOW_BASE];
+}
+
+void greenpak_flush_unit(int unit) {
+    if (unit < 0 || unit >= 4) return;  // 範囲外
+    gp_shadow_t *sh = &gp_shadow[unit];
+
+    // Virtual InputはURGENTの専用記述子で積む (完了は待たない)
+    uint32_t mstatus = irq_save();
+    if (sh->dirty & GP_VIN_BIT) {
+        sh->dirty &= ~GP_VIN_BIT;
+        sh->valid |= GP_VIN_BIT;  // 書き込みに失敗したらコールバックで落とされる
+        gp_vin_post_locked(unit, sh->reg[GP_VIN_IDX]);
+    }
+    irq_restore(mstatus);
+
+    // 残りは連続したdirtyレジスタをまとめて1回のバーストで書く
+    int idx = 0;
+    while ((sh->dirty & ~GP_VIN_BIT) != 0 && idx < GP_SHADOW_SIZE) {
+        if (idx == GP_VIN_IDX || !(sh->dirty & (1 << idx))) {
+            idx++;
+            continue;
+        }
+        int len = 0;
+        uint8_t buf[1 + GP_SHADOW_SIZE];
+        buf[0] = GP_SHADOW_BASE + idx;
+        while (idx + len < GP_SHADOW_SIZE && idx + len != GP_VIN_IDX && (sh->dirty & (1 << (idx + len)))) {
+            buf[1 + len] = sh->reg[idx + len];
+            len++;
+        }
+        uint16_t mask = ((1 << len) - 1) << idx;
+        uint8_t reg_addr7 = (uint8_t)((gp_target_addr[unit] & 0xfc) + 1);  // 0x00を使わないために+1する
+        bool ok = I2C_transfer(reg_addr7, buf, 1 + len, NULL, 0) == I2C_ERR_NONE;
+        // valid/dirtyはVirtual Inputの完了コールバックも触るので、割り込み禁止で更新する
+        mstatus = irq_save();
+        if (ok) {
+            sh->valid |= mask;
+            gp_shadow_stats.bursts++;
+            gp_shadow_stats.bytes += len;
+        } else {
+            // 書けなかった場合は、次回は必ず書くようにする
+            sh->valid &= ~mask;
+            gp_shadow_stats.errors++;
+        }
+        sh->dirty &= ~mask;
+        irq_restore(mstatus);
+        idx += len;
+    }
+}
+
+void greenpak_flush(void) {
+    for (int unit = 0; unit < 4; unit++) {
+        greenpak_flush_unit(unit);
+    }
+}
+
+const gp_shadow_stats_t *greenpak_get_shadow_stats(void) {
+    return &gp_shadow_stats;
+}
 
 uint8_t greenpak_get_virtualinput(int unit) {
     if (unit < 0 || unit >= 4) return 0;  // 範囲外
-    return gp_virtual_input_cache[unit];
+    return gp_shadow_read(unit, GP_REG_VIRTUAL_INPUT);
 }
 
 /**
@@ -138,16 +310,126 @@ uint8_t greenpak_get_virtualinput(int unit) {
 void greenpak_set_virtualinput(int unit, uint8_t val) {
     if (unit < 0 || unit >= 4) return;  // 範囲外
 
-    gp_virtual_input_cache[unit] = val;
-    gp_reg_set(gp_target_addr[unit], 0x7a, val);
+    // 値が変わった場合だけ、すぐにデバイスに書く (書き終わるまで待つ)
+    greenpak_set_virtualinput_deferred(unit, val);
+    greenpak_flush_unit(unit);
+    gp_vin_wait(unit);
+}
+
+void greenpak_set_virtualinput_deferred(int unit, uint8_t val) {
+    if (unit < 0 || unit >= 4) return;  // 範囲外
+
+    gp_shadow_write(unit, GP_REG_VIRTUAL_INPUT, val);
+    // Virtual Inputの変化はMatrixの状態に影響するので、スナップショットを読み直させる
+    greenpak_invalidate_matrix(unit);
+}
+
+// シャドウを更新して、変わっていればVirtual Inputの書き込みを積む (割り込み禁止中に呼ぶこと)
+static void gp_vin_update_locked(int unit, uint8_t val) {
+    gp_shadow_t *sh = &gp_shadow[unit];
+    gp_shadow_stats.requests++;
+    if ((sh->valid & GP_VIN_BIT) && !(sh->dirty & GP_VIN_BIT) && sh->reg[GP_VIN_IDX] == val) {
+        gp_shadow_stats.skipped++;
+    } else {
+        sh->reg[GP_VIN_IDX] = val;
+        sh->dirty &= ~GP_VIN_BIT;
+        sh->valid |= GP_VIN_BIT;
+        gp_vin_post_locked(unit, val);
+    }
+}
+
+void greenpak_post_virtualinput(int unit, uint8_t val) {
+    if (unit < 0 || unit >= 4) return;  // 範囲外
+
+    uint32_t mstatus = irq_save();
+    gp_vin_update_locked(unit, val);
+    irq_restore(mstatus);
+    greenpak_invalidate_matrix(unit);
+}
+
+void greenpak_update_virtualinput(int unit, uint8_t set_mask, uint8_t clr_mask) {
+    if (unit < 0 || unit >= 4) return;  // 範囲外
+
+    // 読んでから書くまでの間に割り込みルーチンが他のビットを変えないように、まとめて割り込み禁止で行う
+    uint32_t mstatus = irq_save();
+    gp_vin_update_locked(unit, (uint8_t)((gp_shadow[unit].reg[GP_VIN_IDX] | set_mask) & ~clr_mask));
+    irq_restore(mstatus);
+    greenpak_invalidate_matrix(unit);
+}
+
+void greenpak_wait_virtualinput(int unit) {
+    if (unit < 0 || unit >= 4) return;  // 範囲外
+    gp_vin_wait(unit);
+}
+
+void greenpak_pulse_virtualinput(int unit, uint8_t mask, bool active_low) {
+    if (unit < 0 || unit >= 4) return;  // 範囲外
+
+    // まず非アクティブの状態を確定させてから、アクティブ→非アクティブの2回だけ書く
+    uint8_t vin = greenpak_get_virtualinput(unit);
+    uint8_t idle = active_low ? (vin | mask) : (vin & ~mask);
+    uint8_t active = active_low ? (vin & ~mask) : (vin | mask);
+    greenpak_set_virtualinput(unit, idle);
+    greenpak_set_virtualinput(unit, active);
+    greenpak_set_virtualinput(unit, idle);
+    gp_shadow_stats.pulses++;
+}
+
+// バス時間の見積もり (1バイト = 9クロック、クロックはそのユニットに決まった速度)
+static uint32_t gp_i2c_byte_us(int unit) {
+    const i2c_profile_t *p = i2c_profile_get(I2C_DEV_GP1 + unit);
+    return 9 * 1000000 / i2c_speed_hz(p->speed);
+}
+// 1ビット分を読む従来のトランザクション: SLA+W, レジスタ番号, SLA+R, データ
+#define GP_SINGLE_READ_US(unit) (4 * gp_i2c_byte_us(unit))
+// バーストリード: SLA+W, レジスタ番号, SLA+R, データ8バイト
+#define GP_BURST_READ_US(unit) ((3 + GP_MATRIX_REG_NUM) * gp_i2c_byte_us(unit))
+
+static gp_matrix_snapshot_t gp_matrix[4];
+static uint16_t gp_matrix_max_age_ms = GP_MATRIX_MAX_AGE_MS;
+static gp_matrix_stats_t gp_matrix_stats;
+
+const gp_matrix_snapshot_t *greenpak_get_matrix_snapshot(int unit, bool force) {
+    if (unit < 0 || unit > 3) return NULL;  // 範囲外
+    gp_matrix_snapshot_t *snap = &gp_matrix[unit];
+    uint32_t now = time_ms();
+    if (!force && snap->valid && time_elapsed(now, snap->timestamp_ms) < gp_matrix_max_age_ms) {
+        return snap;
+    }
+    // 読み損ねた時に途中までのデータが残らないように、読めた時だけ書き換える
+    uint8_t reg[GP_MATRIX_REG_NUM];
+    snap->valid = gp_reg_read_burst(gp_target_addr[unit], GP_MATRIX_REG_BASE, reg, GP_MATRIX_REG_NUM) == I2C_ERR_NONE;
+    if (snap->valid) {
+        memcpy(snap->reg, reg, GP_MATRIX_REG_NUM);
+    }
+    snap->timestamp_ms = now;
+    gp_matrix_stats.bursts++;
+    gp_matrix_stats.saved_bus_us -= GP_BURST_READ_US(unit);
+    return snap;
+}
+
+void greenpak_invalidate_matrix(int unit) {
+    if (unit < 0 || unit > 3) return;  // 範囲外
+    gp_matrix[unit].valid = false;
+}
+
+void greenpak_set_matrix_max_age(uint16_t ms) {
+    gp_matrix_max_age_ms = ms;
+}
+
+const gp_matrix_stats_t *greenpak_get_matrix_stats(void) {
+    return &gp_matrix_stats;
 }
 
 bool greenpak_get_matrixinput(int unit, uint8_t inputno) {
-    if (unit < 0 || unit > 3) return false;         // 範囲外
-    if (inputno < 0 || inputno > 63) return false;  // 範囲外
+    if (unit < 0 || unit > 3) return false;  // 範囲外
+    if (inputno > 63) return false;          // 範囲外
 
     // Matrix Input レジスタは 0x74..0x7B にあり、8個ずつ8バイトに分かれている
-    uint8_t reg = 0x74 + inputno / 8;
-    uint8_t val = gp_reg_get(gp_target_addr[unit], reg);
+    gp_matrix_stats.queries++;
+    gp_matrix_stats.saved_bus_us += GP_SINGLE_READ_US(unit);
+    const gp_matrix_snapshot_t *snap = greenpak_get_matrix_snapshot(unit, false);
+    if (!snap->valid) return false;  // 読めなかった
+    uint8_t val = snap->reg[inputno / 8];
     return (val >> (inputno & 0x07)) & 0x01;
 }
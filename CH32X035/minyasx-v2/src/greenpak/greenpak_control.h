@@ -4,21 +4,124 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "build_profile.h"
+#include "i2c/i2c_async.h"
 #include "i2c/i2c_ch32x035.h"
 #include "oled/ssd1306_txt.h"
 
 uint8_t gp_reg_get(uint8_t addr7, uint8_t reg);
 
+// 連続したレジスタを1回のトランザクションで読む (戻り値は i2c_err_t)
+int gp_reg_read_burst(uint8_t addr7, uint8_t reg, uint8_t* buf, uint16_t len);
+
 void gp_reg_set(uint8_t addr7, uint8_t reg, uint8_t val);
 
-void greenpak_dump_oled();
+#if FEATURE_DEBUG_PAGES
+void greenpak_dump_oled();  // GreenPAKのNVMをデバッグページに表示する (デバッグページのあるビルドのみ)
+#endif
+
+//
+// 書き込み可能なレジスタのシャドウ
+// 書き込みはRAM上のシャドウを更新してdirtyにするだけで、flushで連続したdirtyレジスタを
+// まとめて1回のバーストで書く。デバイスと同じ値の書き込みは捨てる。
+//
+#define GP_SHADOW_BASE 0x70
+#define GP_SHADOW_SIZE 16
+#define GP_REG_VIRTUAL_INPUT 0x7a
+
+typedef struct {
+    uint32_t requests;  // シャドウへの書き込み要求
+    uint32_t skipped;   // デバイスと同じ値なので捨てた要求
+    uint32_t bursts;    // flushで行ったI2C書き込みの回数
+    uint32_t bytes;     // flushで書いたレジスタのバイト数
+    uint32_t pulses;    // パルス操作の回数
+    uint32_t errors;    // 書き込みに失敗した回数
+} gp_shadow_stats_t;
+
+void gp_shadow_write(int unit, uint8_t reg, uint8_t val);
+uint8_t gp_shadow_read(int unit, uint8_t reg);
+
+// dirtyなレジスタをデバイスに書く
+void greenpak_flush_unit(int unit);
+void greenpak_flush(void);
+
+const gp_shadow_stats_t* greenpak_get_shadow_stats(void);
 
 uint8_t greenpak_get_virtualinput(int unit);
 
+/**
+ * Virtual Inputをセットします。値が変わった場合だけすぐにデバイスに書きます (書き終わるまで待ちます)
+ */
 void greenpak_set_virtualinput(int unit, uint8_t val);
 
+/**
+ * Virtual Inputをシャドウにだけセットします。greenpak_flush() でまとめて書かれます
+ */
+void greenpak_set_virtualinput_deferred(int unit, uint8_t val);
+
+/**
+ * Virtual Inputの書き込みをURGENTとしてI2Cのキューに積みます (完了は待ちません)
+ * 割り込みルーチンからも呼べます。キューで待っている間に次の値が来たら、最後の値だけを書きます
+ */
+void greenpak_post_virtualinput(int unit, uint8_t val);
+
+/**
+ * Virtual Inputの set_mask のビットを1に、clr_mask のビットを0にして、書き込みを積みます (完了は待ちません)
+ * 読み出しから書き込みまでを割り込み禁止で行うので、割り込みルーチンとメインループの両方から同じVirtual Inputを変えられます
+ */
+void greenpak_update_virtualinput(int unit, uint8_t set_mask, uint8_t clr_mask);
+
+/**
+ * 積んだVirtual Inputの書き込みが終わるまで待ちます
+ */
+void greenpak_wait_virtualinput(int unit);
+
+/**
+ * Virtual Inputの mask のビットにパルスを出します (非アクティブ→アクティブ→非アクティブ)
+ * active_low: trueならLowパルス
+ */
+void greenpak_pulse_virtualinput(int unit, uint8_t mask, bool active_low);
+
+/**
+ * Matrix Inputの状態を返します
+ * スナップショットが鮮度の範囲内ならI2Cにアクセスせずにキャッシュから返します
+ * 読めなかった場合は false を返します
+ */
 bool greenpak_get_matrixinput(int unit, uint8_t inputno);
 
+//
+// Matrix Input (0x74..0x7B) のスナップショット
+// 8バイトを1回のバーストリードで読み、時刻付きでキャッシュする
+//
+#define GP_MATRIX_REG_BASE 0x74
+#define GP_MATRIX_REG_NUM 8
+#define GP_MATRIX_MAX_AGE_MS 5  // スナップショットの鮮度 (デフォルト)
+
+typedef struct {
+    uint8_t reg[GP_MATRIX_REG_NUM];  // 0x74..0x7B の値
+    uint32_t timestamp_ms;           // 読んだ時刻 (time_ms)
+    bool valid;                      // 読めているか
+} gp_matrix_snapshot_t;
+
+typedef struct {
+    uint32_t queries;       // greenpak_get_matrixinput() の呼び出し回数
+    uint32_t bursts;        // 実際に行ったバーストリードの回数
+    uint32_t saved_bus_us;  // 1ビットずつ読んでいた場合と比べて節約できたバス時間 (見積もり。差分はint32_tで見る)
+} gp_matrix_stats_t;
+
+/**
+ * スナップショットを返します。鮮度を過ぎている場合や force の場合は読み直します
+ */
+const gp_matrix_snapshot_t* greenpak_get_matrix_snapshot(int unit, bool force);
+
+// スナップショットを無効にする (Virtual Inputの書き込みなどで状態が変わる場合)
+void greenpak_invalidate_matrix(int unit);
+
+// スナップショットの鮮度 (msec) を設定する。0なら毎回読み直す
+void greenpak_set_matrix_max_age(uint16_t ms);
+
+const gp_matrix_stats_t* greenpak_get_matrix_stats(void);
+
 // 最終配置（NVMアドレスのみ並べる）
 extern const uint8_t gp_target_addr_cleared;
 extern const uint8_t gp_target_addr_default;
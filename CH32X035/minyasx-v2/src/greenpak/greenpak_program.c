@@ -1,52 +1,191 @@
 // greenpak_program.c など
 
+#include "greenpak/greenpak_program.h"
+
+#include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "greenpak/greenpak_control.h"
+#include "i2c/i2c_async.h"
 #include "i2c/i2c_ch32x035.h"
+#include "i2c/i2c_stats.h"
+#include "timebase/timebase.h"
+#include "ui/ui_control.h"
 
 #define GP_REG_RST_LATCH 0xC8                   // Reset and Latch Register (RLR)
 #define GP_REG_ER_SR 0xE3                       // Erase Status/Control Register (ERSR)
 #define GP_ERSE(page) (0x80 | ((page) & 0x0F))  // bit7=ERSE, 下位4bit=ページ
+#define GP_ERSE_EEPROM 0x10                     // bit4=1ならEEPROMのページを消去
 #define GP_PAGE_SIZE 16
-#define GP_ERASE_T_MS 500  // ts版に合わせて 1s（安全側）。短縮可。
+#define GP_PAGE_NUM 16
+#define GP_VERIFY_END 0xF0  // 末尾16バイト(0xF0..0xFF)は読み返しても一致しないので比較しない (hex4_to_greenpak.py と合わせる)
+
+// 完了待ちの上限 (データシート上は消去/書込みとも20ms程度。余裕を持たせる)
+#define GP_ERASE_TIMEOUT_MS 200
+#define GP_WRITE_TIMEOUT_MS 100
+#define GP_POLL_INTERVAL_US 200  // ACKポーリングの間隔 (バスを占有しないように少し空ける)
 
-static void gp_erase_page(uint8_t addr7, uint8_t page) {
-    gp_reg_set(addr7, GP_REG_ER_SR, GP_ERSE(page));
-    Delay_Ms(GP_ERASE_T_MS);  // 自己タイミング消去の完了待ち
+// 消去/書込み中のGreenPAKはI2CにNACKを返すので、ACKが返るまで待つ
+static int gp_wait_ack(uint8_t addr7, uint16_t timeout_ms) {
+    uint32_t start = time_ms();
+    while (!I2C_probe(addr7)) {
+        if (time_elapsed(time_ms(), start) > timeout_ms) {
+            return 0;
+        }
+        Delay_Us(GP_POLL_INTERVAL_US);
+    }
+    return 1;
 }
 
-static void gp_erase_range(uint8_t addr7, uint16_t base, uint16_t size) {
-    if (!size) return;
-    uint16_t start_page = (base) / GP_PAGE_SIZE;
-    uint16_t end_page = (base + size - 1) / GP_PAGE_SIZE;
-    if (start_page > 15) start_page = 15;
-    if (end_page > 15) end_page = 15;
-    for (uint16_t p = start_page; p <= end_page; ++p) {
-        gp_erase_page(addr7, (uint8_t)p);
+int gp_wait_ready(uint8_t addr7, uint16_t timeout_ms) {
+    return gp_wait_ack(addr7, timeout_ms);
+}
+
+static int gp_erase_page(uint8_t addr7, uint8_t page, bool eeprom) {
+    uint8_t reg_addr7 = (uint8_t)((addr7 & 0xfc) + 1);  // レジスタ空間
+    gp_reg_set(addr7, GP_REG_ER_SR, GP_ERSE(page) | (eeprom ? GP_ERSE_EEPROM : 0));
+    // ACKが返るようになったら、ERSEビットが落ちている(消去が終わっている)ことも確認する
+    uint32_t start = time_ms();
+    for (;;) {
+        if (!gp_wait_ack(reg_addr7, GP_ERASE_TIMEOUT_MS)) {
+            return 0;
+        }
+        if ((gp_reg_get(addr7, GP_REG_ER_SR) & 0x80) == 0) {
+            return 1;
+        }
+        if (time_elapsed(time_ms(), start) > GP_ERASE_TIMEOUT_MS) {
+            return 0;
+        }
+        Delay_Us(GP_POLL_INTERVAL_US);
     }
 }
 
-// 既存の連続書き込みを流用（そのまま）
-extern void gp_write_seq(uint8_t addr7, uint16_t start, const uint8_t *data, uint16_t len);
+static int gp_write_page(uint8_t nvm_addr7, uint8_t start, const uint8_t *data, uint16_t len) {
+    uint8_t buf[1 + GP_PAGE_SIZE];
+    buf[0] = start;
+    memcpy(&buf[1], data, len);
+    if (I2C_transfer(nvm_addr7, buf, 1 + len, NULL, 0) != I2C_ERR_NONE) {
+        return 0;
+    }
+    return gp_wait_ack(nvm_addr7, GP_WRITE_TIMEOUT_MS);
+}
 
-// 消去→書込みワンショット
-void gp_program_with_erase(uint8_t addr7, uint16_t base, const uint8_t *img, uint16_t size) {
-    if (!size) return;
+// ページ単位で差分のあるところだけ消去→書込み
+int gp_program_with_erase(uint8_t addr7, uint16_t base, const uint8_t *img, uint16_t size) {
+    if (!size) return 0;
     uint8_t nvm_addr7 = (uint8_t)((addr7 & 0xfc) + 2);  // NVMアドレスに変換 (addrは0x08,0x10,0x18,0x20,0x28のいずれか)
-    gp_erase_range(addr7, base, size);                  // 先に消去
-    for (int i = 0; i < 16; i++) {
-        // 16バイトずつウエイトを入れて書く
-        Delay_Ms(100);
-        gp_write_seq(nvm_addr7, base + i * 16, &img[i * 16], (size - i * 16 > 16) ? 16 : (size - i * 16));
+    uint32_t start_ms = time_ms();
+    i2c_class_t prev_class = i2c_set_class(I2C_CLASS_GP_NVM);  // 消去コマンドなどのレジスタアクセスもNVMとして集計する
+    int written = 0;
+    int failed = 0;     // 消去/書込みに失敗した (そこで打ち切る)
+    int verify_ng = 0;  // 書込みはできたが読み返しが一致しなかったページ数
+
+    uint16_t start_page = base / GP_PAGE_SIZE;
+    uint16_t end_page = (base + size - 1) / GP_PAGE_SIZE;
+    if (end_page > GP_PAGE_NUM - 1) end_page = GP_PAGE_NUM - 1;
+
+    // 書き換えたページ番号を1桁ずつ並べて進捗を表示する
+    ui_print(UI_PAGE_LOG, "pg:");
+    for (uint16_t p = start_page; p <= end_page && !failed; ++p) {
+        uint16_t addr = p * GP_PAGE_SIZE;
+        uint16_t off = addr - base;
+        uint16_t n = size - off;
+        if (n > GP_PAGE_SIZE) n = GP_PAGE_SIZE;
+        // 比較するバイト数 (末尾の比較できない範囲を除く)
+        uint16_t cmp_n = (addr >= GP_VERIFY_END) ? 0 : (addr + n > GP_VERIFY_END) ? GP_VERIFY_END - addr : n;
+
+        // 現在の内容を読んで、同じならこのページは触らない
+        // 全体が比較できないページは、他のページを書き換えた時だけ一緒に書く
+        uint8_t reg = (uint8_t)addr;
+        uint8_t cur[GP_PAGE_SIZE];
+        if (cmp_n == 0) {
+            if (written == 0) continue;
+        } else if (I2C_transfer(nvm_addr7, &reg, 1, cur, cmp_n) == I2C_ERR_NONE && memcmp(cur, &img[off], cmp_n) == 0) {
+            continue;
+        }
+
+        if (!gp_erase_page(addr7, (uint8_t)p, false) || !gp_write_page(nvm_addr7, (uint8_t)addr, &img[off], n)) {
+            failed = 1;
+            break;
+        }
+        ui_write(UI_PAGE_LOG, "0123456789ABCDEF"[p & 0x0f]);
+        written++;
+        // 読み返して確認
+        if (cmp_n > 0 && (I2C_transfer(nvm_addr7, &reg, 1, cur, cmp_n) != I2C_ERR_NONE || memcmp(cur, &img[off], cmp_n) != 0)) {
+            ui_write(UI_PAGE_LOG, '?');  // このページの読み返しが一致しない
+            verify_ng++;
+        }
+    }
+    if (failed) {
+        ui_write(UI_PAGE_LOG, '!');  // このページで失敗した
     }
+    ui_write(UI_PAGE_LOG, '\n');
 
-    Delay_Ms(1000);  // 書き込み完了待ち
+    if (written > 0) {
+        // 1ページでも書き換えたらICをリセットする (リセットしないとI2Cアドレスが変化しない)
+        // レジスタ番号 0xc8 に 0x02 を書き込むとリセットされる
+        gp_reg_set(addr7, GP_REG_RST_LATCH, 0x02);
+    }
+
+    i2c_set_class(prev_class);
+    ui_printf(UI_PAGE_LOG, "%dpg %dms\n", written, (int)time_elapsed(time_ms(), start_ms));
+    if (verify_ng > 0) {
+        ui_printf(UI_PAGE_LOG, "verify NG %dpg\n", verify_ng);
+    }
+    return (failed || verify_ng > 0) ? -1 : written;
+}
 
-    // 書き込み終わったらICをリセットする (リセットしないとI2Cアドレスが変化しない)
-    // レジスタ番号 0xc8 に 0x02 を書き込むとリセットされる
-    // レジスタ空間は「NVMアドレス−1」。8bitアドレスで渡す仕様なので <<1|0
-    gp_reg_set(addr7, GP_REG_RST_LATCH, 0x02);
+// スタンプのページ内容: "GPS" + 版数 + スタンプ(LE) + スタンプの反転(LE)、残りは0xFF
+static void gp_stamp_page(uint8_t *page, uint16_t stamp) {
+    memset(page, 0xff, GP_PAGE_SIZE);
+    page[0] = 'G';
+    page[1] = 'P';
+    page[2] = 'S';
+    page[3] = GP_STAMP_VERSION;
+    page[4] = (uint8_t)stamp;
+    page[5] = (uint8_t)(stamp >> 8);
+    page[6] = (uint8_t)~stamp;
+    page[7] = (uint8_t)(~stamp >> 8);
+}
+
+int gp_stamp_read(uint8_t addr7, uint16_t *stamp) {
+    uint8_t eep_addr7 = (uint8_t)((addr7 & 0xfc) + 3);  // EEPROMアドレスに変換
+    uint8_t reg = GP_STAMP_PAGE * GP_PAGE_SIZE;
+    uint8_t buf[8];
+    if (I2C_transfer(eep_addr7, &reg, 1, buf, sizeof(buf)) != I2C_ERR_NONE) {
+        return 0;
+    }
+    if (buf[0] != 'G' || buf[1] != 'P' || buf[2] != 'S' || buf[3] != GP_STAMP_VERSION) {
+        return 0;  // 未記録
+    }
+    uint16_t val = (uint16_t)(buf[4] | (buf[5] << 8));
+    uint16_t inv = (uint16_t)(buf[6] | (buf[7] << 8));
+    if ((uint16_t)~val != inv) {
+        return 0;  // 壊れている
+    }
+    *stamp = val;
+    return 1;
+}
+
+int gp_stamp_write(uint8_t addr7, uint16_t stamp) {
+    uint8_t eep_addr7 = (uint8_t)((addr7 & 0xfc) + 3);  // EEPROMアドレスに変換
+    uint8_t page[GP_PAGE_SIZE];
+    gp_stamp_page(page, stamp);
+    i2c_class_t prev_class = i2c_set_class(I2C_CLASS_GP_NVM);
+    int ok = gp_erase_page(addr7, GP_STAMP_PAGE, true) && gp_write_page(eep_addr7, GP_STAMP_PAGE * GP_PAGE_SIZE, page, GP_PAGE_SIZE);
+    i2c_set_class(prev_class);
+    if (!ok) {
+        return 0;
+    }
+    uint16_t val;
+    return gp_stamp_read(addr7, &val) && val == stamp;
+}
 
-    Delay_Ms(1000);
+int gp_stamp_clear(uint8_t addr7) {
+    i2c_class_t prev_class = i2c_set_class(I2C_CLASS_GP_NVM);
+    int ok = gp_erase_page(addr7, GP_STAMP_PAGE, true);
+    i2c_set_class(prev_class);
+    uint16_t val;
+    return ok && !gp_stamp_read(addr7, &val);
 }
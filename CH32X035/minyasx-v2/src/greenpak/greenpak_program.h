@@ -1,6 +1,38 @@
 #ifndef GREENPAK_PROGRAM_H
 #define GREENPAK_PROGRAM_H
 
-void gp_program_with_erase(uint8_t nvm_addr7, uint16_t base, const uint8_t *img, uint16_t size);
+#include <stdint.h>
+
+// イメージのスタンプ (tools/hex4_to_greenpak.py が出力する GREENPAKn_STAMP) を記録する場所
+// NVMではなく、ユーザー用のEEPROM(256バイト)の最終ページを使う
+#define GP_STAMP_PAGE 15
+#define GP_STAMP_VERSION 1
+
+/**
+ * NVMのうちイメージと違うページだけを消去→書込みし、1ページでも書き換えたらICをリセットします
+ * 末尾16バイト(0xF0..0xFF)は比較も読み返しの確認もしません
+ * 完了はACKポーリングで待ちます。戻り値は書き換えたページ数 (書込みか読み返しの確認に失敗したら -1)
+ */
+int gp_program_with_erase(uint8_t addr7, uint16_t base, const uint8_t *img, uint16_t size);
+
+/**
+ * 指定アドレスがACKを返すまで待ちます (リセット後の再配置待ちなど)。間に合わなければ 0
+ */
+int gp_wait_ready(uint8_t addr7, uint16_t timeout_ms);
+
+/**
+ * EEPROMに記録されたスタンプを読みます。記録が無いか壊れていれば 0
+ */
+int gp_stamp_read(uint8_t addr7, uint16_t *stamp);
+
+/**
+ * EEPROMにスタンプを記録し、読み返して確認します。失敗したら 0
+ */
+int gp_stamp_write(uint8_t addr7, uint16_t stamp);
+
+/**
+ * EEPROMのスタンプを消します (次回の起動時にNVMを全数検証させる)。失敗したら 0
+ */
+int gp_stamp_clear(uint8_t addr7);
 
 #endif  // GREENPAK_PROGRAM_H
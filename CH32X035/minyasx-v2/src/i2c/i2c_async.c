@@ -0,0 +1,487 @@
+#include "i2c/i2c_async.h"
+
+#include <stddef.h>
+
+#include "i2c/i2c_ch32x035.h"
+#include "i2c/i2c_profile.h"
+#include "i2c/i2c_stats.h"
+#include "timebase/timebase.h"
+
+// 同期版トランザクションのタイムアウト (キュー待ちを含む)
+#define I2C_SYNC_TIMEOUT_US 20000
+#define I2C_SYNC_TIMEOUT_PER_BYTE_US 50
+
+// 実行中のトランザクションの制限時間 (100kHzでも余裕がある値)
+#define I2C_XFER_TIMEOUT_US 2000
+#define I2C_XFER_TIMEOUT_PER_BYTE_US 100
+
+// 直前のSTOPの送出を待つ時間 (これを過ぎたらSTOPを待たずに開始する)
+#define I2C_STOP_WAIT_US 300
+
+typedef enum {
+    I2C_PHASE_WRITE,  // アドレス(W) + 書き込み
+    I2C_PHASE_READ,   // アドレス(R) + 読み出し
+} i2c_phase_t;
+
+// 優先度ごとのキュー
+static i2c_xfer_t* volatile q_head[I2C_PRIO_NUM];
+static i2c_xfer_t* volatile q_tail[I2C_PRIO_NUM];
+static i2c_xfer_t* volatile cur = NULL;  // 実行中のトランザクション
+static volatile uint8_t cur_phase = I2C_PHASE_WRITE;
+static volatile bool polled_owner = false;  // バイト単位の同期APIがバスを使用中
+static uint8_t q_len = 0;
+static uint32_t cur_start_us;                     // 実行中のトランザクションの開始時刻
+static volatile uint8_t reset_err = I2C_ERR_BUS;  // 初期化で打ち切ったトランザクションのエラー
+static sw_timer_t stop_wait_timer;                // STOPの送出を待ってから次を開始するためのタイマー
+static bool stop_waiting = false;                 // STOPの送出を待っている
+static uint32_t stop_wait_start_us;               // 待ち始めた時刻
+
+static i2c_async_stats_t i2c_stats;
+
+static inline void i2c_dma_stop(void) {
+    DMA1_Channel6->CFGR &= ~DMA_CFGR1_EN;
+    DMA1_Channel7->CFGR &= ~DMA_CFGR1_EN;
+    DMA1->INTFCR = DMA_CGIF6 | DMA_CGIF7;
+    I2C1->CTLR2 &= ~(I2C_CTLR2_DMAEN | I2C_CTLR2_LAST | I2C_CTLR2_ITBUFEN);
+}
+
+// キューから取り出す順番
+static const uint8_t prio_order[I2C_PRIO_NUM] = {I2C_PRIO_URGENT, I2C_PRIO_NORMAL, I2C_PRIO_BULK};
+
+static void i2c_ev_service(void);
+static void i2c_er_service(void);
+static void i2c_dma_rx_service(void);
+
+// 優先度ごとの待ち時間を集計する
+static void i2c_account_wait(uint8_t prio, uint32_t wait_us) {
+    i2c_prio_stats_t* ps = &i2c_stats.prio[prio];
+    ps->count++;
+    ps->total_wait_us += wait_us;
+    if (wait_us > ps->max_wait_us) {
+        ps->max_wait_us = wait_us;
+    }
+}
+
+static void i2c_start_next(void);
+
+// STOPの送出待ちのタイマーが満了した (SysTick割り込みのコンテキスト)
+static void i2c_stop_wait_expired(void* arg) {
+    uint32_t mstatus = irq_save();
+    i2c_start_next();
+    irq_restore(mstatus);
+}
+
+// 次のトランザクションを開始する (割り込み禁止中か割り込みルーチンから呼ぶこと)
+static void i2c_start_next(void) {
+    if (cur != NULL || polled_owner || q_len == 0) {
+        return;
+    }
+    // 直前のSTOPの送出が終わっていなければ、割り込みルーチンの中で待たずに次のtickでやり直す
+    // (割り込み禁止中は i2c_async_check_timeout() がやり直す)
+    if (I2C1->CTLR1 & I2C_CTLR1_STOP) {
+        uint32_t now = time_us();
+        if (!stop_waiting) {
+            stop_waiting = true;
+            stop_wait_start_us = now;
+        }
+        if (time_elapsed(now, stop_wait_start_us) <= I2C_STOP_WAIT_US) {
+            timer_start(&stop_wait_timer, TIMEBASE_TICK_US, 0, i2c_stop_wait_expired, NULL);
+            return;
+        }
+        // STOPが出ないままなら待たずに開始する (止まったバスはタイムアウトで復旧される)
+    }
+    stop_waiting = false;
+
+    i2c_xfer_t* x = NULL;
+    for (int i = 0; i < I2C_PRIO_NUM && x == NULL; i++) {
+        uint8_t prio = prio_order[i];
+        x = q_head[prio];
+        if (x != NULL) {
+            q_head[prio] = x->next;
+            if (q_head[prio] == NULL) q_tail[prio] = NULL;
+        }
+    }
+    if (x == NULL) {
+        return;
+    }
+    x->next = NULL;
+    q_len--;
+    i2c_account_wait(x->prio, time_elapsed(time_us(), x->queued_us));
+
+    cur = x;
+    x->status = I2C_XFER_BUSY;
+    cur_phase = (x->wlen > 0 || x->rlen == 0) ? I2C_PHASE_WRITE : I2C_PHASE_READ;
+
+    cur_start_us = time_us();
+
+    // 相手のデバイスに合わせてバスクロックを切り替える (STOPの送出後なのでPEを切り替えてよい)
+    i2c_profile_apply(x->addr7);
+
+    I2C1->CTLR2 |= I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITERREN;
+    I2C1->CTLR1 |= I2C_CTLR1_ACK;
+    I2C1->CTLR1 |= I2C_CTLR1_START;
+}
+
+// 実行中のトランザクションを終了して、次を開始する
+static void i2c_complete(i2c_err_t err) {
+    i2c_xfer_t* x = cur;
+    cur = NULL;
+    I2C1->CTLR2 &= ~(I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITERREN);
+    if (x != NULL) {
+        if (err == I2C_ERR_NONE) {
+            i2c_stats.xfers++;
+            i2c_stats.bytes += x->wlen + x->rlen;
+        } else {
+            i2c_stats.errors++;
+        }
+        i2c_stats_account(x->addr7, x->cls, err, x->wlen + x->rlen, time_elapsed(time_us(), cur_start_us));
+        i2c_profile_feedback(x->addr7, err);
+        x->error = err;
+        x->status = (err == I2C_ERR_NONE) ? I2C_XFER_DONE : I2C_XFER_ERROR;
+        if (x->callback) {
+            x->callback(x);
+        }
+    }
+    i2c_start_next();
+}
+
+void i2c_async_reset(void) {
+    RCC->AHBPCENR |= RCC_AHBPeriph_DMA1;
+
+    uint32_t mstatus = irq_save();
+    i2c_dma_stop();
+    I2C1->CTLR2 &= ~(I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITERREN);
+
+    // TX: メモリ→DATAR
+    DMA1_Channel6->PADDR = (uint32_t)&I2C1->DATAR;
+    DMA1_Channel6->CFGR = DMA_M2M_Disable | DMA_Priority_High | DMA_MemoryDataSize_Byte | DMA_PeripheralDataSize_Byte |
+                          DMA_MemoryInc_Enable | DMA_Mode_Normal | DMA_DIR_PeripheralDST;
+    // RX: DATAR→メモリ (完了割り込みでSTOPを出す)
+    DMA1_Channel7->PADDR = (uint32_t)&I2C1->DATAR;
+    DMA1_Channel7->CFGR = DMA_M2M_Disable | DMA_Priority_High | DMA_MemoryDataSize_Byte | DMA_PeripheralDataSize_Byte |
+                          DMA_MemoryInc_Enable | DMA_Mode_Normal | DMA_DIR_PeripheralSRC | DMA_IT_TC;
+
+    NVIC_EnableIRQ(I2C1_EV_IRQn);
+    NVIC_EnableIRQ(I2C1_ER_IRQn);
+    NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+
+    // 実行中だったものはエラーで終わらせ、待機中のものは続けて実行する
+    i2c_err_t err = (i2c_err_t)reset_err;
+    reset_err = I2C_ERR_BUS;
+    if (cur != NULL) {
+        i2c_complete(err);
+    } else {
+        i2c_start_next();
+    }
+    irq_restore(mstatus);
+}
+
+bool i2c_submit(i2c_xfer_t* xfer) {
+    uint32_t mstatus = irq_save();
+    if (i2c_xfer_pending(xfer)) {
+        irq_restore(mstatus);
+        return false;
+    }
+    if (xfer->prio >= I2C_PRIO_NUM) {
+        xfer->prio = I2C_PRIO_NORMAL;
+    }
+    uint8_t prio = xfer->prio;
+    xfer->next = NULL;
+    xfer->error = I2C_ERR_NONE;
+    xfer->status = I2C_XFER_QUEUED;
+    xfer->queued_us = time_us();
+    if (q_tail[prio] != NULL) {
+        q_tail[prio]->next = xfer;
+    } else {
+        q_head[prio] = xfer;
+    }
+    q_tail[prio] = xfer;
+    if (++q_len > i2c_stats.queued) {
+        i2c_stats.queued = q_len;
+    }
+    i2c_start_next();
+    irq_restore(mstatus);
+    return true;
+}
+
+bool i2c_async_busy(void) {
+    return cur != NULL || q_len > 0;
+}
+
+// キューから取り除く (割り込み禁止中に呼ぶこと)
+static void i2c_dequeue(i2c_xfer_t* xfer) {
+    uint8_t prio = xfer->prio;
+    i2c_xfer_t* prev = NULL;
+    for (i2c_xfer_t* p = q_head[prio]; p != NULL; prev = p, p = p->next) {
+        if (p != xfer) continue;
+        if (prev != NULL) {
+            prev->next = p->next;
+        } else {
+            q_head[prio] = p->next;
+        }
+        if (q_tail[prio] == p) q_tail[prio] = prev;
+        q_len--;
+        break;
+    }
+    xfer->next = NULL;
+}
+
+// 完了しなかったトランザクションを打ち切る
+static void i2c_abort(i2c_xfer_t* xfer) {
+    if (xfer == NULL) {
+        return;
+    }
+    uint32_t mstatus = irq_save();
+    bool running = (cur == xfer);
+    if (running) {
+        // 実行中ならバスを復旧してから初期化し直す (i2c_async_reset() でタイムアウトとして終了する)
+        // 割り込みとDMAを止めて、復旧までの間に完了扱いにならないようにする
+        reset_err = I2C_ERR_TIMEOUT;
+        i2c_dma_stop();
+        I2C1->CTLR2 &= ~(I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITERREN);
+    } else if (xfer->status == I2C_XFER_QUEUED) {
+        i2c_dequeue(xfer);
+        i2c_stats.errors++;
+        xfer->error = I2C_ERR_TIMEOUT;
+        xfer->status = I2C_XFER_ERROR;
+    }
+    irq_restore(mstatus);
+
+    if (running) {
+        // 復旧手順はSCLを最大10クロック出すので、割り込みを許可したまま行う
+        uint8_t addr7 = xfer->addr7;
+        I2C_bus_recover();
+        i2c_stats_recovery(addr7);
+        i2c_stats.recoveries++;
+    }
+}
+
+// 割り込み禁止中に完了を待つ場合は、割り込みの代わりにフラグを見てエンジンを進める
+static void i2c_poll_engine(void) {
+    if (cur == NULL) {
+        // STOPの送出待ちで開始していないものがあれば、ここで開始する
+        i2c_start_next();
+        return;
+    }
+    if (I2C1->STAR1 & (I2C_STAR1_BERR | I2C_STAR1_ARLO | I2C_STAR1_AF | I2C_STAR1_OVR)) {
+        i2c_er_service();
+    } else if (DMA1->INTFR & DMA_TCIF7) {
+        i2c_dma_rx_service();
+    } else {
+        i2c_ev_service();
+    }
+}
+
+void i2c_async_check_timeout(void) {
+    if (irq_disabled()) {
+        i2c_poll_engine();
+    }
+    uint32_t mstatus = irq_save();
+    i2c_xfer_t* x = cur;
+    uint32_t limit_us = 0;
+    if (x != NULL) {
+        limit_us = I2C_XFER_TIMEOUT_US + (uint32_t)(x->wlen + x->rlen) * I2C_XFER_TIMEOUT_PER_BYTE_US;
+    }
+    bool expired = (x != NULL) && time_elapsed(time_us(), cur_start_us) > limit_us;
+    irq_restore(mstatus);
+    if (expired) {
+        i2c_abort(x);
+    }
+}
+
+int I2C_transfer(uint8_t addr7, const uint8_t* wbuf, uint16_t wlen, uint8_t* rbuf, uint16_t rlen) {
+    i2c_xfer_t x = {
+        .addr7 = addr7,
+        .wbuf = wbuf,
+        .wlen = wlen,
+        .rbuf = rbuf,
+        .rlen = rlen,
+        .cls = i2c_get_class(),
+    };
+    if (!i2c_submit(&x)) {
+        return I2C_ERR_BUSY;
+    }
+    uint32_t timeout_us = I2C_SYNC_TIMEOUT_US + (uint32_t)(wlen + rlen) * I2C_SYNC_TIMEOUT_PER_BYTE_US;
+    uint32_t start = time_us();
+    while (i2c_xfer_pending(&x)) {
+        // 先に実行中のトランザクションが止まっていれば、それを打ち切る
+        i2c_async_check_timeout();
+        if (time_elapsed(time_us(), start) > timeout_us) {
+            i2c_abort(&x);
+            break;
+        }
+    }
+    return x.error;
+}
+
+void i2c_async_claim(void) {
+    uint32_t start = time_us();
+    while (1) {
+        uint32_t mstatus = irq_save();
+        if (cur == NULL && q_head[I2C_PRIO_URGENT] == NULL) {
+            // 同期API(OLEDなど)はBULK扱い。URGENTが無ければ、待機中のNORMALより先に通す
+            polled_owner = true;
+            i2c_account_wait(I2C_PRIO_BULK, time_elapsed(time_us(), start));
+            irq_restore(mstatus);
+            return;
+        }
+        irq_restore(mstatus);
+        i2c_async_check_timeout();
+    }
+}
+
+void i2c_async_release(void) {
+    uint32_t mstatus = irq_save();
+    polled_owner = false;
+    i2c_start_next();
+    irq_restore(mstatus);
+}
+
+const i2c_async_stats_t* i2c_async_get_stats(void) {
+    return &i2c_stats;
+}
+
+void i2c_async_clear_wait_stats(void) {
+    uint32_t mstatus = irq_save();
+    for (int i = 0; i < I2C_PRIO_NUM; i++) {
+        i2c_stats.prio[i] = (i2c_prio_stats_t){0};
+    }
+    irq_restore(mstatus);
+}
+
+/*
+ * I2C1 イベント割り込み
+ * SB   : アドレスを送る
+ * ADDR : 書き込みならTX DMAを、読み出しならRX DMA(1バイトの場合はRXNE割り込み)を開始する
+ * BTF  : 書き込みの完了。読み出しがあればリスタート、無ければSTOP
+ * RXNE : 1バイト読み出しの完了
+ */
+static void i2c_ev_service(void) {
+    i2c_xfer_t* x = cur;
+    uint16_t s1 = I2C1->STAR1;
+    if (x == NULL) {
+        // 想定外の割り込み
+        I2C1->CTLR2 &= ~(I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITBUFEN);
+        return;
+    }
+
+    if (s1 & I2C_STAR1_SB) {
+        I2C1->DATAR = (x->addr7 << 1) | (cur_phase == I2C_PHASE_READ ? 1 : 0);
+        return;
+    }
+
+    if (s1 & I2C_STAR1_ADDR) {
+        if (cur_phase == I2C_PHASE_WRITE) {
+            (void)I2C1->STAR2;  // ADDRクリア
+            if (x->wlen == 0) {
+                // アドレスのみ (プローブ)
+                I2C1->CTLR1 |= I2C_CTLR1_STOP;
+                i2c_complete(I2C_ERR_NONE);
+                return;
+            }
+            DMA1_Channel6->MADDR = (uint32_t)x->wbuf;
+            DMA1_Channel6->CNTR = x->wlen;
+            I2C1->CTLR2 |= I2C_CTLR2_DMAEN;
+            DMA1_Channel6->CFGR |= DMA_CFGR1_EN;
+        } else if (x->rlen == 1) {
+            // 1バイトだけ読む場合は、ADDRクリアの前にNACKを、直後にSTOPを予約する
+            I2C1->CTLR1 &= ~I2C_CTLR1_ACK;
+            (void)I2C1->STAR2;  // ADDRクリア
+            I2C1->CTLR1 |= I2C_CTLR1_STOP;
+            I2C1->CTLR2 |= I2C_CTLR2_ITBUFEN;
+        } else {
+            // 最後のバイトでNACKを返すように LAST を立ててからDMAを開始する
+            DMA1_Channel7->MADDR = (uint32_t)x->rbuf;
+            DMA1_Channel7->CNTR = x->rlen;
+            I2C1->CTLR1 |= I2C_CTLR1_ACK;
+            I2C1->CTLR2 |= I2C_CTLR2_DMAEN | I2C_CTLR2_LAST;
+            DMA1_Channel7->CFGR |= DMA_CFGR1_EN;
+            (void)I2C1->STAR2;  // ADDRクリア
+        }
+        return;
+    }
+
+    if ((s1 & I2C_STAR1_BTF) && cur_phase == I2C_PHASE_WRITE) {
+        // 書き込みの最後のバイトまで送り終わった
+        DMA1_Channel6->CFGR &= ~DMA_CFGR1_EN;
+        I2C1->CTLR2 &= ~I2C_CTLR2_DMAEN;
+        if (x->rlen > 0) {
+            cur_phase = I2C_PHASE_READ;
+            I2C1->CTLR1 |= I2C_CTLR1_START;  // リスタート
+        } else {
+            I2C1->CTLR1 |= I2C_CTLR1_STOP;
+            i2c_complete(I2C_ERR_NONE);
+        }
+        return;
+    }
+
+    if ((s1 & I2C_STAR1_RXNE) && cur_phase == I2C_PHASE_READ && x->rlen == 1) {
+        x->rbuf[0] = I2C1->DATAR;
+        I2C1->CTLR2 &= ~I2C_CTLR2_ITBUFEN;
+        i2c_complete(I2C_ERR_NONE);
+        return;
+    }
+}
+
+void I2C1_EV_IRQHandler(void) __attribute__((interrupt));
+void I2C1_EV_IRQHandler(void) {
+    i2c_ev_service();
+}
+
+/*
+ * I2C1 エラー割り込み
+ */
+static void i2c_er_service(void) {
+    uint16_t s1 = I2C1->STAR1;
+    if (!(s1 & (I2C_STAR1_BERR | I2C_STAR1_ARLO | I2C_STAR1_AF | I2C_STAR1_OVR))) {
+        // エラーは無い (割り込み禁止中にポーリングで処理済みだったものが後から入った)
+        return;
+    }
+    I2C1->STAR1 = s1 & ~(I2C_STAR1_BERR | I2C_STAR1_ARLO | I2C_STAR1_AF | I2C_STAR1_OVR);
+
+    i2c_err_t err = I2C_ERR_BUS;
+    if (s1 & I2C_STAR1_AF) {
+        err = I2C_ERR_NACK;
+    } else if (s1 & I2C_STAR1_ARLO) {
+        err = I2C_ERR_ARLO;
+    } else if (s1 & I2C_STAR1_OVR) {
+        err = I2C_ERR_OVR;
+    }
+
+    i2c_dma_stop();
+    if (err != I2C_ERR_ARLO) {
+        // アービトレーションロスト時はスレーブに戻っているのでSTOPは出さない
+        I2C1->CTLR1 |= I2C_CTLR1_STOP;
+    }
+    if (cur != NULL) {
+        i2c_complete(err);
+    } else {
+        I2C1->CTLR2 &= ~I2C_CTLR2_ITERREN;
+    }
+}
+
+void I2C1_ER_IRQHandler(void) __attribute__((interrupt));
+void I2C1_ER_IRQHandler(void) {
+    i2c_er_service();
+}
+
+/*
+ * DMA1 Channel7 (I2C1 RX) 完了割り込み
+ * LAST を立てているので最後のバイトはNACK済み。STOPを出して完了する
+ */
+static void i2c_dma_rx_service(void) {
+    uint32_t intfr = DMA1->INTFR;
+    DMA1->INTFCR = DMA_CGIF7;
+    if (!(intfr & DMA_TCIF7) || cur == NULL || cur_phase != I2C_PHASE_READ) {
+        return;
+    }
+    DMA1_Channel7->CFGR &= ~DMA_CFGR1_EN;
+    I2C1->CTLR2 &= ~(I2C_CTLR2_DMAEN | I2C_CTLR2_LAST);
+    I2C1->CTLR1 |= I2C_CTLR1_STOP;
+    i2c_complete(I2C_ERR_NONE);
+}
+
+void DMA1_Channel7_IRQHandler(void) __attribute__((interrupt));
+void DMA1_Channel7_IRQHandler(void) {
+    i2c_dma_rx_service();
+}
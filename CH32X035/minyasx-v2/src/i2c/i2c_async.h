@@ -0,0 +1,126 @@
+#ifndef I2C_ASYNC_H
+#define I2C_ASYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ch32fun.h"
+
+//
+// 割り込み + DMA で動く I2C1 マスターエンジン
+//
+// トランザクション記述子(i2c_xfer_t)をキューに積むと、I2C1のイベント割り込みと
+// DMA(TX: DMA1 Channel6, RX: DMA1 Channel7)で順に処理し、完了時にコールバックを呼ぶ。
+// 1つのトランザクションは「書き込み(wlen>0の場合) → リスタート → 読み出し(rlen>0の場合)」の形。
+// wlen=0, rlen=0 の場合はアドレスだけを送る(ACKプローブ)。
+//
+// 既存のバイト単位の同期API(I2C_start/I2C_write/...)を使っている間は、
+// I2C_start() でエンジンが空くのを待ってバスを確保し、I2C_stop() で解放する。
+//
+// バスの所有者は常に1つで、割り込みルーチンは記述子をキューに積むだけにする。
+// キューは優先度ごとに分かれていて、URGENTは待機中のNORMALや同期API(BULK扱い)より先に実行される。
+//
+
+typedef enum {
+    I2C_XFER_IDLE = 0,  // 未使用
+    I2C_XFER_QUEUED,    // キューで待機中
+    I2C_XFER_BUSY,      // 実行中
+    I2C_XFER_DONE,      // 正常終了
+    I2C_XFER_ERROR,     // エラー終了 (errorに要因)
+} i2c_xfer_status_t;
+
+typedef enum {
+    I2C_ERR_NONE = 0,
+    I2C_ERR_NACK,     // アドレスまたはデータにACKが返らなかった
+    I2C_ERR_BUS,      // バスエラー
+    I2C_ERR_ARLO,     // アービトレーションロスト
+    I2C_ERR_OVR,      // オーバーラン
+    I2C_ERR_TIMEOUT,  // 完了を待ちきれなかった
+    I2C_ERR_BUSY,     // 記述子が既にキューに入っている
+} i2c_err_t;
+
+// 優先度 (0で初期化した記述子はNORMALになる)
+// キューからは URGENT → NORMAL → BULK の順に取り出す
+typedef enum {
+    I2C_PRIO_NORMAL = 0,  // 通常 (GreenPAKのレジスタ読み書き、INA3221など)
+    I2C_PRIO_URGENT,      // X68000側から見える信号の更新 (DISK_IN, READYなどのVirtual Input)
+    I2C_PRIO_BULK,        // 急がない大量転送 (OLEDなど)
+    I2C_PRIO_NUM,
+} i2c_prio_t;
+
+struct i2c_xfer;
+// 完了コールバック (I2C割り込みのコンテキストで呼ばれるので、軽い処理にすること)
+typedef void (*i2c_xfer_callback_t)(struct i2c_xfer* xfer);
+
+typedef struct i2c_xfer {
+    struct i2c_xfer* next;         // キューの次の記述子 (エンジンが使う)
+    uint8_t addr7;                 // 7bitアドレス
+    const uint8_t* wbuf;           // 書き込むデータ
+    uint16_t wlen;                 // 書き込むバイト数
+    uint8_t* rbuf;                 // 読み出し先
+    uint16_t rlen;                 // 読み出すバイト数
+    i2c_xfer_callback_t callback;  // 完了コールバック (NULL可)
+    void* arg;                     // コールバック用の引数
+    uint8_t prio;                  // i2c_prio_t
+    uint8_t cls;                   // 呼び出し元の分類 (i2c_class_t、統計用)
+    volatile uint8_t status;       // i2c_xfer_status_t
+    volatile uint8_t error;        // i2c_err_t
+    uint32_t queued_us;            // キューに積んだ時刻 (エンジンが使う)
+} i2c_xfer_t;
+
+typedef struct {
+    uint32_t count;          // 開始したトランザクション数
+    uint32_t total_wait_us;  // キューで待った時間の合計
+    uint32_t max_wait_us;    // キューで待った時間の最大
+} i2c_prio_stats_t;
+
+typedef struct {
+    uint32_t xfers;                       // 完了したトランザクション数
+    uint32_t errors;                      // エラー終了したトランザクション数
+    uint32_t bytes;                       // 送受信したデータのバイト数
+    uint16_t recoveries;                  // タイムアウトでバスを復旧した回数
+    uint8_t queued;                       // キューの最大長
+    i2c_prio_stats_t prio[I2C_PRIO_NUM];  // 優先度ごとの待ち時間 (同期APIのバス確保はBULKで集計)
+} i2c_async_stats_t;
+
+/**
+ * エンジンを初期化します (I2C_init() から呼ばれます)
+ * 実行中・待機中のトランザクションがあればエラーで終了させます
+ */
+void i2c_async_reset(void);
+
+/**
+ * トランザクションをキューに積みます。割り込みルーチンからも呼べます
+ * 記述子とバッファは完了(DONE/ERROR)するまで保持してください
+ */
+bool i2c_submit(i2c_xfer_t* xfer);
+
+// 実行中か待機中のトランザクションがあるか
+bool i2c_async_busy(void);
+
+static inline bool i2c_xfer_pending(const i2c_xfer_t* xfer) {
+    return xfer->status == I2C_XFER_QUEUED || xfer->status == I2C_XFER_BUSY;
+}
+
+/**
+ * 同期版のトランザクション (キューに積んで完了を待つ)
+ * 戻り値は i2c_err_t (0なら成功)
+ */
+int I2C_transfer(uint8_t addr7, const uint8_t* wbuf, uint16_t wlen, uint8_t* rbuf, uint16_t rlen);
+
+/**
+ * 実行中のトランザクションが制限時間(2ms + 100us/byte)を超えていたら打ち切り、
+ * バスを復旧してI2Cを初期化し直します。割り込みルーチンからは呼ばないでください
+ * 割り込み禁止中に呼ばれた場合は、割り込みの代わりにフラグを見てエンジンを進めます
+ * (完了を待つループはどれもこれを呼ぶので、割り込み禁止中でも同期APIが使えます)
+ */
+void i2c_async_check_timeout(void);
+
+// バイト単位の同期APIのためのバス確保/解放 (I2C_start/I2C_stopから呼ばれる)
+void i2c_async_claim(void);
+void i2c_async_release(void);
+
+const i2c_async_stats_t* i2c_async_get_stats(void);
+void i2c_async_clear_wait_stats(void);
+
+#endif  // I2C_ASYNC_H
@@ -6,21 +6,48 @@
 
 #include "i2c_ch32x035.h"
 
+#include <stddef.h>
+
+#include "i2c/i2c_async.h"
+#include "i2c/i2c_profile.h"
+#include "i2c/i2c_stats.h"
+#include "timebase/timebase.h"
+
+// I2C1のピン (GPIOA)
+#define I2C_SCL_PIN 10
+#define I2C_SDA_PIN 11
+
 /*
  * error descriptions
  */
 char *i2c_errstr[] = {"not busy", "master mode", "transmit mode", "tx empty", "transmit complete", "receive mode", "byte received"};
 
+// バイト単位の同期APIで通信中のトランザクション
+static uint8_t polled_addr7;      // 相手の7bitアドレス
+static uint32_t polled_start_us;  // I2C_start()の時刻
+static uint8_t polled_err;        // 最初に起きたエラー (i2c_err_t)。I2C_stop()まで保持する
+static uint16_t polled_bytes;     // 送受信したデータのバイト数
+static uint8_t polled_cls;        // 呼び出し元の分類 (i2c_class_t)
+
+// エラーを記録する。以降のI2C_stop()までの操作は何もしない
+static uint8_t I2C_latch(uint8_t err) {
+    if (polled_err == I2C_ERR_NONE) {
+        polled_err = err;
+    }
+    return 1;
+}
+
 /*
  * error handler
  */
 uint8_t I2C_error(uint8_t err) {
     // Note: printf may not be available in all environments
     // printf("I2C_error - timeout waiting for %s\n\r", i2c_errstr[err]);
+    (void)err;
 
-    // reset & initialize I2C
-    I2C_init();
-    return 1;
+    // ここでは周辺回路を初期化し直さずにエラーだけを記録する
+    // (バスの復旧は I2C_stop() でまとめて行う)
+    return I2C_latch(I2C_ERR_TIMEOUT);
 }
 
 /*
@@ -32,18 +59,59 @@ uint8_t I2C_chk_evt(uint32_t event_mask) {
     return (status & event_mask) == event_mask;
 }
 
+// NACK/バスエラー/アービトレーションロストを検出したら記録して1を返す
+static uint8_t I2C_chk_err(void) {
+    uint16_t s1 = I2C1->STAR1;
+    if (!(s1 & (I2C_STAR1_AF | I2C_STAR1_BERR | I2C_STAR1_ARLO))) {
+        return 0;
+    }
+    I2C1->STAR1 = s1 & ~(I2C_STAR1_AF | I2C_STAR1_BERR | I2C_STAR1_ARLO);
+    if (s1 & I2C_STAR1_AF) {
+        return I2C_latch(I2C_ERR_NACK);
+    } else if (s1 & I2C_STAR1_ARLO) {
+        return I2C_latch(I2C_ERR_ARLO);
+    }
+    return I2C_latch(I2C_ERR_BUS);
+}
+
 /*
  * wait for I2C event with timeout
  */
 uint8_t I2C_wait_evt(uint32_t event, uint8_t err_code) {
-    uint32_t timeout = I2C_TIMEOUT_MAX;
-    while (!I2C_chk_evt(event) && timeout--);
-    if (timeout == 0) {
-        return I2C_error(err_code);
+    if (polled_err != I2C_ERR_NONE) {
+        return 1;  // 既にエラーになっている
+    }
+    uint32_t start = time_us();
+    while (!I2C_chk_evt(event)) {
+        // NACKなどはタイムアウトを待たずに打ち切る
+        if (I2C_chk_err()) {
+            return 1;
+        }
+        if (time_elapsed(time_us(), start) > I2C_TIMEOUT_US) {
+            return I2C_error(err_code);
+        }
     }
     return 0;
 }
 
+// 現在のバスクロック
+static uint32_t i2c_clock_hz = I2C_CLKRATE;
+
+// バスクロックに対応するCKCFGRの値
+static uint16_t I2C_clock_config(uint32_t hz) {
+    uint16_t tempreg;
+    if (hz <= 100000) {
+        // standard mode good to 100kHz
+        tempreg = (I2C_PRERATE / (2 * hz)) & I2C_CKCFGR_CCR;
+    } else {
+        // fast mode over 100kHz (1MHzのFast-mode Plusも同じ設定で、Low:High=2:1)
+        tempreg = (I2C_PRERATE / (3 * hz)) & I2C_CKCFGR_CCR;
+        tempreg |= I2C_CKCFGR_FS;
+    }
+    if ((tempreg & I2C_CKCFGR_CCR) == 0) tempreg |= 1;  // Minimum value
+    return tempreg;
+}
+
 /*
  * init I2C hardware
  */
@@ -74,39 +142,63 @@ void I2C_init(void) {
     I2C1->CTLR2 = tempreg;
 
     // Set clock config
-    tempreg = 0;
-#if (I2C_CLKRATE <= 100000)
-    // standard mode good to 100kHz
-    tempreg = (I2C_PRERATE / (2 * I2C_CLKRATE)) & I2C_CKCFGR_CCR;
-#else
-    // fast mode over 100kHz
-    tempreg = (I2C_PRERATE / (3 * I2C_CLKRATE)) & I2C_CKCFGR_CCR;
-    tempreg |= I2C_CKCFGR_FS;
-#endif
-    if (tempreg == 0) tempreg = 1;  // Minimum value
-    I2C1->CKCFGR = tempreg;
+    I2C1->CKCFGR = I2C_clock_config(I2C_CLKRATE);
+    i2c_clock_hz = I2C_CLKRATE;
 
     // Enable I2C
     I2C1->CTLR1 |= I2C_CTLR1_PE;
 
     // set ACK mode
     I2C1->CTLR1 |= I2C_CTLR1_ACK;
+
+    // 割り込み/DMAエンジンを初期化する
+    i2c_async_reset();
+}
+
+/*
+ * バスクロックを切り替える (バスが空いている時に呼ぶこと)
+ * CKCFGRはPE=0の間にしか書き換えられないので、一度止めてから設定し直す
+ */
+void I2C_set_clock(uint32_t hz) {
+    if (hz == i2c_clock_hz) {
+        return;
+    }
+    I2C1->CTLR1 &= ~I2C_CTLR1_PE;
+    I2C1->CKCFGR = I2C_clock_config(hz);
+    I2C1->CTLR1 |= I2C_CTLR1_PE;
+    I2C1->CTLR1 |= I2C_CTLR1_ACK;
+    i2c_clock_hz = hz;
+}
+
+uint32_t I2C_get_clock(void) {
+    return i2c_clock_hz;
 }
 
 /*
  * I2C start transmission
  */
 void I2C_start(uint8_t addr) {
-    uint32_t timeout;
+    // 割り込み/DMAエンジンのトランザクションが終わるのを待ってバスを確保する
+    i2c_async_claim();
+
+    polled_addr7 = addr >> 1;
+    polled_start_us = time_us();
+    polled_err = I2C_ERR_NONE;
+    polled_bytes = 0;
+    polled_cls = i2c_get_class();
 
     // wait for not busy
-    timeout = I2C_TIMEOUT_MAX;
-    while ((I2C1->STAR2 & I2C_STAR2_BUSY) && timeout--);
-    if (timeout == 0) {
-        I2C_error(0);
-        return;
+    uint32_t start = time_us();
+    while (I2C1->STAR2 & I2C_STAR2_BUSY) {
+        if (time_elapsed(time_us(), start) > I2C_TIMEOUT_US) {
+            I2C_error(0);
+            return;
+        }
     }
 
+    // 相手のデバイスに合わせてバスクロックを切り替える
+    i2c_profile_apply(polled_addr7);
+
     // Set START condition
     I2C1->CTLR1 |= I2C_CTLR1_START;
 
@@ -130,6 +222,8 @@ void I2C_start(uint8_t addr) {
  * I2C restart transmission
  */
 void I2C_restart(uint8_t addr) {
+    if (polled_err != I2C_ERR_NONE) return;
+
     // Set START condition (restart)
     I2C1->CTLR1 |= I2C_CTLR1_START;
 
@@ -153,29 +247,45 @@ void I2C_restart(uint8_t addr) {
  * I2C stop transmission
  */
 void I2C_stop(void) {
-    // set STOP condition
-    I2C1->CTLR1 |= I2C_CTLR1_STOP;
+    uint8_t err = polled_err;
+    if (err == I2C_ERR_TIMEOUT || err == I2C_ERR_BUS) {
+        // スレーブがバスを掴んだままの可能性があるので、復旧手順を実行する (STOPも送られる)
+        I2C_bus_recover();
+        i2c_stats_recovery(polled_addr7);
+    } else if (err != I2C_ERR_ARLO) {
+        // set STOP condition
+        // (アービトレーションロスト時はスレーブに戻っているのでSTOPは出さない)
+        I2C1->CTLR1 |= I2C_CTLR1_STOP;
+    }
+    i2c_stats_account(polled_addr7, polled_cls, err, polled_bytes, time_elapsed(time_us(), polled_start_us));
+    i2c_profile_feedback(polled_addr7, err);
+
+    // バスを解放して、待機中のトランザクションを開始させる
+    i2c_async_release();
 }
 
 /*
  * I2C transmit one data byte to the slave
  */
 void I2C_write(uint8_t data) {
-    uint32_t timeout;
+    if (polled_err != I2C_ERR_NONE) return;
 
     // wait for TX Empty
-    timeout = I2C_TIMEOUT_MAX;
-    while (!(I2C1->STAR1 & I2C_STAR1_TXE) && timeout--);
-    if (timeout == 0) {
-        I2C_error(3);
-        return;
+    uint32_t start = time_us();
+    while (!(I2C1->STAR1 & I2C_STAR1_TXE)) {
+        if (time_elapsed(time_us(), start) > I2C_TIMEOUT_US) {
+            I2C_error(3);
+            return;
+        }
     }
 
     // send data
     I2C1->DATAR = data;
 
     // wait for tx complete
-    I2C_wait_evt(I2C_EVENT_MASTER_BYTE_TRANSMITTED, 4);
+    if (I2C_wait_evt(I2C_EVENT_MASTER_BYTE_TRANSMITTED, 4) == 0) {
+        polled_bytes++;
+    }
 }
 
 /*
@@ -184,6 +294,8 @@ void I2C_write(uint8_t data) {
 uint8_t I2C_read(uint8_t ack) {
     uint8_t data = 0;
 
+    if (polled_err != I2C_ERR_NONE) return data;
+
     if (ack) {
         // Enable ACK for next byte
         I2C1->CTLR1 |= I2C_CTLR1_ACK;
@@ -196,6 +308,7 @@ uint8_t I2C_read(uint8_t ack) {
     if (I2C_wait_evt(I2C_EVENT_MASTER_BYTE_RECEIVED, 6) == 0) {
         // read received data
         data = I2C1->DATAR;
+        polled_bytes++;
     }
 
     return data;
@@ -242,49 +355,61 @@ void I2C_readBuffer(uint8_t *buf, uint16_t len) {
 // 引数: 7bit アドレス（例: 0x0A）
 // 戻り: 在席=1 / 不在=0
 int I2C_probe(uint8_t addr7) {
-    Delay_Ms(100);
-    // 1) BUSY解除待ち
-    uint32_t to = I2C_TIMEOUT_MAX;
-    while ((I2C1->STAR2 & I2C_STAR2_BUSY) && --to);
-    if (!to) {
-        I2C_error(0);
-        return 0;
-    }
+    // アドレスだけのトランザクションをエンジンに流す (NACKならエラーで返る)
+    return I2C_transfer(addr7, NULL, 0, NULL, 0) == I2C_ERR_NONE;
+}
 
-    // 2) START
-    I2C1->CTLR1 |= I2C_CTLR1_START;
-    //    マスタモード突入 (SB/MSL/BUSY) を待つ
-    if (I2C_wait_evt(I2C_EVENT_MASTER_MODE_SELECT, 1)) {
-        I2C1->CTLR1 |= I2C_CTLR1_STOP;
-        return 0;
-    }
+/*
+ * 直前のトランザクション(I2C_start〜I2C_stop)のエラー (i2c_err_t)
+ */
+uint8_t I2C_last_error(void) {
+    return polled_err;
+}
 
-    // 3) SLA+W 送出（ACK を見る）
-    I2C1->DATAR = (addr7 << 1);  // write方向
-
-    //    ADDR(ACK) or AF(NACK) を待つ
-    int present = 0;
-    to = I2C_TIMEOUT_MAX;
-    while (--to) {
-        uint16_t sr1 = I2C1->STAR1;
-        if (sr1 & I2C_STAR1_ADDR) {  // ACK=在席
-            (void)I2C1->STAR2;       // ADDR クリア（SR1→SR2 読み）
-            present = 1;
-            break;
-        }
-        if (sr1 & I2C_STAR1_AF) {  // NACK=不在
-            present = 0;
-            break;
-        }
+// SCLがHighになるのを待つ (スレーブのクロックストレッチ)
+static void I2C_wait_scl_high(void) {
+    uint32_t start = time_us();
+    while (!(GPIOA->INDR & (1 << I2C_SCL_PIN)) && time_elapsed(time_us(), start) <= I2C_TIMEOUT_US);
+}
+
+/*
+ * バスの復旧
+ * 読み出しの途中で止まったスレーブがSDAをLowに保持し続けている場合に、
+ * SCLを最大9回トグルして残りのビットを吐き出させ、STOPを送ってからI2Cを初期化し直す
+ * 戻り値: SDAが解放されていれば1
+ */
+uint8_t I2C_bus_recover(void) {
+    I2C1->CTLR1 &= ~I2C_CTLR1_PE;
+
+    // SCL/SDAを汎用のオープンドレイン出力に切り替えて、Highにしておく
+    GPIOA->BSHR = (1 << I2C_SCL_PIN) | (1 << I2C_SDA_PIN);
+    GPIOA->CFGHR &= ~((0xF << (4 * (I2C_SCL_PIN - 8))) | (0xF << (4 * (I2C_SDA_PIN - 8))));
+    GPIOA->CFGHR |= ((GPIO_Speed_10MHz | GPIO_CNF_OUT_OD) << (4 * (I2C_SCL_PIN - 8))) |  //
+                    ((GPIO_Speed_10MHz | GPIO_CNF_OUT_OD) << (4 * (I2C_SDA_PIN - 8)));
+    Delay_Us(I2C_RECOVER_HALF_US);
+
+    for (int i = 0; i < 9 && !(GPIOA->INDR & (1 << I2C_SDA_PIN)); i++) {
+        GPIOA->BCR = (1 << I2C_SCL_PIN);
+        Delay_Us(I2C_RECOVER_HALF_US);
+        GPIOA->BSHR = (1 << I2C_SCL_PIN);
+        I2C_wait_scl_high();
+        Delay_Us(I2C_RECOVER_HALF_US);
     }
 
-    // 4) STOP（バス解放）
-    I2C1->CTLR1 |= I2C_CTLR1_STOP;
+    // STOP (SCLがHighの間にSDAをLow→High)
+    GPIOA->BCR = (1 << I2C_SCL_PIN);
+    Delay_Us(I2C_RECOVER_HALF_US);
+    GPIOA->BCR = (1 << I2C_SDA_PIN);
+    Delay_Us(I2C_RECOVER_HALF_US);
+    GPIOA->BSHR = (1 << I2C_SCL_PIN);
+    I2C_wait_scl_high();
+    Delay_Us(I2C_RECOVER_HALF_US);
+    GPIOA->BSHR = (1 << I2C_SDA_PIN);
+    Delay_Us(I2C_RECOVER_HALF_US);
 
-    // 5) 後始末（NACK/Timeout 時は I2C を立て直す）
-    if (!present || !to) {
-        // AF はソフトクリアも可能だが、確実さ重視で全体リカバリ
-        I2C_error(0);
-    }
-    return present;
+    uint8_t released = (GPIOA->INDR & (1 << I2C_SDA_PIN)) != 0;
+
+    // ピンの設定も含めて初期化し直す
+    I2C_init();
+    return released;
 }
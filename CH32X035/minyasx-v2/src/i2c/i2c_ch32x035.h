@@ -29,9 +29,14 @@ extern "C" {
 #define I2C_PRERATE 48000000  // System core clock (48MHz typical for CH32X035)
 #endif
 
-// I2C Timeout count
-#ifndef I2C_TIMEOUT_MAX
-#define I2C_TIMEOUT_MAX 100000
+// I2C Timeout (usec) - waiting time for each bus event, measured with the system time base
+#ifndef I2C_TIMEOUT_US
+#define I2C_TIMEOUT_US 1000
+#endif
+
+// Half period of the SCL clock generated by the bus recovery sequence (usec)
+#ifndef I2C_RECOVER_HALF_US
+#define I2C_RECOVER_HALF_US 5
 #endif
 
 // I2C Event Flags
@@ -49,7 +54,11 @@ void I2C_stop(void);             // I2C stop transmission
 void I2C_write(uint8_t data);    // I2C transmit one data byte to the slave
 uint8_t I2C_read(uint8_t ack);   // I2C receive one data byte from the slave
 uint16_t I2C_readW(uint8_t ack);
-int I2C_probe(uint8_t addr7);  // I2C address probe (7bit address, e.g. 0x0A)
+int I2C_probe(uint8_t addr7);     // I2C address probe (7bit address, e.g. 0x0A)
+uint8_t I2C_last_error(void);     // i2c_err_t of the last transaction (I2C_start .. I2C_stop)
+uint8_t I2C_bus_recover(void);    // clock out a stuck slave and re-init (1 if SDA was released)
+void I2C_set_clock(uint32_t hz);  // switch bus clock rate (bus must be idle)
+uint32_t I2C_get_clock(void);     // current bus clock rate in Hz
 
 void I2C_writeBuffer(uint8_t *buf, uint16_t len);
 void I2C_readBuffer(uint8_t *buf, uint16_t len);
@@ -0,0 +1,148 @@
+#include "i2c/i2c_profile.h"
+
+#include <stddef.h>
+
+#include "i2c/i2c_async.h"
+#include "i2c/i2c_ch32x035.h"
+
+static const uint32_t speed_hz[I2C_SPEED_NUM] = {100000, 400000, 1000000};
+
+// 起動時の読み返しテストの内容
+typedef struct {
+    uint8_t addr7;      // テストに使うアドレス (0ならテストしない)
+    uint8_t reg;        // 読み出すレジスタ
+    uint8_t len;        // 読み出すバイト数 (0ならACKだけを確認する)
+    uint8_t max_speed;  // デバイスが対応している最大のクロック
+} i2c_profile_probe_t;
+
+// GreenPAKの最大クロック (1MHzはCH32X035のI2Cの仕様外なので、明示的に許可した時だけ)
+#if I2C_GP_ALLOW_1M
+#define I2C_GP_MAX_SPEED I2C_SPEED_1M
+#else
+#define I2C_GP_MAX_SPEED I2C_SPEED_400K
+#endif
+
+static const i2c_profile_probe_t probes[I2C_DEV_NUM] = {
+    [I2C_DEV_GP1] = {0x11, 0x7a, 1, I2C_GP_MAX_SPEED},     // GreenPAKのレジスタ用アドレス(+1)のVirtual Input
+    [I2C_DEV_GP2] = {0x19, 0x7a, 1, I2C_GP_MAX_SPEED},     // 同上
+    [I2C_DEV_GP3] = {0x21, 0x7a, 1, I2C_GP_MAX_SPEED},     // 同上
+    [I2C_DEV_GP4] = {0x29, 0x7a, 1, I2C_GP_MAX_SPEED},     // 同上
+    [I2C_DEV_OLED] = {0x3c, 0x00, 0, I2C_SPEED_400K},      // SSD1306は読み出せないのでACKのみ (定格400kHz)
+    [I2C_DEV_INA] = {0x40, 0xfe, 2, I2C_SPEED_400K},       // Manufacturer ID (Fast-mode Plusは無い)
+    [I2C_DEV_OTHER] = {0x00, 0x00, 0, I2C_SPEED_DEFAULT},  // テストしない
+};
+
+static i2c_profile_t profiles[I2C_DEV_NUM];
+static bool profiles_ready = false;
+static bool calibrating = false;
+
+uint32_t i2c_speed_hz(i2c_speed_t speed) {
+    if (speed >= I2C_SPEED_NUM) return speed_hz[I2C_SPEED_DEFAULT];
+    return speed_hz[speed];
+}
+
+static void i2c_profile_init(void) {
+    for (int dev = 0; dev < I2C_DEV_NUM; dev++) {
+        profiles[dev] = (i2c_profile_t){
+            .speed = I2C_SPEED_DEFAULT,
+            .max_speed = probes[dev].max_speed,
+        };
+    }
+    profiles_ready = true;
+}
+
+void i2c_profile_apply(uint8_t addr7) {
+    if (!profiles_ready) {
+        i2c_profile_init();
+    }
+    I2C_set_clock(speed_hz[profiles[i2c_dev_from_addr(addr7)].speed]);
+}
+
+void i2c_profile_feedback(uint8_t addr7, uint8_t err) {
+    if (!profiles_ready || calibrating) {
+        return;
+    }
+    i2c_profile_t* p = &profiles[i2c_dev_from_addr(addr7)];
+    if (err == I2C_ERR_NONE || err == I2C_ERR_NACK) {
+        // NACKは相手が応答しないだけ (NVM書き込み中など) なので、クロックのせいにはしない
+        p->err_run = 0;
+        return;
+    }
+    if (++p->err_run < I2C_PROFILE_FALLBACK_ERRORS) {
+        return;
+    }
+    p->err_run = 0;
+    if (p->speed > I2C_SPEED_100K) {
+        p->speed--;
+        p->fallbacks++;
+    }
+}
+
+// 現在のクロックで読み返しテストをする (全て成功してrefと一致すればtrue)
+static bool i2c_profile_verify(const i2c_profile_probe_t* probe, const uint8_t* ref, int reads) {
+    for (int i = 0; i < reads; i++) {
+        uint8_t buf[2] = {0, 0};
+        int err;
+        if (probe->len == 0) {
+            err = I2C_transfer(probe->addr7, NULL, 0, NULL, 0);
+        } else {
+            err = I2C_transfer(probe->addr7, &probe->reg, 1, buf, probe->len);
+        }
+        if (err != I2C_ERR_NONE) {
+            return false;
+        }
+        if (ref != NULL && (buf[0] != ref[0] || buf[1] != ref[1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void i2c_profile_calibrate(void) {
+    if (!profiles_ready) {
+        i2c_profile_init();
+    }
+    calibrating = true;
+    for (int dev = 0; dev < I2C_DEV_NUM; dev++) {
+        const i2c_profile_probe_t* probe = &probes[dev];
+        i2c_profile_t* p = &profiles[dev];
+        p->validated = false;
+        if (probe->addr7 == 0) {
+            continue;
+        }
+
+        // 100kHzで基準の値を読む (読めなければデバイスが居ないので、既定のクロックのままにする)
+        p->speed = I2C_SPEED_100K;
+        uint8_t ref[2] = {0, 0};
+        if (probe->len > 0) {
+            if (I2C_transfer(probe->addr7, &probe->reg, 1, ref, probe->len) != I2C_ERR_NONE) {
+                p->speed = I2C_SPEED_DEFAULT;
+                continue;
+            }
+        } else if (!i2c_profile_verify(probe, NULL, 1)) {
+            p->speed = I2C_SPEED_DEFAULT;
+            continue;
+        }
+
+        // 速い方から試して、全て一致した最初のクロックを使う
+        uint8_t chosen = I2C_SPEED_100K;
+        for (int speed = probe->max_speed; speed > I2C_SPEED_100K; speed--) {
+            p->speed = speed;
+            if (i2c_profile_verify(probe, probe->len > 0 ? ref : NULL, I2C_PROFILE_VERIFY_READS)) {
+                chosen = speed;
+                break;
+            }
+        }
+        p->speed = chosen;
+        p->validated = true;
+    }
+    calibrating = false;
+}
+
+const i2c_profile_t* i2c_profile_get(i2c_dev_t dev) {
+    if (dev >= I2C_DEV_NUM) return NULL;
+    if (!profiles_ready) {
+        i2c_profile_init();
+    }
+    return &profiles[dev];
+}
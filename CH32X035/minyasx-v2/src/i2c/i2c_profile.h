@@ -0,0 +1,70 @@
+#ifndef I2C_PROFILE_H
+#define I2C_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "i2c/i2c_stats.h"
+
+//
+// I2Cデバイスごとのバスクロック設定
+//
+// トランザクションを開始する直前に相手のアドレスからデバイスを判別し、
+// そのデバイス用のクロック(100kHz/400kHz)に切り替える。
+// CH32X035のI2CはStandard/Fast-mode(400kHzまで)の仕様なので、1MHzは I2C_GP_ALLOW_1M を1にした時だけ
+// Fast-mode Plusに対応したGreenPAKに使う (仕様外の動作。基板ごとに確認すること)。
+// 起動時に読み返しテストで使えるクロックを決め、運用中にエラーが続いたら一段ずつ遅くする。
+//
+
+typedef enum {
+    I2C_SPEED_100K = 0,  // Standard-mode
+    I2C_SPEED_400K,      // Fast-mode
+    I2C_SPEED_1M,        // Fast-mode Plus
+    I2C_SPEED_NUM,
+} i2c_speed_t;
+
+// 検証していないデバイスのクロック
+#define I2C_SPEED_DEFAULT I2C_SPEED_400K
+
+// GreenPAKに1MHz(仕様外)を試させるか (0なら400kHzまで)
+#ifndef I2C_GP_ALLOW_1M
+#define I2C_GP_ALLOW_1M 0
+#endif
+
+// このエラー回数が続いたらクロックを一段下げる (NACKは数えない)
+#define I2C_PROFILE_FALLBACK_ERRORS 3
+
+// 起動時の読み返しテストの回数 (各クロックで)
+#define I2C_PROFILE_VERIFY_READS 8
+
+typedef struct {
+    uint8_t speed;       // 現在のクロック (i2c_speed_t)
+    uint8_t max_speed;   // デバイスが対応している最大のクロック
+    bool validated;      // 起動時の読み返しテストで決めたクロックか
+    uint8_t err_run;     // 連続したエラーの回数
+    uint16_t fallbacks;  // エラーでクロックを下げた回数
+} i2c_profile_t;
+
+uint32_t i2c_speed_hz(i2c_speed_t speed);
+
+/**
+ * 相手のアドレスに合わせてバスクロックを切り替えます
+ * トランザクションの開始直前(バスが空いている時)に呼ばれます。割り込みルーチンからも呼べます
+ */
+void i2c_profile_apply(uint8_t addr7);
+
+/**
+ * トランザクションの結果を反映します。エラーが続いたらクロックを下げます
+ */
+void i2c_profile_feedback(uint8_t addr7, uint8_t err);
+
+/**
+ * 起動時の読み返しテストで、各デバイスのクロックを決めます
+ * INA3221はID(0xFE)、GreenPAKはVirtual Input(0x7A)を100kHzで読んだ値と比較し、
+ * OLEDは読み出せないのでACKだけを確認します
+ */
+void i2c_profile_calibrate(void);
+
+const i2c_profile_t* i2c_profile_get(i2c_dev_t dev);
+
+#endif  // I2C_PROFILE_H
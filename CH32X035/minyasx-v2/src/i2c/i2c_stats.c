@@ -0,0 +1,149 @@
+#include "i2c/i2c_stats.h"
+
+#include <string.h>
+
+#include "i2c/i2c_async.h"
+#include "log/flash_log.h"
+#include "timebase/timebase.h"
+
+static i2c_dev_stats_t dev_stats[I2C_DEV_NUM];
+
+static const char* const dev_names[I2C_DEV_NUM] = {
+    "GP1 ", "GP2 ", "GP3 ", "GP4 ", "OLED", "INA ", "ETC ",
+};
+
+static i2c_class_stats_t class_stats[I2C_CLASS_NUM];
+static i2c_class_count_t class_window[I2C_CLASS_NUM];  // 集計中の1秒間の値
+static uint32_t class_window_start_ms;
+static volatile uint8_t current_class = I2C_CLASS_OTHER;
+
+static const char* const class_names[I2C_CLASS_NUM] = {
+    "ETC ", "OLED", "KEY ", "PWR ", "INA ", "GPV ", "NVM ",
+};
+
+i2c_dev_t i2c_dev_from_addr(uint8_t addr7) {
+    // GreenPAKは1台で8アドレス(レジスタ/NVM/EEPROM)を使う
+    switch (addr7 & 0xf8) {
+        case 0x10:
+            return I2C_DEV_GP1;
+        case 0x18:
+            return I2C_DEV_GP2;
+        case 0x20:
+            return I2C_DEV_GP3;
+        case 0x28:
+            return I2C_DEV_GP4;
+        default:
+            break;
+    }
+    if (addr7 == 0x3c) return I2C_DEV_OLED;
+    if (addr7 == 0x40) return I2C_DEV_INA;
+    return I2C_DEV_OTHER;
+}
+
+const char* i2c_dev_name(i2c_dev_t dev) {
+    if (dev >= I2C_DEV_NUM) return "?   ";
+    return dev_names[dev];
+}
+
+i2c_class_t i2c_set_class(i2c_class_t cls) {
+    i2c_class_t prev = (i2c_class_t)current_class;
+    current_class = (uint8_t)cls;
+    return prev;
+}
+
+i2c_class_t i2c_get_class(void) {
+    return (i2c_class_t)current_class;
+}
+
+const char* i2c_class_name(i2c_class_t cls) {
+    if (cls >= I2C_CLASS_NUM) return "?   ";
+    return class_names[cls];
+}
+
+// 分類が設定されていないトランザクションは、アドレスから分かるものだけ分類する
+static uint8_t i2c_class_from_addr(uint8_t addr7) {
+    if (addr7 == 0x3c) return I2C_CLASS_OLED;
+    if (addr7 == 0x40) return I2C_CLASS_INA;
+    // GreenPAK (作業用の0x08〜最終配置の0x28台) のNVM(+2)とEEPROM(+3)
+    if (addr7 >= 0x08 && addr7 < 0x30 && (addr7 & 0x02)) return I2C_CLASS_GP_NVM;
+    return I2C_CLASS_OTHER;
+}
+
+void i2c_stats_account(uint8_t addr7, uint8_t cls, uint8_t err, uint16_t bytes, uint32_t elapsed_us) {
+    i2c_dev_stats_t* s = &dev_stats[i2c_dev_from_addr(addr7)];
+    if (cls == I2C_CLASS_OTHER || cls >= I2C_CLASS_NUM) {
+        cls = i2c_class_from_addr(addr7);
+    }
+    i2c_class_count_t* c = &class_window[cls];
+    uint32_t mstatus = irq_save();
+    c->xfers++;
+    c->bytes += bytes;
+    c->busy_us += elapsed_us;
+    if (err != I2C_ERR_NONE) {
+        c->errors++;
+    }
+    switch (err) {
+        case I2C_ERR_NONE:
+            s->xfers++;
+            s->bytes += bytes;
+            s->total_us += elapsed_us;
+            if (elapsed_us > s->max_us) {
+                s->max_us = (elapsed_us > 0xffff) ? 0xffff : (uint16_t)elapsed_us;
+            }
+            break;
+        case I2C_ERR_NACK:
+            s->nacks++;
+            break;
+        case I2C_ERR_TIMEOUT:
+            s->timeouts++;
+            break;
+        default:
+            s->errors++;
+            break;
+    }
+    irq_restore(mstatus);
+}
+
+void i2c_stats_recovery(uint8_t addr7) {
+    uint32_t mstatus = irq_save();
+    dev_stats[i2c_dev_from_addr(addr7)].recoveries++;
+    irq_restore(mstatus);
+    flashlog_add(FLOG_I2C_RECOVER, addr7);
+}
+
+void i2c_stats_poll(uint32_t systick_ms) {
+    if (time_elapsed(systick_ms, class_window_start_ms) < 1000) {
+        return;
+    }
+    class_window_start_ms = systick_ms;
+    uint32_t mstatus = irq_save();
+    for (int i = 0; i < I2C_CLASS_NUM; i++) {
+        i2c_class_stats_t* cs = &class_stats[i];
+        const i2c_class_count_t* w = &class_window[i];
+        cs->rate = *w;
+        cs->total.xfers += w->xfers;
+        cs->total.bytes += w->bytes;
+        cs->total.busy_us += w->busy_us;
+        cs->total.errors += w->errors;
+    }
+    memset(class_window, 0, sizeof(class_window));
+    irq_restore(mstatus);
+}
+
+const i2c_dev_stats_t* i2c_stats_get(i2c_dev_t dev) {
+    if (dev >= I2C_DEV_NUM) return NULL;
+    return &dev_stats[dev];
+}
+
+const i2c_class_stats_t* i2c_class_stats_get(i2c_class_t cls) {
+    if (cls >= I2C_CLASS_NUM) return NULL;
+    return &class_stats[cls];
+}
+
+void i2c_stats_clear(void) {
+    uint32_t mstatus = irq_save();
+    memset(dev_stats, 0, sizeof(dev_stats));
+    memset(class_stats, 0, sizeof(class_stats));
+    memset(class_window, 0, sizeof(class_window));
+    irq_restore(mstatus);
+}
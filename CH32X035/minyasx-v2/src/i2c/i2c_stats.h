@@ -0,0 +1,106 @@
+#ifndef I2C_STATS_H
+#define I2C_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// I2Cデバイスごとの通信統計
+//
+// 割り込み/DMAエンジン(i2c_async)とバイト単位の同期API(i2c_ch32x035)の両方から、
+// トランザクションの終了時に呼ばれて、相手のアドレスごとに集計する。
+//
+// あわせて、どの処理(呼び出し元の分類)がバスを使っているかも集計する。
+// 呼び出し元は i2c_set_class() で分類を設定してからトランザクションを行い、終わったら元に戻す。
+// 分類が設定されていない場合は、OLED/INA3221/GreenPAKのNVMならアドレスから判別する。
+//
+
+typedef enum {
+    I2C_DEV_GP1 = 0,  // GreenPAK1 (0x10-0x17)
+    I2C_DEV_GP2,      // GreenPAK2 (0x18-0x1f)
+    I2C_DEV_GP3,      // GreenPAK3 (0x20-0x27)
+    I2C_DEV_GP4,      // GreenPAK4 (0x28-0x2f)
+    I2C_DEV_OLED,     // SSD1306 (0x3c)
+    I2C_DEV_INA,      // INA3221 (0x40)
+    I2C_DEV_OTHER,    // 上記以外 (書き込み前のGreenPAKなど)
+    I2C_DEV_NUM,
+} i2c_dev_t;
+
+// 呼び出し元の分類
+typedef enum {
+    I2C_CLASS_OTHER = 0,  // 分類されていない (GreenPAKのレジスタ読み書きなど)
+    I2C_CLASS_OLED,       // OLEDの描画
+    I2C_CLASS_KEY,        // キー入力の読み取り
+    I2C_CLASS_PWR,        // X68000の電源状態の検出
+    I2C_CLASS_INA,        // INA3221の電圧/電流測定
+    I2C_CLASS_GP_VIN,     // GreenPAKのVirtual Inputの更新
+    I2C_CLASS_GP_NVM,     // GreenPAKのNVM/EEPROMの検証と書き込み
+    I2C_CLASS_NUM,
+} i2c_class_t;
+
+typedef struct {
+    uint32_t xfers;    // トランザクション数 (エラーを含む)
+    uint32_t bytes;    // 送受信したバイト数
+    uint32_t busy_us;  // バスを使っていた時間
+    uint32_t errors;   // エラーで終わった数
+} i2c_class_count_t;
+
+typedef struct {
+    i2c_class_count_t total;  // 累計
+    i2c_class_count_t rate;   // 直近1秒間
+} i2c_class_stats_t;
+
+typedef struct {
+    uint32_t xfers;       // 成功したトランザクション数
+    uint16_t nacks;       // NACKで終わった数
+    uint16_t timeouts;    // タイムアウトした数
+    uint16_t errors;      // その他のエラー (バスエラー/アービトレーションロスト/オーバーラン)
+    uint16_t recoveries;  // バス復旧を行った数
+    uint16_t max_us;      // 成功したトランザクションの最大所要時間
+    uint32_t total_us;    // 成功したトランザクションの所要時間の合計 (平均の計算用)
+    uint32_t bytes;       // 成功したトランザクションで送受信したバイト数 (スループットの計算用)
+} i2c_dev_stats_t;
+
+/**
+ * 7bitアドレスからデバイスの分類を返します
+ */
+i2c_dev_t i2c_dev_from_addr(uint8_t addr7);
+
+/**
+ * デバイスの表示名 (4文字) を返します
+ */
+const char* i2c_dev_name(i2c_dev_t dev);
+
+/**
+ * 以降のトランザクションの呼び出し元の分類を設定し、それまでの分類を返します
+ * (終わったら戻り値で元に戻してください)
+ */
+i2c_class_t i2c_set_class(i2c_class_t cls);
+i2c_class_t i2c_get_class(void);
+
+/**
+ * 呼び出し元の分類の表示名 (4文字) を返します
+ */
+const char* i2c_class_name(i2c_class_t cls);
+
+/**
+ * トランザクションの結果を集計します (割り込みルーチンからも呼べます)
+ * err は i2c_err_t、cls は i2c_class_t、bytes は送受信したデータのバイト数、elapsed_us は開始から終了までの時間
+ */
+void i2c_stats_account(uint8_t addr7, uint8_t cls, uint8_t err, uint16_t bytes, uint32_t elapsed_us);
+
+/**
+ * バス復旧を行ったことを記録します
+ */
+void i2c_stats_recovery(uint8_t addr7);
+
+/**
+ * 1秒ごとに呼び出し元の分類ごとの毎秒の値を更新します
+ */
+void i2c_stats_poll(uint32_t systick_ms);
+
+const i2c_dev_stats_t* i2c_stats_get(i2c_dev_t dev);
+const i2c_class_stats_t* i2c_class_stats_get(i2c_class_t cls);
+void i2c_stats_clear(void);
+
+#endif  // I2C_STATS_H
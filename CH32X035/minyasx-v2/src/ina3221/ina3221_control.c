@@ -1,6 +1,6 @@
 #include "ina3221_control.h"
 
-#include "i2c/i2c_ch32x035.h"
+#include "i2c/i2c_async.h"
 #include "ui/ui_control.h"
 
 void ina3221_init(void) {
@@ -10,24 +10,13 @@ void ina3221_init(void) {
 #define INA3221_ADDR 0x40  // INA3221のI2Cアドレス
 
 uint16_t read_word_smbus(uint8_t dev7, uint8_t reg) {
-    uint16_t val;
-    uint8_t lsb, msb;
+    uint8_t buf[2] = {0, 0};
 
-    // 1) デバイス(書き込み)をオープンし、コマンド(レジスタ)を書き込む
-    I2C_start((dev7 << 1) | 0);  // write
-    I2C_write(reg);
+    // コマンド(レジスタ)を書き込み、リスタートして2バイト読む
+    // 1バイト目: MSB, 2バイト目: LSB
+    I2C_transfer(dev7, &reg, 1, buf, 2);
 
-    // 2) リスタートして読み出しに切り替え
-    I2C_restart((dev7 << 1) | 1);  // read
-
-    // 3) 2バイト読む（SMBusは LSB, MSB の順で送られる）
-    msb = I2C_read(1);  // 1バイト目: MSB → ACK（まだ続く）
-    lsb = I2C_read(0);  // 2バイト目: LSB → NACK（ここで終わり）
-    I2C_stop();
-
-    // 4) 16bit に合成（SMBus “word” は lsb が下位）
-    val = ((uint16_t)msb << 8) | lsb;
-    return val;
+    return ((uint16_t)buf[0] << 8) | buf[1];
 }
 
 uint16_t conv_current(uint16_t raw) {
@@ -67,15 +56,50 @@ void ina3221_read_all_channels(uint16_t *ch1_current, uint16_t *ch1_voltage,  //
     if (ch3_voltage) *ch3_voltage = conv_voltage(reg[5]);
 }
 
-void ina3221_poll(minyasx_context_t *ctx, uint64_t systick_ms) {
-    static uint64_t last_tick = 0;
-    if (systick_ms - last_tick < 1000) {
+// ポーリング用の非同期読み出し (レジスタ1〜6を1つずつ読む)
+static const uint8_t ina_regs[6] = {1, 2, 3, 4, 5, 6};
+static uint8_t ina_rx[6][2];
+static i2c_xfer_t ina_xfer[6];
+static bool ina_started = false;
+
+void ina3221_poll(minyasx_context_t *ctx, uint32_t systick_ms) {
+    // 1秒周期のタスクとしてスケジューラから呼ばれる
+    // 前回の周期で積んだ読み出しの結果を反映して、次の読み出しを積む
+    // (I2Cの転送は割り込みとDMAで行われるので、ここでは待たない)
+    bool ready = ina_started;
+    for (int i = 0; i < 6; i++) {
+        if (i2c_xfer_pending(&ina_xfer[i])) {
+            return;  // まだ終わっていない
+        }
+        if (ina_xfer[i].status != I2C_XFER_DONE) {
+            ready = false;
+        }
+    }
+    for (int i = 0; i < 6; i++) {
+        ina_xfer[i] = (i2c_xfer_t){
+            .addr7 = INA3221_ADDR,
+            .wbuf = &ina_regs[i],
+            .wlen = 1,
+            .rbuf = ina_rx[i],
+            .rlen = 2,
+        };
+    }
+    uint16_t reg[6];
+    for (int i = 0; i < 6; i++) {
+        reg[i] = ((uint16_t)ina_rx[i][0] << 8) | ina_rx[i][1];
+        i2c_submit(&ina_xfer[i]);
+    }
+    ina_started = true;
+    if (!ready) {
         return;
     }
-    last_tick = systick_ms;
 
-    uint16_t ch1_current, ch1_voltage, ch2_current, ch2_voltage, ch3_current, ch3_voltage;
-    ina3221_read_all_channels(&ch1_current, &ch1_voltage, &ch2_current, &ch2_voltage, &ch3_current, &ch3_voltage);
+    uint16_t ch1_current = conv_current(reg[0]);
+    uint16_t ch1_voltage = conv_voltage(reg[1]);
+    uint16_t ch2_current = conv_current(reg[2]);
+    uint16_t ch2_voltage = conv_voltage(reg[3]);
+    uint16_t ch3_current = conv_current(reg[4]);
+    uint16_t ch3_voltage = conv_voltage(reg[5]);
     ctx->power[0].voltage_mv = ch1_voltage;
     ctx->power[0].current_ma = ch1_current;
     ctx->power[1].voltage_mv = ch2_voltage;
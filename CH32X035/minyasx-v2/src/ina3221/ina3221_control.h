@@ -8,7 +8,7 @@
 
 void ina3221_init(void);
 
-void ina3221_poll(minyasx_context_t *ctx, uint64_t systick_ms);
+void ina3221_poll(minyasx_context_t *ctx, uint32_t systick_ms);
 
 /**
  * @brief INA3221の全チャネルの電流と電圧を読み取る
@@ -64,14 +64,19 @@ void WS2812_SPI_init() {
     for (k = 0; k < NR_LEDS; k++) phases[k] = k << 8;
 }
 
-void WS2812_SPI_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
-    GPIOA->BSHR = 1 << 7;  // Turn on PA7
-    // Wait for LEDs to totally finish.
-    Delay_Ms(12);
-    GPIOA->BSHR = 1 << (7 + 16);  // Turn it off
-
-    while (WS2812BLEDInUse);
+// フレーム送出の統計
+static volatile bool led_frame_pending = false;  // DMA送出中に次のフレームが要求された
+static volatile uint32_t led_frames_started = 0;
+static volatile uint32_t led_frames_done = 0;
+static volatile uint32_t led_frames_deferred = 0;
+
+static inline bool led_dma_busy(void) {
+    // WS2812BLEDInUseが落ちても、DMAはバッファの残り(リセット期間)を送出中のことがある
+    return WS2812BLEDInUse || (DMA1_Channel3->CNTR != 0);
+}
 
+// アニメーションを1フレーム進めて、DMA送出を開始する
+static void led_start_frame(void) {
     frameno++;
 
     if (frameno == 1024) {
@@ -93,5 +98,38 @@ void WS2812_SPI_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
         phases[k] += ((((rands[k & 0xff]) + 0xf) << 2) + (((rands[k & 0xff]) + 0xf) << 1)) >> 1;
     }
 
+    led_frames_started++;
     WS2812BDMAStart(NR_LEDS);
-}
\ No newline at end of file
+}
+
+/**
+ * 1フレームのDMA送出が完全に終わったら、DMA割り込みから呼ばれる
+ * 送出中に要求されていたフレームがあれば、ここで続けて送出する
+ */
+void WS2812BDMADoneCallback(void) {
+    led_frames_done++;
+    if (led_frame_pending) {
+        led_frame_pending = false;
+        led_start_frame();
+    }
+}
+
+/**
+ * LED_FRAME_INTERVAL_MS 周期のタスクとしてスケジューラから呼ばれる (これがフレームレートの上限になる)
+ * 前のフレームを送出中の場合は待たずに要求だけ残し、DMA完了時に送出する
+ */
+void WS2812_SPI_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
+    if (led_dma_busy()) {
+        led_frame_pending = true;
+        led_frames_deferred++;
+        return;
+    }
+    led_frame_pending = false;
+    led_start_frame();
+}
+
+void WS2812_SPI_get_stats(uint32_t* started, uint32_t* done, uint32_t* deferred) {
+    if (started) *started = led_frames_started;
+    if (done) *done = led_frames_done;
+    if (deferred) *deferred = led_frames_deferred;
+}
@@ -9,7 +9,11 @@
 #include "led/ws2812b_dma_spi_led_driver_alt.h"
 #include "minyasx.h"
 
+// LEDのフレーム更新周期 (フレームレートの上限)
+#define LED_FRAME_INTERVAL_MS 20
+
 void WS2812_SPI_init();
 void WS2812_SPI_poll(minyasx_context_t* ctx, uint32_t systick_ms);
+void WS2812_SPI_get_stats(uint32_t* started, uint32_t* done, uint32_t* deferred);
 
 #endif  //_LED_CONTROL_H
\ No newline at end of file
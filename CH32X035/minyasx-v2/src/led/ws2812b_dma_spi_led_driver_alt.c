@@ -20,6 +20,7 @@
 
    You will need to implement the following two functions, as callbacks from the ISR.
     uint32_t WS2812BLEDCallback( int ledno );
+    void WS2812BDMADoneCallback( void );  // Called once the DMA of a frame has fully expired.
 
    You willalso need to call
     WS2812BDMAInit();
@@ -210,13 +211,21 @@ void DMA1_Channel3_IRQHandler(void) {
         intfr = DMA1->INTFR;
     } while (intfr & DMA1_IT_GL3);
 
+    // The last LED has been queued and the DMA has run out (non-circular), so the frame is on the wire.
+    if (!WS2812BLEDInUse && DMA1_Channel3->CNTR == 0) {
+        WS2812BDMADoneCallback();
+    }
+
     // GPIOD->BSHR = 1<<16; // Turn off GPIOD0 for profiling
 }
 #endif
 
 void WS2812BDMAStart(int leds) {
     // Enter critical section.
-    __disable_irq();
+    // Save and restore MIE instead of unconditionally enabling interrupts,
+    // so that this can also be called from WS2812BDMADoneCallback() in the ISR.
+    uint32_t mstatus;
+    __asm__ volatile("csrrci %0, mstatus, 8" : "=r"(mstatus));
     WS2812BLEDInUse = 1;
 #ifdef CH5xx
     R8_SPI0_INTER_EN &= ~RB_SPI_IE_DMA_END;
@@ -227,7 +236,7 @@ void WS2812BDMAStart(int leds) {
     DMA1_Channel3->CNTR = 0;
     DMA1_Channel3->MADDR = (uint32_t)WS2812dmabuff;
 #endif
-    __enable_irq();
+    __asm__ volatile("csrs mstatus, %0" ::"r"(mstatus & 8));
     WS2812LEDs = leds;
     WS2812LEDPlace = -WS2812B_RESET_PERIOD;
 
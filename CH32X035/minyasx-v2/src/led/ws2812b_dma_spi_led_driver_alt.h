@@ -12,6 +12,7 @@ void WS2812BDMAStart(int leds);
 
 // Callbacks that you must implement.
 uint32_t WS2812BLEDCallback(int ledno);
+void WS2812BDMADoneCallback(void);
 
 extern volatile int WS2812BLEDInUse;
 
@@ -0,0 +1,251 @@
+#include "log/flash_log.h"
+
+#include <string.h>
+
+#include "ch32fun.h"
+#include "pcfdd/pcfdd_control.h"
+#include "timebase/timebase.h"
+
+#define FLOG_RECS_PER_PAGE (FLASHLOG_PAGE_SIZE / sizeof(flashlog_rec_t))
+#define FLOG_TOTAL_RECS (FLASHLOG_PAGES * FLOG_RECS_PER_PAGE)
+#define FLOG_PENDING_MASK (FLASHLOG_PENDING - 1)
+#define FLOG_PAGE_ADDR(page) (FLASHLOG_ADDR + (page) * FLASHLOG_PAGE_SIZE)
+
+// FLASH_CTLR/STATR の消去/書き込み用のビット (消去は高速モードのページ単位、書き込みは標準モードの半ワード単位)
+#define FLOG_CTLR_PG 0x00000001       // 標準書き込み (半ワード)
+#define FLOG_CTLR_PAGE_ER 0x00020000  // 高速ページ消去
+#define FLOG_CTLR_STRT 0x00000040     // 消去開始
+#define FLOG_CTLR_LOCK 0x00000080     // FLASH_CTLRのロック
+#define FLOG_CTLR_FLOCK 0x00008000    // 高速モードのロック
+#define FLOG_STATR_BSY 0x01           // 消去/書き込み中
+
+static flashlog_rec_t flog_pending[FLASHLOG_PENDING];  // 書き出し待ち
+static uint32_t flog_pending_head = 0;                 // 次に積む位置 (単調増加)
+static uint32_t flog_pending_tail = 0;                 // 次に書き出す位置 (単調増加)
+
+static uint16_t flog_next_pos = 0;     // 次に書くフラッシュ上のレコード位置 (ページ*レコード数+スロット)
+static uint16_t flog_flash_count = 0;  // フラッシュに書かれているレコード数
+static uint32_t flog_seq = 1;          // 次のレコードの通し番号
+static uint16_t flog_boot = 0;         // 今回の起動回数
+static flashlog_stats_t flog_stats;
+
+static const flashlog_rec_t* flog_flash_rec(int pos) {
+    return (const flashlog_rec_t*)(FLASHLOG_ADDR + pos * sizeof(flashlog_rec_t));
+}
+
+static uint8_t flog_check(const flashlog_rec_t* rec) {
+    const uint8_t* p = (const uint8_t*)rec;
+    uint8_t x = 0xA5;
+    for (int i = 0; i < (int)sizeof(flashlog_rec_t); i++) {
+        if (p + i != &rec->check) x ^= p[i];
+    }
+    return x;
+}
+
+static bool flog_valid(const flashlog_rec_t* rec) {
+    return rec->seq != 0xFFFFFFFF && rec->check == flog_check(rec);
+}
+
+//
+// フラッシュの操作 (消去は256バイト単位、書き込みは2バイト単位)
+//
+static void flog_flash_wait(uint32_t mask) {
+    while (FLASH->STATR & mask) {
+    }
+}
+
+static void flog_flash_unlock(void) {
+    FLASH->KEYR = FLASH_KEY1;
+    FLASH->KEYR = FLASH_KEY2;
+    FLASH->MODEKEYR = FLASH_KEY1;
+    FLASH->MODEKEYR = FLASH_KEY2;
+}
+
+static void flog_flash_lock(void) {
+    FLASH->CTLR |= FLOG_CTLR_LOCK | FLOG_CTLR_FLOCK;
+}
+
+static void flog_flash_erase_page(uint32_t addr) {
+    FLASH->CTLR |= FLOG_CTLR_PAGE_ER;
+    FLASH->ADDR = addr;
+    FLASH->CTLR |= FLOG_CTLR_STRT;
+    flog_flash_wait(FLOG_STATR_BSY);
+    FLASH->CTLR &= ~FLOG_CTLR_PAGE_ER;
+}
+
+// 消去済みのスロットにレコードを書き込む (ページは消さない)
+static void flog_flash_program_rec(int pos, const flashlog_rec_t* rec) {
+    volatile uint16_t* dst = (volatile uint16_t*)(uintptr_t)flog_flash_rec(pos);
+    const uint16_t* src = (const uint16_t*)rec;
+    FLASH->CTLR |= FLOG_CTLR_PG;
+    for (int i = 0; i < (int)(sizeof(flashlog_rec_t) / 2); i++) {
+        dst[i] = src[i];
+        flog_flash_wait(FLOG_STATR_BSY);
+    }
+    FLASH->CTLR &= ~FLOG_CTLR_PG;
+}
+
+// スロットが消去されたままか
+static bool flog_blank(int pos) {
+    const uint32_t* p = (const uint32_t*)flog_flash_rec(pos);
+    for (int i = 0; i < (int)(sizeof(flashlog_rec_t) / 4); i++) {
+        if (p[i] != 0xFFFFFFFF) return false;
+    }
+    return true;
+}
+
+// ページに書かれている有効なレコード数
+static int flog_page_count(int page) {
+    int count = 0;
+    for (int i = 0; i < (int)FLOG_RECS_PER_PAGE; i++) {
+        if (flog_valid(flog_flash_rec(page * FLOG_RECS_PER_PAGE + i))) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void flashlog_init(void) {
+    // 一番大きい通し番号のレコードを探し、その次から書く
+    uint32_t max_seq = 0;
+    int max_pos = -1;
+    uint16_t max_boot = 0;
+    flog_flash_count = 0;
+    for (int pos = 0; pos < (int)FLOG_TOTAL_RECS; pos++) {
+        const flashlog_rec_t* rec = flog_flash_rec(pos);
+        if (!flog_valid(rec)) {
+            continue;
+        }
+        flog_flash_count++;
+        if (rec->seq >= max_seq) {
+            max_seq = rec->seq;
+            max_pos = pos;
+        }
+        if (rec->boot > max_boot) {
+            max_boot = rec->boot;
+        }
+    }
+    flog_next_pos = (max_pos < 0) ? 0 : (uint16_t)((max_pos + 1) % FLOG_TOTAL_RECS);
+    // 書き込みの途中で電源が切れたスロットには書き足せないので飛ばす (ページの先頭なら消してから使う)
+    while (flog_next_pos % FLOG_RECS_PER_PAGE != 0 && !flog_blank(flog_next_pos)) {
+        flog_next_pos = (uint16_t)((flog_next_pos + 1) % FLOG_TOTAL_RECS);
+    }
+    flog_seq = max_seq + 1;
+    flog_boot = max_boot + 1;
+}
+
+void flashlog_add(flashlog_type_t type, uint32_t arg) {
+    uint32_t now = time_ms();
+    uint32_t irq = irq_save();
+    if (flog_pending_head - flog_pending_tail >= FLASHLOG_PENDING) {
+        flog_stats.dropped++;
+        irq_restore(irq);
+        return;
+    }
+    flashlog_rec_t* rec = &flog_pending[flog_pending_head & FLOG_PENDING_MASK];
+    rec->seq = flog_seq++;
+    rec->boot = flog_boot;
+    rec->type = (uint8_t)type;
+    rec->time_ms = now;
+    rec->arg = arg;
+    rec->check = flog_check(rec);
+    flog_pending_head++;
+    flog_stats.added++;
+    irq_restore(irq);
+}
+
+// 書き出し待ちのレコードを1件、次のスロットに書き出す
+// 書き込み済みのレコードには触らない。ページを消すのは、リングが一周してそのページに戻ってきた時だけ
+static void flog_flush_rec(void) {
+    flashlog_rec_t rec;
+    uint32_t irq = irq_save();
+    rec = flog_pending[flog_pending_tail & FLOG_PENDING_MASK];
+    flog_pending_tail++;
+    irq_restore(irq);
+
+    int pos = flog_next_pos;
+    int page = pos / FLOG_RECS_PER_PAGE;
+    flog_flash_unlock();
+    if (pos % FLOG_RECS_PER_PAGE == 0) {
+        int old = flog_page_count(page);
+        for (int i = 0; i < (int)FLOG_RECS_PER_PAGE; i++) {
+            if (!flog_blank(pos + i)) {
+                // 一番古いページ分のレコードが消える
+                flog_flash_erase_page(FLOG_PAGE_ADDR(page));
+                flog_flash_count -= old;
+                break;
+            }
+        }
+    }
+    if (flog_blank(pos)) {
+        flog_flash_program_rec(pos, &rec);
+    }
+    flog_flash_lock();
+
+    if (memcmp(flog_flash_rec(pos), &rec, sizeof(rec)) == 0) {
+        flog_flash_count++;
+    } else {
+        flog_stats.errors++;
+    }
+    flog_next_pos = (uint16_t)((pos + 1) % FLOG_TOTAL_RECS);
+}
+
+void flashlog_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
+    if (flog_pending_tail == flog_pending_head) {
+        return;  // 書き出すものが無い
+    }
+    // X68000からアクセスされている間は、割り込みの応答が遅れるので書かない
+    if (ctx->power_on && !pcfdd_bus_idle(systick_ms, FLASHLOG_IDLE_MS)) {
+        return;
+    }
+    uint32_t start = time_us();
+    while (flog_pending_tail != flog_pending_head) {
+        flog_flush_rec();
+    }
+    flog_stats.flushes++;
+    flog_stats.flush_us = time_elapsed(time_us(), start);
+}
+
+int flashlog_count(void) {
+    return flog_flash_count + (int)(flog_pending_head - flog_pending_tail);
+}
+
+bool flashlog_get(int n, flashlog_rec_t* rec) {
+    if (n < 0) {
+        return false;
+    }
+    uint32_t irq = irq_save();
+    int pending = (int)(flog_pending_head - flog_pending_tail);
+    if (n < pending) {
+        *rec = flog_pending[(flog_pending_head - 1 - n) & FLOG_PENDING_MASK];
+        irq_restore(irq);
+        return true;
+    }
+    irq_restore(irq);
+    n -= pending;
+    if (n >= flog_flash_count) {
+        return false;
+    }
+    // 書き込みに失敗したスロットは飛ばしているので、新しい方から有効なものを数える
+    for (int i = 1; i <= (int)FLOG_TOTAL_RECS; i++) {
+        const flashlog_rec_t* r = flog_flash_rec((flog_next_pos + FLOG_TOTAL_RECS - i) % FLOG_TOTAL_RECS);
+        if (flog_valid(r) && n-- == 0) {
+            *rec = *r;
+            return true;
+        }
+    }
+    return false;
+}
+
+static const char* const flog_type_names[FLOG_TYPE_MAX] = {
+    "-----", "BOOT ", "WDT  ", "X68ON", "X68OF", "PD12V", "EXT12",
+    "VBUS!", "MEDIA", "EJECT", "I2CRC", "STALL", "LOOPM",
+};
+
+const char* flashlog_type_name(uint8_t type) {
+    return (type < FLOG_TYPE_MAX) ? flog_type_names[type] : "?????";
+}
+
+const flashlog_stats_t* flashlog_get_stats(void) {
+    return &flog_stats;
+}
@@ -0,0 +1,96 @@
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "minyasx.h"
+
+//
+// フラッシュに残すイベントログ (電源を切っても消えない)
+//
+// フラッシュの最上位 FLASHLOG_PAGES ページを、16バイトのレコードを追記していくリングとして使う。
+// ページを順番に使い回すので、消去回数は全ページに均等にかかる。
+// 最後のページを使い切ったら最初のページを消して書き進める (一番古いページ分のレコードが消える)。
+// 追記は消去済みのスロットへ2バイト単位で書き込むだけで、書き込み済みのレコードを消し直すことは無い。
+//
+// flashlog_add() はRAMのバッファに積むだけで、割り込みルーチンからも呼べる。
+// フラッシュの消去/書き込み中はCPUがフラッシュから命令を読めず割り込みも遅れるので、
+// 書き出しは flashlog_poll() で、X68000からのアクセスが止まっている時にまとめて行う。
+//
+
+#define FLASHLOG_PAGE_SIZE 256  // 高速消去の単位
+#ifndef FLASHLOG_PAGES
+#define FLASHLOG_PAGES 8  // ログに使うページ数 (ld/ch32x035.ld のFLASHの長さと合わせること)
+#endif
+#define FLASHLOG_ADDR (0x08000000 + 62 * 1024 - FLASHLOG_PAGES * FLASHLOG_PAGE_SIZE)
+#define FLASHLOG_PENDING 16    // 書き出し待ちのレコードを溜めておける数
+#define FLASHLOG_IDLE_MS 2000  // ドライブが選択されなくなってから書き出すまでの時間
+
+typedef enum {
+    FLOG_NONE = 0,
+    FLOG_BOOT,          // 起動 (arg: メインループに入るまでの時間ms)
+    FLOG_WDT_RESET,     // ウォッチドッグによるリセットからの起動 (arg: 原因のタスクID)
+    FLOG_X68K_ON,       // X68000の電源ON
+    FLOG_X68K_OFF,      // X68000の電源OFF
+    FLOG_PD_12V,        // USB-PDの+12V要求の結果 (arg: 上位16bit=PDO番号, 下位16bit=成功なら12000)
+    FLOG_EXT_12V,       // 外部+12V電源を検出
+    FLOG_VBUS_NG,       // VBUSが5Vの範囲外 (arg: mV)
+    FLOG_MEDIA_CHANGE,  // メディアの交換を検出 (arg: ドライブ)
+    FLOG_EJECT,         // X68000からのイジェクト要求 (arg: ドライブ)
+    FLOG_I2C_RECOVER,   // I2Cバスの復旧処理 (arg: 7bitアドレス)
+    FLOG_STALL,         // タスクの長時間実行 (arg: 上位8bit=タスクID, 下位24bit=ms)
+    FLOG_LOOP_MAX,      // 電源OFF時点のメインループ周期の最大 (arg: usec)
+    FLOG_TYPE_MAX,
+} flashlog_type_t;
+
+typedef struct {
+    uint32_t seq;      // 通し番号 (0xFFFFFFFFは未書き込み)
+    uint16_t boot;     // 起動回数
+    uint8_t type;      // flashlog_type_t
+    uint8_t check;     // 検査用 (他のバイトのXOR)
+    uint32_t time_ms;  // 起動してからの時刻
+    uint32_t arg;      // イベントごとの値
+} flashlog_rec_t;
+
+typedef struct {
+    uint32_t added;     // 積んだレコード数
+    uint32_t dropped;   // 書き出し待ちがあふれて捨てた数
+    uint32_t flushes;   // 書き出した回数
+    uint32_t errors;    // 書き込み後の読み返しで一致しなかった回数
+    uint32_t flush_us;  // 直近の書き出しにかかった時間
+} flashlog_stats_t;
+
+/**
+ * フラッシュのログ領域を調べて、続きを書く位置と起動回数を決めます
+ */
+void flashlog_init(void);
+
+/**
+ * レコードを1件積みます (割り込みルーチンからも呼べます)
+ */
+void flashlog_add(flashlog_type_t type, uint32_t arg);
+
+/**
+ * X68000の電源が切れているか、ドライブがしばらく選択されていなければ、溜まったレコードを書き出します
+ */
+void flashlog_poll(minyasx_context_t* ctx, uint32_t systick_ms);
+
+/**
+ * 記録されているレコード数 (書き出し待ちを含む)
+ */
+int flashlog_count(void);
+
+/**
+ * 新しい方からn番目(0始まり)のレコードを取り出します
+ */
+bool flashlog_get(int n, flashlog_rec_t* rec);
+
+/**
+ * レコードの種類の名前 (5文字)
+ */
+const char* flashlog_type_name(uint8_t type);
+
+const flashlog_stats_t* flashlog_get_stats(void);
+
+#endif  // FLASH_LOG_H
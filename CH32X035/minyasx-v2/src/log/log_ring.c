@@ -0,0 +1,99 @@
+#include "log/log_ring.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#include "print.h"
+#include "timebase/timebase.h"
+
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+
+static log_entry_t log_ring[LOG_RING_SIZE];
+static uint32_t log_head = 0;  // 次に書く位置 (単調増加)
+static uint32_t log_tail = 0;  // 残っている一番古いログの位置 (単調増加)
+static log_stats_t log_stats;
+static log_level_t log_level = LOG_LEVEL_INFO;
+
+void log_post(log_level_t level, const char* fmt, int nargs, ...) {
+    if (level < log_level) {
+        return;  // 現在のログレベルより低いログは無視
+    }
+    if (nargs > LOG_MAX_ARGS) nargs = LOG_MAX_ARGS;
+    // 引数はリングの外で取り出しておき、割り込み禁止区間を短くする
+    uint32_t args[LOG_MAX_ARGS];
+    va_list ap;
+    va_start(ap, nargs);
+    for (int i = 0; i < nargs; i++) {
+        args[i] = va_arg(ap, uint32_t);
+    }
+    va_end(ap);
+    uint32_t now = time_ms();
+
+    uint32_t irq = irq_save();
+    if (log_head - log_tail >= LOG_RING_SIZE) {
+        // 一杯なら一番古いログを上書きする (新しいログの方を残す)
+        log_stats.overwritten[log_ring[log_tail & LOG_RING_MASK].level & 3]++;
+        log_tail++;
+    }
+    log_entry_t* e = &log_ring[log_head & LOG_RING_MASK];
+    e->time_ms = now;
+    e->fmt = fmt;
+    for (int i = 0; i < nargs; i++) {
+        e->args[i] = args[i];
+    }
+    e->level = (uint8_t)level;
+    e->nargs = (uint8_t)nargs;
+    log_head++;
+    log_stats.posted++;
+    irq_restore(irq);
+}
+
+bool log_read(uint32_t* cursor, log_entry_t* entry, uint32_t* lost) {
+    uint32_t irq = irq_save();
+    if (*cursor - log_tail > log_head - log_tail) {
+        // 読む前に上書きされた分を飛ばす
+        if (lost != NULL) *lost += log_tail - *cursor;
+        *cursor = log_tail;
+    }
+    if (*cursor == log_head) {
+        irq_restore(irq);
+        return false;
+    }
+    *entry = log_ring[*cursor & LOG_RING_MASK];
+    (*cursor)++;
+    irq_restore(irq);
+    return true;
+}
+
+void log_format(void (*putchar)(char c), const log_entry_t* entry) {
+    // 使わない引数の位置には0を渡す (printFは書式に出てくる分しか読まない)
+    uint32_t a[LOG_MAX_ARGS] = {0};
+    for (int i = 0; i < entry->nargs; i++) {
+        a[i] = entry->args[i];
+    }
+    printF(putchar, entry->fmt, a[0], a[1], a[2], a[3]);
+}
+
+void log_format_line(void (*putchar)(char c), const log_entry_t* entry) {
+    static const char level_chars[LOG_LEVEL_NUM] = {'T', 'I', 'W', 'E'};
+    printF(putchar, "%u %c ", entry->time_ms, level_chars[entry->level & 3]);
+    log_format(putchar, entry);
+    // 1件1行にする (改行で終わらない書式もあるため)
+    const char* f = entry->fmt;
+    while (*f) f++;
+    if (f == entry->fmt || f[-1] != '\n') {
+        putchar('\n');
+    }
+}
+
+void log_set_level(log_level_t level) {
+    log_level = level;
+}
+
+log_level_t log_get_level(void) {
+    return log_level;
+}
+
+const log_stats_t* log_get_stats(void) {
+    return &log_stats;
+}
@@ -0,0 +1,104 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// バイナリ形式のログリング
+//
+// ログは書式文字列のポインタと整数引数のまま積んでおき、文字列にするのは
+// ログページを表示した時か、テレメトリで送る時だけにする。
+// 積む処理は割り込み禁止区間での固定長コピーだけなので、割り込みルーチンからも呼べる。
+//
+// リングが一杯になったら一番古いログを上書きする (読む側がいなくても新しいログは残る)。
+// 読む側(ログページ、テレメトリ)はそれぞれ自分のカーソルで読み、リングからは取り除かない。
+//
+// 引数は32bitの整数か、文字列定数(%s)のみ。書式化はあとで行うので、
+// スタック上のバッファなど、寿命の短い文字列を渡してはいけない。
+//
+
+typedef enum {
+    LOG_LEVEL_TRACE = 0,  // トレース（詳細情報、デバッグ用）
+    LOG_LEVEL_INFO = 1,   // 情報
+    LOG_LEVEL_WARN = 2,   // 警告
+    LOG_LEVEL_ERROR = 3,  // エラー
+    LOG_LEVEL_NUM,
+} log_level_t;
+
+// これより低いレベルのログはコンパイル時に取り除く (0:TRACE 1:INFO 2:WARN 3:ERROR, ビルドフラグで上書きできる)
+#ifndef LOG_LEVEL_MIN
+#define LOG_LEVEL_MIN 0
+#endif
+
+// リングの段数 (2のべき乗にすること)
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 32
+#endif
+
+#define LOG_MAX_ARGS 4  // 1件あたりの引数の最大数
+
+typedef struct {
+    uint32_t time_ms;             // 記録した時刻 (time_ms())
+    const char* fmt;              // 書式文字列 (printFの書式)
+    uint32_t args[LOG_MAX_ARGS];  // 引数
+    uint8_t level;                // log_level_t
+    uint8_t nargs;                // 引数の数
+} log_entry_t;
+
+typedef struct {
+    uint32_t posted;                      // 積んだ件数
+    uint32_t overwritten[LOG_LEVEL_NUM];  // 上書きで消えた件数 (消えたログのレベル別)
+} log_stats_t;
+
+/**
+ * ログを1件積みます (割り込みルーチンからも呼べます)
+ * 直接呼ばずに LOG_TRACE() などのマクロを使ってください
+ * リングが一杯なら一番古いログを上書きします
+ */
+void log_post(log_level_t level, const char* fmt, int nargs, ...);
+
+/**
+ * cursorの位置のログを1件読んでcursorを進めます (リングからは取り除きません)。無ければfalseを返します
+ * cursorは最初に0を入れておく。読む前に上書きされていたら残っている一番古いログから読み、飛ばした件数をlostに足します (NULL可)
+ */
+bool log_read(uint32_t* cursor, log_entry_t* entry, uint32_t* lost);
+
+/**
+ * ログ1件をprintFで書式化して出力します
+ */
+void log_format(void (*putchar)(char c), const log_entry_t* entry);
+
+/**
+ * ログ1件を、時刻とレベルを付けて1行で出力します (必ず改行で終わります)
+ */
+void log_format_line(void (*putchar)(char c), const log_entry_t* entry);
+
+void log_set_level(log_level_t level);
+log_level_t log_get_level(void);
+const log_stats_t* log_get_stats(void);
+
+// 引数の数を数える (0〜LOG_MAX_ARGS個)
+#define LOG_NARGS_(_0, _1, _2, _3, _4, N, ...) N
+#define LOG_NARGS(...) LOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+
+#define LOG_POST(level, fmt, ...) log_post(level, fmt, LOG_NARGS(__VA_ARGS__), ##__VA_ARGS__)
+
+#if LOG_LEVEL_MIN <= 0
+#define LOG_TRACE(fmt, ...) LOG_POST(LOG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
+#else
+#define LOG_TRACE(fmt, ...) ((void)0)
+#endif
+#if LOG_LEVEL_MIN <= 1
+#define LOG_INFO(fmt, ...) LOG_POST(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) ((void)0)
+#endif
+#if LOG_LEVEL_MIN <= 2
+#define LOG_WARN(fmt, ...) LOG_POST(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) ((void)0)
+#endif
+#define LOG_ERROR(fmt, ...) LOG_POST(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+
+#endif  // LOG_RING_H
@@ -16,19 +16,37 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "build_profile.h"
 #include "ch32fun.h"
+#include "event/event_queue.h"
 #include "funconfig.h"
 #include "greenpak/greenpak_auto.h"
 #include "greenpak/greenpak_control.h"
+#include "i2c/i2c_async.h"
+#include "i2c/i2c_profile.h"
 #include "ina3221/ina3221_control.h"
 #include "led/led_control.h"
+#include "log/flash_log.h"
+#include "log/log_ring.h"
 #include "oled/oled_control.h"
 #include "pcfdd/pcfdd_control.h"
 #include "power/power_control.h"
+#include "sched/scheduler.h"
 #include "sound/play_control.h"
+#include "telemetry/telemetry.h"
+#include "timebase/timebase.h"
+#include "trend/trend.h"
 #include "ui/ui_control.h"
+#include "wdt/wdt_control.h"
 #include "x68fdd/x68fdd_control.h"
 
+// I2Cエンジンの監視 (止まったトランザクションを打ち切ってバスを復旧する)
+static void i2c_watch_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
+    (void)ctx;
+    i2c_async_check_timeout();
+    i2c_stats_poll(systick_ms);
+}
+
 int main() {
     SystemInit();
 
@@ -252,6 +270,23 @@ int main() {
     GPIOC->CFGLR |= (GPIO_Speed_50MHz | GPIO_CNF_OUT_PP) << (4 * 6);
     GPIOC->BCR = (1 << 6);  // Disable (Low)
 
+    //
+    // 時刻管理(SysTick)を開始する
+    // 以降は time_ms() / time_us() と、ソフトウェアタイマーが使える
+    //
+    timebase_init();
+
+    // リセット要因を調べる (ウォッチドッグ自体はメインループの直前で開始する)
+    wdt_init();
+
+    // フラッシュのイベントログの続きを書く位置を調べる
+    flashlog_init();
+
+#if FEATURE_TELEMETRY
+    // デバッグリンクへのテレメトリ (デバッガが読み取り始めたら送り出す)
+    telemetry_init();
+#endif
+
     //
     // コンテキストの初期化
     //
@@ -260,9 +295,6 @@ int main() {
     // UIシステムを初期化する
     ui_init(ctx);
     ui_change_page(UI_PAGE_MAIN);
-    ui_cursor(UI_PAGE_BOOT, 0, 2);
-    ui_print(UI_PAGE_BOOT, "      Minyas X\n");
-    ui_print(UI_PAGE_BOOT, "    - Sleeping -\n");
 
     Delay_Ms(1000);
     ui_change_page(UI_PAGE_LOG);
@@ -270,6 +302,16 @@ int main() {
     // INA3221を最初に初期化して電圧電流を測定できるようにする
     ina3221_init();
 
+    // I2Cデバイスごとに使えるバスクロックを読み返しテストで決める
+    // (GreenPAKの検証もこのクロックで行うので、自動プログラムより前に行う)
+    i2c_profile_calibrate();
+    for (int dev = 0; dev < I2C_DEV_NUM; dev++) {
+        const i2c_profile_t* prof = i2c_profile_get((i2c_dev_t)dev);
+        if (prof->validated) {
+            ui_printf(UI_PAGE_LOG, "I2C %s%dk\n", i2c_dev_name((i2c_dev_t)dev), (int)(i2c_speed_hz(prof->speed) / 1000));
+        }
+    }
+
     //
     // greenpak_force_program_verify(0x02, 2);  // GreenPAK3を強制プログラム
 
@@ -334,34 +376,70 @@ int main() {
     // 音再生テスト
     // play_start_melody(ctx, &melody_power_on);
 
-    //    ui_log_set_level(UI_LOG_LEVEL_INFO);
-    ui_log_set_level(UI_LOG_LEVEL_TRACE);
+    // 実行時のログレベルは、ビルドプロファイルで残したレベルに合わせる
+    log_set_level((log_level_t)LOG_LEVEL_MIN);
+
+    // 各モジュールの定期処理をタスクとして登録する
+    // (名前, 関数, 周期ms, 位相ms, デッドラインms, 優先度)
+    sched_init();
+    sched_add("power", power_control_poll, 500, 0, 0, 1);
+    sched_add("i2c", i2c_watch_poll, 10, 7, 0, 4);
+    sched_add("flog", flashlog_poll, 500, 250, 0, 7);
+#if FEATURE_TELEMETRY
+    sched_add("tlm", telemetry_poll, TELEMETRY_POLL_MS, 1, 0, 7);
+#endif
+    // 以下はX68000の電源が入っている間だけ動かすタスク
+    const int powered_tasks[] = {
+        sched_add("led", WS2812_SPI_poll, LED_FRAME_INTERVAL_MS, 0, 0, 6),
+        sched_add("ina", ina3221_poll, 1000, 100, 0, 5),
+        sched_add("pcfdd", pcfdd_poll, 10, 0, 0, 0),
+        sched_add("meas", pcfdd_measure_poll, 1000, 200, 0, 3),
+#if FEATURE_DEBUG_PAGES
+        sched_add("x68", x68fdd_poll, 1000, 300, 0, 5),  // 今はデバッグページの表示だけ
+#endif
+        sched_add("ui", ui_poll, 20, 5, 0, 2),
+        sched_add("key", ui_key_scan, UI_KEY_SCAN_MS, 2, 0, 2),
+        sched_add("play", play_poll, 10, 3, 0, 1),
+#if FEATURE_DASHBOARD
+        sched_add("trend", trend_sample, TREND_SAMPLE_MS, 150, 0, 6),
+#endif
+    };
+    const int num_powered_tasks = sizeof(powered_tasks) / sizeof(powered_tasks[0]);
+    bool powered = true;
+
+    // 前回ウォッチドッグでリセットされていたら、原因のタスクをログに残す
+    const wdt_info_t* wdt = wdt_get_info();
+    if (wdt->wdt_reset) {
+        const sched_task_t* offender = sched_get_task(wdt->offender);
+        ui_printf(UI_PAGE_LOG, "WDT RESET#%d %s\n", wdt->reset_count, offender ? offender->name : "?");
+        flashlog_add(FLOG_WDT_RESET, wdt->offender);
+    }
+    // 電源投入からメインループに入るまでの時間
+    ui_printf(UI_PAGE_LOG, "BOOT %dms\n", (int)time_ms());
+    flashlog_add(FLOG_BOOT, time_ms());
+    // ここから先はメインループが止まるとリセットされる
+    sched_start_watchdog();
 
     while (1) {
-        uint64_t systick = SysTick->CNT;
-        uint32_t ms = systick / (F_CPU / 1000);
-        power_control_poll(ctx, ms);
+        // 割り込みルーチンから通知されたイベントを発生順に処理する
+        event_dispatch(ctx);
 
+        if (ctx->power_on != powered) {
+            powered = ctx->power_on;
+            for (int i = 0; i < num_powered_tasks; i++) {
+                sched_set_enabled(powered_tasks[i], powered);
+            }
+        }
         if (ctx->power_on) {
             if (ui_get_current_page() == UI_PAGE_BOOT) {
                 ui_change_page(UI_PAGE_MAIN);
             }
-            ui_log_print(UI_LOG_LEVEL_TRACE, "1");
-            WS2812_SPI_poll(ctx, ms);
-            ui_log_print(UI_LOG_LEVEL_TRACE, "2");
-            ina3221_poll(ctx, ms);
-            ui_log_print(UI_LOG_LEVEL_TRACE, "3");
-            pcfdd_poll(ctx, ms);
-            ui_log_print(UI_LOG_LEVEL_TRACE, "4");
-            x68fdd_poll(ctx, ms);
-            ui_log_print(UI_LOG_LEVEL_TRACE, "5");
-            ui_poll(ctx, ms);
-            ui_log_print(UI_LOG_LEVEL_TRACE, "6");
-            play_poll(ctx, ms);
-            ui_log_print(UI_LOG_LEVEL_TRACE, "7");
         } else {
             // X68000側の電源ON要求が来るまで待機する
             ui_change_page(UI_PAGE_BOOT);
         }
+
+        // 実行可能なタスクを1つ実行する (無ければWFIで割り込みを待つ)
+        sched_run(ctx);
     }
 }
@@ -18,6 +18,14 @@
 
 #include "ssd1306_txt.h"
 
+#if OLED_FRAMEBUFFER > 0
+#include <string.h>
+
+#include "i2c/i2c_async.h"
+#include "i2c/i2c_stats.h"
+#include "timebase/timebase.h"
+#endif
+
 // ===================================================================================
 // Standard ASCII 5x8 Font (chars 32 - 127)
 // ===================================================================================
@@ -148,6 +156,9 @@ void OLED_init(void) {
     I2C_start(OLED_ADDR << 1);                                         // start transmission to OLED
     I2C_write(OLED_CMD_MODE);                                          // set command mode
     I2C_writeBuffer((uint8_t *)OLED_INIT_CMD, sizeof(OLED_INIT_CMD));  // send the command bytes
+#if OLED_FRAMEBUFFER > 0
+    OLED_invalidate();  // the panel contents are unknown after power-up
+#endif
 }
 
 // Switch display on/off (0: display off, 1: display on)
@@ -193,6 +204,149 @@ void OLED_vscroll(uint8_t y) {
     I2C_stop();                 // stop transmission
 }
 
+// ハードウェアスクロールの量 (文字の行単位)
+// 画面の行 y は、表示RAMのページ (y + OLED_row_off) % 8 に対応する
+static uint8_t OLED_row_off;
+#define OLED_ROW(y) (((y) + OLED_row_off) % (OLED_HEIGHT / 8))
+
+// Scroll the whole screen up by n text lines using the display offset
+// (the contents move with it; only the lines that should change need to be redrawn)
+void OLED_scrollLines(uint8_t n) {
+    OLED_row_off = (OLED_row_off + n) % (OLED_HEIGHT / 8);
+    OLED_vscroll(OLED_row_off * 8);
+}
+
+// ===================================================================================
+// OLED Frame Buffer
+// ===================================================================================
+
+#if OLED_FRAMEBUFFER > 0
+
+// 画面の内容をRAMに持ち、描画関数はここを書き換えるだけにする。
+// 内容が変わったカラムの範囲をページごとに覚えておき、OLED_flush() でその範囲だけを
+// 割り込み/DMAのI2Cエンジンで送る (ページごとにコマンド1回+データ1回のトランザクション)。
+// 1ページ送り終わると完了コールバック(割り込み)で次の変更されたページを送るので、
+// 送信中に書き換えられた分は次の転送にまとめられる。
+
+#define OLED_PAGES_NUM (OLED_HEIGHT / 8)
+
+static uint8_t OLED_fb[OLED_PAGES_NUM][OLED_WIDTH];  // 画面の内容
+static uint8_t OLED_dirty_lo[OLED_PAGES_NUM];        // 未送信のカラム範囲 (lo > hi なら無し)
+static uint8_t OLED_dirty_hi[OLED_PAGES_NUM];
+
+static uint8_t OLED_cmd_buf[4];               // ページとカラムの設定コマンド
+static uint8_t OLED_dat_buf[1 + OLED_WIDTH];  // 送信中のデータ (先頭はデータモードの制御バイト)
+static i2c_xfer_t OLED_cmd_xfer;
+static i2c_xfer_t OLED_dat_xfer;
+static volatile bool OLED_flushing;  // 転送中か
+static uint8_t OLED_flush_page;      // 次に調べるページ (順番に回す)
+static uint8_t OLED_flush_lo;        // 送信中のカラム範囲 (エラー時に戻す)
+static uint8_t OLED_flush_hi;
+
+// カラム範囲を未送信にする (転送の完了割り込みと取り合うので割り込み禁止で更新する)
+static void OLED_mark(uint8_t page, uint8_t lo, uint8_t hi) {
+    uint32_t mstatus = irq_save();
+    if (OLED_dirty_lo[page] > OLED_dirty_hi[page]) {
+        OLED_dirty_lo[page] = lo;  // 未送信の範囲が無かった
+        OLED_dirty_hi[page] = hi;
+    } else {
+        if (lo < OLED_dirty_lo[page]) OLED_dirty_lo[page] = lo;
+        if (hi > OLED_dirty_hi[page]) OLED_dirty_hi[page] = hi;
+    }
+    irq_restore(mstatus);
+}
+
+// バッファに書き込み、内容が変わった範囲だけを未送信にする
+static void OLED_fb_write(uint8_t x, uint8_t page, const uint8_t *data, uint8_t len, uint8_t invert) {
+    if (page >= OLED_PAGES_NUM || x >= OLED_WIDTH) return;
+    if (len > OLED_WIDTH - x) len = OLED_WIDTH - x;
+    int lo = -1, hi = -1;
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t v = data ? data[i] : 0x00;
+        if (invert) v = ~v;
+        if (OLED_fb[page][x + i] != v) {
+            OLED_fb[page][x + i] = v;
+            if (lo < 0) lo = x + i;
+            hi = x + i;
+        }
+    }
+    if (lo >= 0) OLED_mark(page, (uint8_t)lo, (uint8_t)hi);
+}
+
+// 次に送るページを選んで転送を始める (割り込み禁止か完了割り込みの中で呼ぶ)
+static bool OLED_flush_next(void) {
+    for (uint8_t i = 0; i < OLED_PAGES_NUM; i++) {
+        uint8_t page = (OLED_flush_page + i) % OLED_PAGES_NUM;
+        uint8_t lo = OLED_dirty_lo[page];
+        uint8_t hi = OLED_dirty_hi[page];
+        if (lo > hi) continue;
+        OLED_dirty_lo[page] = 0xff;
+        OLED_dirty_hi[page] = 0;
+        OLED_flush_page = page;
+        OLED_flush_lo = lo;
+        OLED_flush_hi = hi;
+
+        uint8_t col = lo + OLED_XOFF;
+        OLED_cmd_buf[0] = OLED_CMD_MODE;                  // set command mode
+        OLED_cmd_buf[1] = OLED_PAGE + page;               // set line
+        OLED_cmd_buf[2] = OLED_COLUMN_LOW | (col & 0xf);  // set column
+        OLED_cmd_buf[3] = OLED_COLUMN_HIGH | (col >> 4);
+        OLED_dat_buf[0] = OLED_DAT_MODE;
+        memcpy(&OLED_dat_buf[1], &OLED_fb[page][lo], hi - lo + 1);
+        OLED_cmd_xfer.wlen = sizeof(OLED_cmd_buf);
+        OLED_dat_xfer.wlen = 1 + hi - lo + 1;
+        // 同じ優先度のキューは順番に処理されるので、コマンドとデータを続けて積んでおける
+        i2c_submit(&OLED_cmd_xfer);
+        i2c_submit(&OLED_dat_xfer);
+        return true;
+    }
+    return false;
+}
+
+// データの転送が終わった (I2C割り込みのコンテキスト)
+static void OLED_flush_done(i2c_xfer_t *xfer) {
+    if (xfer->status != I2C_XFER_DONE) {
+        // 送れなかった範囲を未送信に戻し、次のOLED_flush()まで止める
+        OLED_mark(OLED_flush_page, OLED_flush_lo, OLED_flush_hi);
+        OLED_flushing = false;
+        return;
+    }
+    OLED_flush_page = (OLED_flush_page + 1) % OLED_PAGES_NUM;
+    OLED_flushing = OLED_flush_next();
+}
+
+// Start sending the changed parts of the frame buffer (returns immediately)
+void OLED_flush(void) {
+    uint32_t mstatus = irq_save();
+    if (!OLED_flushing) {
+        OLED_cmd_xfer.addr7 = OLED_ADDR;
+        OLED_cmd_xfer.wbuf = OLED_cmd_buf;
+        OLED_cmd_xfer.prio = I2C_PRIO_BULK;
+        OLED_cmd_xfer.cls = I2C_CLASS_OLED;
+        OLED_dat_xfer.addr7 = OLED_ADDR;
+        OLED_dat_xfer.wbuf = OLED_dat_buf;
+        OLED_dat_xfer.prio = I2C_PRIO_BULK;
+        OLED_dat_xfer.cls = I2C_CLASS_OLED;
+        OLED_dat_xfer.callback = OLED_flush_done;
+        OLED_flushing = OLED_flush_next();
+    }
+    irq_restore(mstatus);
+}
+
+// Is a flush still in progress?
+bool OLED_flush_busy(void) {
+    return OLED_flushing;
+}
+
+// Mark the whole screen as changed (the next flush resends everything)
+void OLED_invalidate(void) {
+    for (uint8_t page = 0; page < OLED_PAGES_NUM; page++) {
+        OLED_mark(page, 0, OLED_WIDTH - 1);
+    }
+}
+
+#endif  // OLED_FRAMEBUFFER > 0
+
 // ===================================================================================
 // OLED Text Functions
 // ===================================================================================
@@ -202,6 +356,11 @@ uint8_t OLED_x, OLED_y, OLED_i;
 
 // OLED clear line
 void OLED_clearLine(uint8_t y) {
+#if OLED_FRAMEBUFFER > 0
+    if (y >= OLED_PAGES_NUM) y = 0;
+    OLED_fb_write(0, OLED_ROW(y), NULL, OLED_WIDTH, 0);  // clear line
+    OLED_cursor(0, y);                         // set cursor to line start
+#else
     uint8_t i;
     OLED_cursor(0, y);                             // set cursor to line start
     I2C_start(OLED_ADDR << 1);                     // start transmission to OLED
@@ -209,6 +368,7 @@ void OLED_clearLine(uint8_t y) {
     for (i = OLED_WIDTH; i; i--) I2C_write(0x00);  // clear line
     I2C_stop();                                    // stop transmission
     OLED_cursor(0, y);                             // re-set cursor to line start
+#endif
 }
 
 // OLED clear screen
@@ -221,14 +381,16 @@ void OLED_clear(void) {
 void OLED_cursor(uint8_t x, uint8_t y) {
     if (y >= OLED_HEIGHT / 8) y = 0;  // limit y
     OLED_x = x;
-    OLED_y = y;                 // set cursor variables
-    x += OLED_XOFF;             // add offset
-    I2C_start(OLED_ADDR << 1);  // start transmission to OLED
-    I2C_write(OLED_CMD_MODE);   // set command mode
-    I2C_write(OLED_PAGE + y);   // set line
-    I2C_write(x & 0xf);         // set column
+    OLED_y = y;  // set cursor variables
+#if OLED_FRAMEBUFFER == 0
+    x += OLED_XOFF;                      // add offset
+    I2C_start(OLED_ADDR << 1);           // start transmission to OLED
+    I2C_write(OLED_CMD_MODE);            // set command mode
+    I2C_write(OLED_PAGE + OLED_ROW(y));  // set line
+    I2C_write(x & 0xf);                  // set column
     I2C_write((x >> 4) | 0x10);
     I2C_stop();  // stop transmission
+#endif
 }
 
 // OLED set text invert
@@ -266,11 +428,17 @@ void OLED_plotChar(char c) {
     if (OLED_sz == 0) {  // normal character (5x8)
 #endif
         if (OLED_x > OLED_WIDTH - 6) OLED_cursor(0, OLED_y + 1);
+#if OLED_FRAMEBUFFER > 0
+        uint8_t cell[6] = {0x00};  // space between characters + 5 columns
+        memcpy(&cell[1], &OLED_FONT[ptr], 5);
+        OLED_fb_write(OLED_x, OLED_ROW(OLED_y), cell, 6, OLED_i);
+#else
         I2C_start(OLED_ADDR << 1);        // start transmission to OLED
         I2C_write(OLED_DAT_MODE);         // set data mode
         I2C_write(OLED_i ? 0xff : 0x00);  // write space between characters
         for (uint8_t i = 5; i; i--) I2C_write(OLED_i ? ~OLED_FONT[ptr++] : OLED_FONT[ptr++]);
         I2C_stop();
+#endif
         OLED_x += 6;  // move cursor
 #if OLED_BIGCHARS > 0
     } else if (OLED_sz == 1) {  // v-stretched character (5x16)
@@ -359,6 +527,11 @@ void OLED_print(char *str) {
 // Draw bitmap (pointer *bmp) at cursor position width (w) in pixels, hight (h) in 8-pixel lines
 void OLED_drawBitmap(const uint8_t *bmp, uint8_t w, uint8_t h) {
     uint8_t y = OLED_y;
+#if OLED_FRAMEBUFFER > 0
+    for (uint8_t i = 0; i < h; i++, bmp += w) {
+        OLED_fb_write(OLED_x, OLED_ROW(y + i), bmp, w, OLED_i);
+    }
+#else
     while (h--) {
         I2C_start(OLED_ADDR << 1);  // start transmission to OLED
         I2C_write(OLED_DAT_MODE);   // set data mode
@@ -366,6 +539,7 @@ void OLED_drawBitmap(const uint8_t *bmp, uint8_t w, uint8_t h) {
         I2C_stop();
         OLED_cursor(OLED_x, OLED_y + 1);  // set next line
     }
+#endif
     OLED_cursor(OLED_x + w, y);  // move cursor
 }
 
@@ -376,6 +550,11 @@ void OLED_drawBitmap(const uint8_t *bmp, uint8_t w, uint8_t h) {
 // Clear a rectangle starting from cursor position
 void OLED_clearRect(uint8_t w, uint8_t h) {
     uint8_t y = OLED_y;
+#if OLED_FRAMEBUFFER > 0
+    for (uint8_t i = 0; i < h; i++) {
+        OLED_fb_write(OLED_x, OLED_ROW(y + i), NULL, w, OLED_i);
+    }
+#else
     while (h--) {
         I2C_start(OLED_ADDR << 1);                                    // start transmission to OLED
         I2C_write(OLED_DAT_MODE);                                     // set data mode
@@ -383,6 +562,7 @@ void OLED_clearRect(uint8_t w, uint8_t h) {
         I2C_stop();                                                   // stop transmission
         OLED_cursor(OLED_x, OLED_y + 1);                              // set next line
     }
+#endif
     OLED_cursor(OLED_x + w, y);  // move cursor
 }
 
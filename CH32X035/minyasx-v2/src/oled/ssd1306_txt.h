@@ -3,7 +3,8 @@
 // ===================================================================================
 //
 // Collection of the most necessary functions for controlling an SSD1306/SH1106 I2C
-// OLED for the display of simple text, working without a screen buffer.
+// OLED for the display of simple text. With OLED_FRAMEBUFFER the screen is kept in RAM
+// and only the changed column spans are sent by OLED_flush().
 //
 // Functions available:
 // --------------------
@@ -13,6 +14,7 @@
 // OLED_invert(v)               Invert display (0: inverse off, 1: inverse on)
 // OLED_flip(xflip,yflip)       Flip display (0: flip off, 1: flip on)
 // OLED_vscroll(y)              Scroll display vertically (0-64)
+// OLED_scrollLines(n)          Scroll the whole screen up by n text lines (display offset)
 // OLED_clear()                 Clear screen of OLED display
 // OLED_clearLine(y)            Clear line y
 //
@@ -27,6 +29,12 @@
 // OLED_drawBitmap(bmp,w,h)     Draw bitmap (pointer *bmp) at cursor position
 //                              width (w) in pixels, hight (h) in 8-pixel lines
 //
+// If the frame buffer is activated (see below):
+// ---------------------------------------------
+// OLED_flush()                 Start sending the changed parts of the frame buffer
+// OLED_flush_busy()            Check if a flush is still in progress
+// OLED_invalidate()            Mark the whole screen as changed
+//
 // If print functions are activated (see below, print.h must be included):
 // -----------------------------------------------------------------------
 // OLED_printf(f, ...)          printf (supports %s, %c, %d, %u, %x, %b, %02d, %%)
@@ -74,11 +82,12 @@ extern "C" {
 #define OLED_HEIGHT 64  // OLED height in pixels
 #define OLED_SH1106 0   // OLED driver - 0: SSD1306/SH1107, 1: SH1106
 
-#define OLED_BOOT_TIME 50  // OLED boot up time in milliseconds
-#define OLED_INIT_I2C 1    // 1: init I2C with OLED_init()
-#define OLED_XFLIP 1       // 1: flip screen in X-direction with OLED_init()
-#define OLED_YFLIP 1       // 1: flip screen in Y-direction with OLED_init()
-#define OLED_INVERT 0      // 1: invert screen with OLED_init()
+#define OLED_BOOT_TIME 50   // OLED boot up time in milliseconds
+#define OLED_INIT_I2C 1     // 1: init I2C with OLED_init()
+#define OLED_XFLIP 1        // 1: flip screen in X-direction with OLED_init()
+#define OLED_YFLIP 1        // 1: flip screen in Y-direction with OLED_init()
+#define OLED_INVERT 0       // 1: invert screen with OLED_init()
+#define OLED_FRAMEBUFFER 1  // 1: draw into a RAM frame buffer and send it with OLED_flush()
 
 // OLED Text Settings
 #define OLED_PRINT 1      // 1: include print functions (needs print.h)
@@ -126,6 +135,7 @@ void OLED_contrast(uint8_t val);               // Set display contrast (0-255)
 void OLED_invert(uint8_t val);                 // Invert display (0: inverse off, 1: inverse on)
 void OLED_flip(uint8_t xflip, uint8_t yflip);  // Flip display (0: flip off, 1: flip on)
 void OLED_vscroll(uint8_t y);                  // Scroll display vertically (0-64)
+void OLED_scrollLines(uint8_t n);              // Scroll the whole screen up by n text lines
 
 // OLED Text Functions
 void OLED_clear(void);                   // Clear screen
@@ -140,6 +150,12 @@ void OLED_plot_cursor(bool on);          // Show or hide cursor
 void OLED_textsize(uint8_t size);  // Set text size (0: 5x8, 1: 5x16, 2: 10x16)
 #endif
 
+#if OLED_FRAMEBUFFER > 0
+void OLED_flush(void);       // Start sending the changed parts of the frame buffer
+bool OLED_flush_busy(void);  // Check if a flush is still in progress
+void OLED_invalidate(void);  // Mark the whole screen as changed
+#endif
+
 // OLED Special Functions
 void OLED_drawBitmap(const uint8_t *bmp, uint8_t w, uint8_t h);
 void OLED_clearRect(uint8_t w, uint8_t h);
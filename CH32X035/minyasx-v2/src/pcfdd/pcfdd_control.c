@@ -3,8 +3,14 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+#include "build_profile.h"
 #include "ch32fun.h"
+#include "event/event_queue.h"
 #include "greenpak/greenpak_control.h"
+#include "log/flash_log.h"
+#include "log/log_ring.h"
+#include "telemetry/telemetry.h"
+#include "timebase/timebase.h"
 #include "ui/ui_control.h"
 
 #define BPS_TIM_PRESCALER_SHIFT 3                         // 実際に取り込む頻度を下げる頻度 (IC1PSCの値。0=1/1, 1=1/2, 2=1/4, 3=1/8)
@@ -66,7 +72,7 @@ void pcfdd_set_rpm_mode_select(drive_status_t* drive, fdd_rpm_mode_t rpm) {
 volatile uint32_t index_width[2] = {0, 0};  // [A,B]
 
 // ---- SysTick ベース内部状態 ----
-static volatile uint32_t s_last_edge_cycles = 0;  // 前回エッジ SysTick(48MHz)
+static volatile uint32_t s_last_edge_cycles = 0;  // 前回エッジの time_cycles() (48MHz)
 static volatile uint8_t s_have_prev_edge = 0;     // 初回保護
 
 typedef enum { DRIVE_NONE = -1, DRIVE_A = 0, DRIVE_B = 1 } drive_t;
@@ -96,7 +102,7 @@ void pcfdd_init(minyasx_context_t* ctx) {
     //
     // FDのINDEX信号(PA6)の立ち上がり/立ち下がりエッジを検出するために、Timer3 Channel1を使う
     // Timer3は Channel2で BeepのPWM出力でも使っていて、動的にタイムアウト値(ARR)が変更されてしまうので、
-    // Indexパルス幅の検出は、SysTick->CNTの値を直接読むことで実現している
+    // Indexパルス幅の検出は、time_cycles() (SysTickの48MHzカウンタ) の差で実現している
     //
 
     // プリスケーラを設定
@@ -179,13 +185,13 @@ void pcfdd_init(minyasx_context_t* ctx) {
 }
 
 /*
-  Timer3 IRQ: CC1IF -> エッジ検出（SysTick で幅計算）
+  Timer3 IRQ: CC1IF -> エッジ検出（time_cycles() の差で幅計算）
               UIF   -> タイムアウト監視（現在の対象ドライブに対して）
  */
 void TIM3_IRQHandler(void) __attribute__((interrupt));
 void TIM3_IRQHandler(void) {
     drive_t drv = current_drive_from_gpio();
-    uint32_t now_cycles = SysTick->CNT;
+    uint32_t now_cycles = time_cycles();
 
     // ---- UIF: タイムアウト監視（現在の対象ドライブに限定）----
     // スピーカーのPWMと兼用しているので、タイムアウトは起こらない場合があるので使えない
@@ -234,6 +240,68 @@ void TIM3_IRQHandler(void) {
     }
 }
 
+// ---- DISK_CHANGE 監視 ----
+#define DISK_CHANGE_DET_US (10000u)                         // 10msec継続したら検出とする
+static volatile uint32_t s_disk_change_start[2] = {0, 0};  // 検出開始時刻 (0=未検出)
+static volatile bool s_disk_change_posted[2] = {false, false};
+static volatile bool s_disk_change_pending[2] = {false, false};  // EVENT_DISK_CHANGEがまだ処理されていない
+
+/**
+ * SysTick割り込みから定期的に呼ばれ、INDEXのタイムアウトとDISK_CHANGEを監視します
+ * 状態の変化はイベントとしてメインループに通知します (DISK_CHANGE時のDISK_INの無効化だけはここで行う)
+ */
+void pcfdd_systick_handler(uint32_t now_cycles) {
+    // RPMのタイムアウト監視
+    drive_t drv = current_drive_from_gpio();
+    if (drv == DRIVE_NONE) {
+        // NONEなら(ドライブがどちらもアクティブでない場合)一旦リセット
+        s_current_drive = DRIVE_NONE;
+        s_have_prev_edge = 0;
+        s_last_edge_cycles = 0;
+    } else if (s_current_drive == DRIVE_NONE) {
+        // NONE→A/Bに変わった場合は、基準確立からやり直し
+        s_current_drive = drv;
+        s_have_prev_edge = 0;
+        s_last_edge_cycles = now_cycles;
+    } else {
+        // ここではタイムアウトのみ検出
+        // INDEXパルスが来ていれば、TIM3の「CC1IF」で処理される
+        uint32_t delta_us = (now_cycles - s_last_edge_cycles) / 48u;
+        if (delta_us > TIMEOUT_US && index_width[drv] != 0) {
+            index_width[drv] = 0;  // 500ms 以上エッジ無し → タイムアウト
+                                   // 基準は保持（次のエッジで復帰）
+            event_post(EVENT_INDEX_TIMEOUT, drv, 0);
+        }
+    }
+
+    // DISK_CHANGE_DOSV (PB8) がDrive Select中に一定時間継続したらメインループに通知する
+    uint32_t gpiob = GPIOB->INDR;
+    bool disk_change = (gpiob & (1 << 8)) == 0;  // DISK_CHANGE_DOSV = 0 (Low) active?
+    for (int drive = 0; drive < 2; drive++) {
+        bool drive_select = (gpiob & (1 << (2 + drive)));  // Drive Select A/B active?
+        if (!drive_select || !disk_change) {
+            s_disk_change_start[drive] = 0;
+            s_disk_change_posted[drive] = false;
+            continue;
+        }
+        if (s_disk_change_posted[drive]) {
+            continue;  // 継続中のDISK_CHANGEは通知済み
+        }
+        if (s_disk_change_start[drive] == 0) {
+            s_disk_change_start[drive] = now_cycles | 1;  // 0は未検出の意味なので避ける
+        } else if ((now_cycles - s_disk_change_start[drive]) / 48u >= DISK_CHANGE_DET_US) {
+            s_disk_change_posted[drive] = true;
+            s_disk_change_pending[drive] = true;
+            event_post(EVENT_DISK_CHANGE, drive, 0);
+            // X68000から見えるDISK_INは、メインループを待たずにここで無効にする
+            // (GP2,GP3の DISK_IN_x_n。メディア検出でINDEXが確認できたら改めて有効にする)
+            for (int unit = 2 - 1; unit <= 3 - 1; unit++) {
+                greenpak_update_virtualinput(unit, 1 << (5 - drive), 0);
+            }
+        }
+    }
+}
+
 /**
  * READ DATA の bps計測（片エッジ/整数）
  * 前提:
@@ -269,6 +337,7 @@ static volatile uint8_t g_active = 0xFF;
 
 /* last_dt など既存デバッグ変数は存続 */
 static volatile uint32_t dma_int_count;
+static volatile uint32_t dma_isr_cycles;  // 割り込みルーチンの実行サイクル数の累計 (負荷の計測用)
 uint16_t last_dt;
 
 /* --- しきい値（スケーリング S() 適用）--- */
@@ -392,6 +461,7 @@ static void process_block32(const volatile uint32_t* blk, size_t n) {
  */
 void DMA1_Channel2_IRQHandler(void) __attribute__((interrupt));
 void DMA1_Channel2_IRQHandler(void) {
+    uint32_t isr_start = time_cycles();
     dma_int_count++;
     uint32_t isr = DMA1->INTFR;
 
@@ -411,6 +481,16 @@ void DMA1_Channel2_IRQHandler(void) {
     // まれにCC1OF対策でINTFR/CVRを読んでフラグ掃除
     (void)TIM1->INTFR;
     (void)TIM1->CH1CVR;
+    dma_isr_cycles += time_cycles() - isr_start;
+}
+
+uint32_t pcfdd_capture_isr_cycles(void) {
+    return dma_isr_cycles;
+}
+
+uint32_t pcfdd_index_period_ms(int drive) {
+    if (drive < 0 || drive > 1) return 0;
+    return index_width[drive];
 }
 
 // 既存の分類カウンタ（classify_dt() で増やしているもの）
@@ -460,12 +540,25 @@ fdd_bps_mode_t pcfdd_bps_decide_and_reset(int drive) {
     rd_stats_t* S = (rd_stats_t*)&g_stats[drive];
 
     uint32_t c7 = S->cnt_7ish, c8 = S->cnt_8ish, c10 = S->cnt_10ish, c13 = S->cnt_13ish, c16 = S->cnt_16ish;
+#if FEATURE_TELEMETRY
+    uint32_t other = S->cnt_other;  // 以下で0に戻すので先に取っておく
+#endif
     S->cnt_7ish = S->cnt_8ish = S->cnt_10ish = S->cnt_13ish = S->cnt_16ish = S->cnt_other = 0;
 
     uint32_t votes = c7 + c8 + c10 + c13 + c16;
-    ui_cursor(UI_PAGE_DEBUG_PCFDD, 0, 3 + drive * 2);
-    ui_printf(UI_PAGE_DEBUG_PCFDD, "%d:%d:%d:%d:%d[%d:%d]\n",  //
-              (int)c7 / 10, (int)c8 / 10, (int)c10 / 10, (int)c13 / 10, (int)c16 / 10, (int)S->cnt_other / 10, (int)votes / 10);
+#if FEATURE_TELEMETRY
+    // 読んでいないドライブ(全て0)は送らない
+    if (votes + other > 0) {
+        telemetry_histogram(drive, c7, c8, c10, c13, c16, other);
+    }
+#endif
+#if FEATURE_DEBUG_PAGES
+    if (ui_get_current_page() == UI_PAGE_DEBUG_PCFDD) {
+        ui_cursor(UI_PAGE_DEBUG_PCFDD, 0, 3 + drive * 2);
+        ui_printf(UI_PAGE_DEBUG_PCFDD, "%d:%d:%d:%d:%d[%d:%d]\n",  //
+                  (int)c7 / 10, (int)c8 / 10, (int)c10 / 10, (int)c13 / 10, (int)c16 / 10, (int)S->cnt_other / 10, (int)votes / 10);
+    }
+#endif
     if (votes < VOTES_MIN) return BPS_UNKNOWN;
 
     uint32_t bins[5] = {c7, c8, c10, c13, c16};
@@ -481,6 +574,7 @@ fdd_bps_mode_t pcfdd_bps_decide_and_reset(int drive) {
 //
 
 static volatile pcfdd_ds_t g_current_ds = PCFDD_DS_NONE;
+static uint32_t g_last_select_ms = 0;  // 最後にDRIVE_SELECTが変化した時刻
 
 /* 別モジュールから現在のDRIVE_SELECT状態を通知する */
 void pcfdd_set_current_ds(pcfdd_ds_t ds) {
@@ -496,6 +590,10 @@ void pcfdd_set_current_ds(pcfdd_ds_t ds) {
     g_current_ds = ds;
 }
 
+bool pcfdd_bus_idle(uint32_t now_ms, uint32_t quiet_ms) {
+    return g_current_ds == PCFDD_DS_NONE && time_elapsed(now_ms, g_last_select_ms) >= quiet_ms;
+}
+
 //
 //
 //
@@ -515,7 +613,7 @@ void step_dosv(int drive) {
 }
 
 bool seek_to_track0(int drive) {
-    ui_printf(UI_PAGE_LOG, "Seek Track0 (D:%d)\n", drive);
+    LOG_INFO("Seek Track0 (D:%d)\n", drive);
     if (drive < 0 || drive > 1) {
         return false;
     }
@@ -582,18 +680,17 @@ static void process_media_detecting(minyasx_context_t* ctx, int drive) {
 
     // READY_MCUをInactiveにする
     GPIOB->BSHR = (drive == 0) ? GPIO_Pin_12 : GPIO_Pin_13;  // READY_MCU_A_n / READY_MCU_B_n (High=準備完了でない)
-    // GP2,GP3の DISK_IN_x_n をDisableにする
-    uint8_t gp2_vin = greenpak_get_virtualinput(2 - 1);
-    gp2_vin |= (1 << (5 - drive));  // bit4/5を1にして、DISK_IN_x_nをDisableにする
-    greenpak_set_virtualinput(2 - 1, gp2_vin);
-    uint8_t gp3_vin = greenpak_get_virtualinput(3 - 1);
-    gp3_vin |= (1 << (5 - drive));  // bit4/5を1にして、DISK_IN_x_nをDisableにする
-    greenpak_set_virtualinput(3 - 1, gp3_vin);
+    // GP2,GP3の DISK_IN_x_n をDisableにする (bit4/5を1にする)
+    greenpak_update_virtualinput(2 - 1, 1 << (5 - drive), 0);
+    greenpak_update_virtualinput(3 - 1, 1 << (5 - drive), 0);
+    greenpak_wait_virtualinput(2 - 1);
+    greenpak_wait_virtualinput(3 - 1);
 
     // 割り込みを禁止して、Drive Selectがアクティブな状態で確認する
-    uint32_t systick_start = SysTick->CNTL;
+    // (割り込み禁止中も進むように、time_ms()ではなくSysTickのカウンタで計る)
+    uint32_t systick_start = time_cycles();
     while (1) {
-        if ((SysTick->CNTL - systick_start) > (100 * 1000 * 48)) {
+        if (time_elapsed(time_cycles(), systick_start) > TIME_MS_TO_CYCLES(100)) {
             // 100msec以上待ってもDS0/DS1が解除されない場合は、一旦イジェクト状態で確定してしまう
             d->state = DRIVE_STATE_NO_MEDIA;
             d->rpm_measured = FDD_RPM_UNKNOWN;
@@ -611,6 +708,8 @@ static void process_media_detecting(minyasx_context_t* ctx, int drive) {
         Delay_Ms(10);  // 少し待つ
     }
     // ここには割り込み禁止状態かつ、DS0/DS1のいずれもアクティブでない状態で来る
+    // 割り込み禁止中のGreenPAKへの書き込み(STEPパルスやDISK_IN)は、I2Cエンジンを待つ側がフラグを見て進める
+    // (i2c_async_check_timeout() を参照)
 
     // 2. TRACK00にシークする
     // これをするとPC FDDの DISK_CHANGEもクリアされる
@@ -625,10 +724,10 @@ static void process_media_detecting(minyasx_context_t* ctx, int drive) {
     }
 
     // 4. 500msecの間に INDEXパルスが来るかを監視する
-    systick_start = SysTick->CNTL;
+    systick_start = time_cycles();
     bool index_low_seen = false;
     bool index_high_seen = false;
-    while ((SysTick->CNTL - systick_start) < (500 * 1000 * 48)) {
+    while (time_elapsed(time_cycles(), systick_start) < TIME_MS_TO_CYCLES(500)) {
         uint32_t gpioa = GPIOA->INDR;
         if ((gpioa & (1 << 6)) == 0) {
             // INDEX_DOSV (PA6) = 0 (Low) になった
@@ -656,8 +755,8 @@ static void process_media_detecting(minyasx_context_t* ctx, int drive) {
         d->state = DRIVE_STATE_READY;
         d->rpm_measured = FDD_RPM_UNKNOWN;
         d->bps_measured = BPS_UNKNOWN;
-        gp3_vin &= ~(1 << (5 - drive));  // bit4/5を0にして、DISK_IN_x_nをEnableにする
-        greenpak_set_virtualinput(3 - 1, gp3_vin);
+        greenpak_update_virtualinput(3 - 1, 0, 1 << (5 - drive));  // bit4/5を0にして、DISK_IN_x_nをEnableにする
+        greenpak_wait_virtualinput(3 - 1);
     }
 
     // 6. Drive Selectを非アクティブにする
@@ -675,13 +774,9 @@ static void process_no_media(minyasx_context_t* ctx, int drive) {
     // メディア無し状態の処理
     // 1. READY_MCUをInactiveにする
     GPIOB->BSHR = (drive == 0) ? GPIO_Pin_12 : GPIO_Pin_13;  // READY_MCU_A_n / READY_MCU_B_n (High=準備完了でない)
-    // 2. GP2,GP3の DISK_IN_x_n をDisableにする
-    uint8_t gp2_vin = greenpak_get_virtualinput(2 - 1);
-    gp2_vin |= (1 << (5 - drive));  // bit4/5を1にして、DISK_IN_x_nをDisableにする
-    greenpak_set_virtualinput(2 - 1, gp2_vin);
-    uint8_t gp3_vin = greenpak_get_virtualinput(3 - 1);
-    gp3_vin |= (1 << (5 - drive));  // bit4/5を1にして、DISK_IN_x_nをDisableにする
-    greenpak_set_virtualinput(3 - 1, gp3_vin);
+    // 2. GP2,GP3の DISK_IN_x_n をDisableにする (bit4/5を1にする)
+    greenpak_update_virtualinput(2 - 1, 1 << (5 - drive), 0);
+    greenpak_update_virtualinput(3 - 1, 1 << (5 - drive), 0);
 }
 
 static void process_ready(minyasx_context_t* ctx, int drive) {
@@ -700,14 +795,11 @@ static void process_ready(minyasx_context_t* ctx, int drive) {
         GPIOB->BSHR = (drive == 0) ? GPIO_Pin_12 : GPIO_Pin_13;  // READY_MCU_A_n / READY_MCU_B_n (High=準備完了でない)
     }
 
-    // 2. GP2,GP3の DISK_IN_x_n をEnableにする
-    uint8_t gp2_vin = greenpak_get_virtualinput(2 - 1);
-    gp2_vin &= ~(1 << (5 - drive));  // bit4/5を0にして、DISK_IN_x_nをEnableにする
-    greenpak_set_virtualinput(2 - 1, gp2_vin);
-
-    uint8_t gp3_vin = greenpak_get_virtualinput(3 - 1);
-    gp3_vin &= ~(1 << (5 - drive));  // bit4/5を0にして、DISK_IN_x_nをEnableにする
-    greenpak_set_virtualinput(3 - 1, gp3_vin);
+    // 2. GP2,GP3の DISK_IN_x_n をEnableにする (bit4/5を0にする)
+    // DISK_CHANGEを割り込みルーチンで検出してDisableにした後、イベントが処理されるまでは戻さない
+    if (s_disk_change_pending[drive]) return;
+    greenpak_update_virtualinput(2 - 1, 0, 1 << (5 - drive));
+    greenpak_update_virtualinput(3 - 1, 0, 1 << (5 - drive));
 }
 
 void pcfdd_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
@@ -737,6 +829,8 @@ void pcfdd_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
             break;
         }
     }
+    // 両ドライブ分のVirtual Inputの変更をまとめてGreenPAKに書く (変化が無ければI2Cアクセスしない)
+    greenpak_flush();
 
     // DISK_CHANGE_DOSV (PB8) の変化を監視し、変化があったらメディア検出状態に遷移する
 #if 0
@@ -752,7 +846,7 @@ void pcfdd_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
                 if (disk_change_count[drive] >= 3) {
                     // 3回連続でDISK_CHANGEがアサートされている
                     disk_change_count[drive] = 0;
-                    ui_printf(UI_PAGE_LOG, "D%d: Disk Chg det\n", drive);
+                    LOG_INFO("D%d: Disk Chg det\n", drive);
                     if (drv->state == DRIVE_STATE_READY) {
                         // READY状態でDISK_CHANGEがアサートされたらメディア検出状態に遷移する
                         // アクセス中なのでちょっと怖いが……
@@ -769,65 +863,14 @@ void pcfdd_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
         }
     }
 #endif
-    for (int drive = 0; drive < 2; drive++) {
-        drive_status_t* drv = &ctx->drive[drive];
-        uint32_t systick_start = SysTick->CNTL;
-        bool disk_change_det = true;
-        while ((SysTick->CNTL - systick_start) < (10 * 1000 * 48)) {  // 10msec継続しているか
-            uint32_t gpiob = GPIOB->INDR;
-            bool drive_select = (gpiob & (1 << (2 + drive)));  // Drive Select A/B active?
-            bool disk_change = (gpiob & (1 << 8)) == 0;        // DISK_CHANGE_DOSV = 0 (Low) active?
-            if (!drive_select || !disk_change) {
-                disk_change_det = false;
-                break;
-            }
-        }
-        if (disk_change_det) {
-            ui_printf(UI_PAGE_LOG, "Disk Chg det %1d\n", drive);
-            if (drv->state == DRIVE_STATE_READY) {
-                // READY状態でDISK_CHANGEがアサートされたらメディア検出状態に遷移する
-                // アクセス中なのでちょっと怖いが……
-                drv->state = DRIVE_STATE_MEDIA_DETECTING;
-            }
-            if (drv->state == DRIVE_STATE_NO_MEDIA) {
-                // NO_MEDIAでDISK_CHANGEがアサートされたらメディア検出状態に遷移する
-                drv->state = DRIVE_STATE_MEDIA_DETECTING;
-            }
-        }
-    }
-
-    // RPMとBPSの計測を1秒毎に行う
-    static uint64_t last_tick = 0;
-    if (systick_ms - last_tick < 1000) {
-        return;
-    }
-    last_tick = systick_ms;
-
-    // RPMのタイムアウト監視
-    {
-        uint32_t now_cycles = SysTick->CNT;
-        drive_t drv = current_drive_from_gpio();
-        if (drv == DRIVE_NONE) {
-            // NONEなら(ドライブがどちらもアクティブでない場合)一旦リセット
-            s_current_drive = DRIVE_NONE;
-            s_have_prev_edge = 0;
-            s_last_edge_cycles = 0;
-        } else if (s_current_drive == DRIVE_NONE) {
-            // NONE→A/Bに変わった場合は、基準確立からやり直し
-            s_current_drive = drv;
-            s_have_prev_edge = 0;
-            s_last_edge_cycles = now_cycles;
+    // DISK_CHANGEの検出は pcfdd_systick_handler() で行い、EVENT_DISK_CHANGE で通知される
+}
 
-        } else {
-            // ここではタイムアウトのみ検出
-            // INDEXパルスが来ていれば、後述の「CC1IF」で処理される
-            uint32_t delta_us = (now_cycles - s_last_edge_cycles) / 48u;
-            if (delta_us > TIMEOUT_US) {
-                index_width[drv] = 0;  // 500ms 以上エッジ無し → タイムアウト
-                                       // 基準は保持（次のエッジで復帰）
-            }
-        }
-    }
+/**
+ * RPMとBPSの計測結果を反映する (1秒周期のタスク)
+ */
+void pcfdd_measure_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
+    // RPMのタイムアウト監視は pcfdd_systick_handler() で行う
 
     // RPMの計測結果を反映
     for (int drive = 0; drive < 2; drive++) {
@@ -853,10 +896,68 @@ void pcfdd_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
     ctx->drive[0].bps_measured = bps0;
     ctx->drive[1].bps_measured = bps1;
 
+#if FEATURE_DEBUG_PAGES
+    if (ui_get_current_page() != UI_PAGE_DEBUG_PCFDD) {
+        return;  // 以下はデバッグページの表示用
+    }
+    // イベントキューの統計 (積んだ数/捨てた数/最大使用段数)
+    const event_stats_t* evs = event_get_stats();
+    ui_cursor(UI_PAGE_DEBUG_PCFDD, 0, 7);
+    ui_printf(UI_PAGE_DEBUG_PCFDD, "EV%6d DRP%3d HW%2d", (int)evs->posted, (int)evs->dropped, (int)evs->high_water);
+
+    // GreenPAKシャドウレジスタの統計 (書き込み要求/省略した数/実際のバースト数)
+    const gp_shadow_stats_t* gps = greenpak_get_shadow_stats();
+    ui_cursor(UI_PAGE_DEBUG_PCFDD, 0, 6);
+    ui_printf(UI_PAGE_DEBUG_PCFDD, "GPW R%5d S%5d B%4d", (int)gps->requests, (int)gps->skipped, (int)gps->bursts);
+
 #if 0
     ui_cursor(UI_PAGE_DEBUG_PCFDD, 0, 4);
     ui_printf(UI_PAGE_DEBUG_PCFDD, "BPS:%3dk BPS:%3dk", fdd_bps_mode_to_value(bps0) / 1000, fdd_bps_mode_to_value(bps1) / 1000);
 #endif
+#endif  // FEATURE_DEBUG_PAGES
+}
+
+void pcfdd_handle_event(minyasx_context_t* ctx, const event_t* ev) {
+    if (ev->drive > 1) return;
+    drive_status_t* drv = &ctx->drive[ev->drive];
+
+    switch (ev->type) {
+    case EVENT_DRIVE_SELECT:
+    case EVENT_DRIVE_DESELECT:
+        // PC FDD側の信号は割り込みルーチンで即座に切り替え済み
+        g_last_select_ms = time_ms();
+        break;
+    case EVENT_EJECT_REQUEST:
+        flashlog_add(FLOG_EJECT, ev->drive);
+        pcfdd_force_eject(ctx, ev->drive);
+        break;
+    case EVENT_MASK_CHANGE:
+        drv->eject_masked = (ev->arg & EVENT_MASK_EJECT_MASKED) != 0;
+        drv->led_blink = (ev->arg & EVENT_MASK_LED_BLINK) != 0;
+        break;
+    case EVENT_DISK_CHANGE:
+        s_disk_change_pending[ev->drive] = false;
+        LOG_INFO("Disk Chg det %1d\n", ev->drive);
+        flashlog_add(FLOG_MEDIA_CHANGE, ev->drive);
+        if (drv->state == DRIVE_STATE_READY) {
+            // READY状態でDISK_CHANGEがアサートされたらメディア検出状態に遷移する
+            // アクセス中なのでちょっと怖いが……
+            drv->state = DRIVE_STATE_MEDIA_DETECTING;
+        }
+        if (drv->state == DRIVE_STATE_NO_MEDIA) {
+            // NO_MEDIAでDISK_CHANGEがアサートされたらメディア検出状態に遷移する
+            drv->state = DRIVE_STATE_MEDIA_DETECTING;
+        }
+        break;
+    case EVENT_INDEX_TIMEOUT:
+        drv->rpm_measured = FDD_RPM_UNKNOWN;
+        break;
+    case EVENT_SPEED_CHANGE:
+        // MODE_SELECT_DOSVは割り込みルーチンで切り替え済み
+        break;
+    default:
+        break;
+    }
 }
 
 void pcfdd_update_setting(minyasx_context_t* ctx, int drive) {
@@ -1,12 +1,25 @@
 #ifndef PCFDD_CONTROL_H
 #define PCFDD_CONTROL_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "event/event_queue.h"
 #include "minyasx.h"
 
 void pcfdd_init(minyasx_context_t* ctx);
 void pcfdd_poll(minyasx_context_t* ctx, uint32_t systick_ms);
+void pcfdd_measure_poll(minyasx_context_t* ctx, uint32_t systick_ms);
+
+/**
+ * SysTick割り込みから呼ばれ、INDEXのタイムアウトとDISK_CHANGEを監視します
+ */
+void pcfdd_systick_handler(uint32_t now_cycles);
+
+/**
+ * 割り込みルーチンから通知されたイベントを処理します (メインループから呼ぶ)
+ */
+void pcfdd_handle_event(minyasx_context_t* ctx, const event_t* ev);
 
 /* 別モジュールから現在のDRIVE_SELECT状態を通知する */
 typedef enum {
@@ -17,6 +30,11 @@ typedef enum {
 
 void pcfdd_set_current_ds(pcfdd_ds_t ds);
 
+/**
+ * どのドライブも選択されておらず、最後に選択が変化してから quiet_ms 以上経っていれば true を返します
+ */
+bool pcfdd_bus_idle(uint32_t now_ms, uint32_t quiet_ms);
+
 void pcfdd_set_rpm_mode_select(drive_status_t* drive, fdd_rpm_mode_t rpm);
 
 uint32_t fdd_bps_mode_to_value(fdd_bps_mode_t m);
@@ -45,4 +63,14 @@ void pcfdd_detect_media(minyasx_context_t* ctx, int drive);  // drive: 0=FDD_A o
 
 char* pcfdd_state_to_string(drive_state_t state);
 
+/**
+ * INDEXパルスの周期 (msec, 計測できていなければ0)
+ */
+uint32_t pcfdd_index_period_ms(int drive);
+
+/**
+ * READ_DATAのキャプチャ割り込み(DMA)の実行サイクル数の累計 (48MHz, ラップアラウンドする)
+ */
+uint32_t pcfdd_capture_isr_cycles(void);
+
 #endif
\ No newline at end of file
@@ -29,8 +29,14 @@
 
 #include "power/power_control.h"
 
+#include "build_profile.h"
 #include "greenpak/greenpak_control.h"
+#include "i2c/i2c_stats.h"
 #include "ina3221/ina3221_control.h"
+#include "log/flash_log.h"
+#include "log/log_ring.h"
+#include "sched/scheduler.h"
+#include "timebase/timebase.h"
 #include "ui/ui_control.h"
 #include "usbpd/usbpd_sink.h"
 
@@ -96,11 +102,13 @@ bool activate_pd_12v(minyasx_context_t* ctx) {
         ui_print(UI_PAGE_LOG, " -> request 12V\n");
         if (PD_setPDO(pd_12v_pdo, 12000)) {
             ui_print(UI_PAGE_LOG, " -> 12V OK\n");
+            flashlog_add(FLOG_PD_12V, ((uint32_t)pd_12v_pdo << 16) | 12000);
             // +12Vに切り替わったことを確認できたら、+12VラインをEnableします。
             GPIOA->BSXR = (1 << (19 - 16));  // Enable (+12V_EN=High)
             return true;
         } else {
             ui_print(UI_PAGE_LOG, " -> 12V NG\n");
+            flashlog_add(FLOG_PD_12V, (uint32_t)pd_12v_pdo << 16);
             pd_12v_pdo = -1;
         }
     } else {
@@ -141,8 +149,8 @@ void enable_fdd_power(minyasx_context_t* ctx, bool enable) {
         if ((GPIOA->INDR & (1 << 17)) == 0) {
             // 外部+12V電源が接続されている
             GPIOA->BSXR = (1 << (20 - 16));  // Enable (+12V_EXT_EN=High)
-            ui_print(UI_PAGE_LOG, "+12V_EXT_DET active");
-            ui_write(UI_PAGE_LOG, '\n');
+            LOG_INFO("+12V_EXT_DET active\n");
+            flashlog_add(FLOG_EXT_12V, 0);
         } else {
             // 外部+12V電源が接続されていない
             // ● 2.USB-PDのネゴシエーション
@@ -154,12 +162,11 @@ void enable_fdd_power(minyasx_context_t* ctx, bool enable) {
                 uint16_t ch1_current, ch1_voltage, ch2_current, ch2_voltage, ch3_current, ch3_voltage;
                 ina3221_read_all_channels(&ch1_current, &ch1_voltage, &ch2_current, &ch2_voltage, &ch3_current, &ch3_voltage);
                 if (ch1_voltage >= 4750 && ch1_voltage <= 5500) {
-                    ui_print(UI_PAGE_LOG, "VBUS 5V OK");
-                    ui_write(UI_PAGE_LOG, '\n');
+                    LOG_INFO("VBUS 5V OK\n");
                     GPIOA->BSXR = (1 << (18 - 16));  // Enable (+5V_EN=High)
                 } else {
-                    ui_printf(UI_PAGE_LOG, "VBUS 5V NG %dmV", ch1_voltage);
-                    ui_write(UI_PAGE_LOG, '\n');
+                    LOG_WARN("VBUS 5V NG %dmV\n", ch1_voltage);
+                    flashlog_add(FLOG_VBUS_NG, ch1_voltage);
                 }
             }
         }
@@ -189,12 +196,17 @@ static uint32_t last_indexlow_ms = 0;
 
 const int GP_UNIT = 2;  // GreenPAK3を使う
 
+static void power_detect_poll(minyasx_context_t* ctx, uint32_t systick_ms);
+
 void power_control_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
-    static uint32_t last_systick_ms = 0;
-    if (systick_ms - last_systick_ms < 500) {
-        return;
-    }
-    last_systick_ms = systick_ms;
+    // 500msec周期のタスクとしてスケジューラから呼ばれる
+    // この中のI2Cアクセスは電源検出として集計する
+    i2c_class_t prev = i2c_set_class(I2C_CLASS_PWR);
+    power_detect_poll(ctx, systick_ms);
+    i2c_set_class(prev);
+}
+
+static void power_detect_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
 
     // X68Kの電源が入っているかどうかをチェックする
     // ● OFF状態から、ONになったことの検出方法
@@ -208,9 +220,11 @@ void power_control_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
     // * Lowだった場合は、、500msec後にD-FFの出力を読み、クリアされたままならOFF状態になったと判断する
     // * D-FF (7) の出力は Matrix Input 46に接続されている
 
+#if FEATURE_DEBUG_PAGES
     ui_cursor(UI_PAGE_DEBUG, 0, 0);
+#endif
     if (last_indexlow_ms != 0) {
-        if (systick_ms < last_indexlow_ms + 500) {
+        if (time_elapsed(systick_ms, last_indexlow_ms) < 500) {
             return;  // 500msec待つ
         }
         // 500msec経過したので、D-FFの状態をチェックする
@@ -223,7 +237,11 @@ void power_control_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
         // D-FFがクリアされたままなのでOFF状態になったと判断する
         is_x68k_pwr_on = false;
         ctx->power_on = false;  // 起動ステータスを保存しておく
+#if FEATURE_DEBUG_PAGES
         ui_print(UI_PAGE_DEBUG, "X68K PWR OFF\n");
+#endif
+        flashlog_add(FLOG_X68K_OFF, 0);
+        flashlog_add(FLOG_LOOP_MAX, sched_get_stats()->max_loop_us);
         last_indexlow_ms = 0;
         enable_fdd_power(ctx, false);  // FDDの電源をOFFにする
         // TODO 本来このタイミングではないが、ここでGP_ENABLEをOFFにしておく
@@ -231,13 +249,8 @@ void power_control_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
         return;
     } else if (is_x68k_pwr_on) {
         // ON状態の時は、OFF状態になったかどうかをチェックする
-        // まずは、D-FFをクリアするために D-FFの nRESET につながっている Virtual Input7 (Bit0) を 1→0→1 にする
-        uint8_t vin = greenpak_get_virtualinput(GP_UNIT);
-        uint8_t vin0 = vin & ~(1 << 0);
-        uint8_t vin1 = vin0 | (1 << 0);
-        greenpak_set_virtualinput(GP_UNIT, vin1);
-        greenpak_set_virtualinput(GP_UNIT, vin0);
-        greenpak_set_virtualinput(GP_UNIT, vin1);
+        // まずは、D-FFをクリアするために D-FFの nRESET につながっている Virtual Input7 (Bit0) に Lowパルスを出す
+        greenpak_pulse_virtualinput(GP_UNIT, 1 << 0, true);
         // Matrix Input 11 (IO12 Digital Input) をチェックする
         bool index_state = greenpak_get_matrixinput(GP_UNIT, 11);
         if (index_state) {
@@ -254,7 +267,10 @@ void power_control_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
             // HighなのでON状態になったと判断する
             is_x68k_pwr_on = true;
             ctx->power_on = true;  // 起動ステータスを保存しておく
+#if FEATURE_DEBUG_PAGES
             ui_print(UI_PAGE_DEBUG, "X68K PWR ON \n");
+#endif
+            flashlog_add(FLOG_X68K_ON, 0);
             last_indexlow_ms = 0;
             enable_fdd_power(ctx, true);  // FDDの電源をONにする
             // TODO 本来このタイミングではないが、ここでGP_ENABLEをONにしておく
@@ -263,10 +279,15 @@ void power_control_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
         }
     }
 
+#if FEATURE_DEBUG_PAGES
+    if (ui_get_current_page() != UI_PAGE_DEBUG) {
+        return;  // 以下はデバッグページの表示用
+    }
     ui_cursor(UI_PAGE_DEBUG, 0, 1);
     for (int i = 0; i < 16; i++) {
         bool val = greenpak_get_matrixinput(GP_UNIT, i);
         if (i % 4 == 0) ui_write(UI_PAGE_DEBUG, ' ');
         ui_write(UI_PAGE_DEBUG, val ? '1' : '0');
     }
+#endif
 }
@@ -0,0 +1,219 @@
+#include "sched/scheduler.h"
+
+#include <stddef.h>
+
+#include "log/flash_log.h"
+#include "log/log_ring.h"
+#include "timebase/timebase.h"
+#include "wdt/wdt_control.h"
+
+static sched_task_t sched_tasks[SCHED_MAX_TASKS];
+static int sched_num_tasks = 0;
+static sched_stats_t sched_stats;
+
+static bool sched_wdt_running = false;
+static uint32_t sched_wdt_fed_ms = 0;
+static uint32_t sched_loop_start_us = 0;
+static bool sched_stall_flashed = false;
+static uint32_t sched_stall_flash_ms = 0;
+
+static inline uint32_t sched_now_ms(void) {
+    return time_ms();
+}
+
+// ラップアラウンドを考慮して a が b より前かどうか
+static inline bool sched_before(uint32_t a, uint32_t b) {
+    return time_after(b, a);
+}
+
+void sched_init(void) {
+    sched_num_tasks = 0;
+    sched_stats = (sched_stats_t){0};
+    sched_stats.window_ms = sched_now_ms();
+    sched_stats.worst_task = -1;
+    sched_loop_start_us = time_us();
+}
+
+int sched_add(const char* name, sched_task_func_t func, uint16_t period_ms, uint16_t phase_ms, uint16_t deadline_ms, uint8_t priority) {
+    if (sched_num_tasks >= SCHED_MAX_TASKS || func == NULL) {
+        return -1;
+    }
+    int id = sched_num_tasks++;
+    sched_task_t* t = &sched_tasks[id];
+    *t = (sched_task_t){0};
+    t->name = name;
+    t->func = func;
+    t->period_ms = (period_ms != 0) ? period_ms : 1;
+    t->deadline_ms = (deadline_ms != 0) ? deadline_ms : t->period_ms;
+    t->priority = priority;
+    t->enabled = true;
+    t->release_ms = sched_now_ms() + phase_ms;
+    t->deadline_at = t->release_ms + t->deadline_ms;
+    return id;
+}
+
+void sched_set_enabled(int id, bool enabled) {
+    if (id < 0 || id >= sched_num_tasks) return;
+    sched_task_t* t = &sched_tasks[id];
+    if (enabled && !t->enabled) {
+        // 再開時は今からリリースする
+        t->release_ms = sched_now_ms();
+        t->deadline_at = t->release_ms + t->deadline_ms;
+    }
+    t->late = false;
+    t->enabled = enabled;
+}
+
+void sched_start_watchdog(void) {
+    sched_wdt_fed_ms = sched_now_ms();
+    sched_wdt_running = true;
+    wdt_start();
+}
+
+void sched_clear_loop_hist(void) {
+    for (int i = 0; i < SCHED_LOOP_HIST_BUCKETS; i++) {
+        sched_stats.loop_hist[i] = 0;
+    }
+    sched_stats.max_loop_us = 0;
+}
+
+// ループ周期をヒストグラムに積む
+static void sched_update_loop_hist(void) {
+    uint32_t now_us = time_us();
+    uint32_t loop_us = time_elapsed(now_us, sched_loop_start_us);
+    sched_loop_start_us = now_us;
+
+    int b = 0;
+    for (uint32_t v = loop_us >> 7; v != 0 && b < SCHED_LOOP_HIST_BUCKETS - 1; v >>= 2) {
+        b++;
+    }
+    sched_stats.loop_hist[b]++;
+    if (loop_us > sched_stats.max_loop_us) {
+        sched_stats.max_loop_us = loop_us;
+    }
+}
+
+// すべてのタスクがデッドラインを守れている場合だけウォッチドッグをリフレッシュする
+static void sched_watchdog(uint32_t now_ms) {
+    if (!sched_wdt_running || time_elapsed(now_ms, sched_wdt_fed_ms) < SCHED_WDT_FEED_MS) {
+        return;
+    }
+    sched_wdt_fed_ms = now_ms;
+    for (int i = 0; i < sched_num_tasks; i++) {
+        sched_task_t* t = &sched_tasks[i];
+        if (!t->enabled) {
+            continue;
+        }
+        // 直近のジョブが遅れた、またはリリース済みのジョブがデッドラインを過ぎても実行されていない
+        if (t->late || sched_before(t->deadline_at, now_ms)) {
+            wdt_withhold();
+            return;
+        }
+    }
+    wdt_feed();
+}
+
+// 実行可能なタスクのうち、絶対デッドラインが最も近いものを選ぶ
+static sched_task_t* sched_pick(uint32_t now_ms) {
+    sched_task_t* best = NULL;
+    for (int i = 0; i < sched_num_tasks; i++) {
+        sched_task_t* t = &sched_tasks[i];
+        if (!t->enabled || sched_before(now_ms, t->release_ms)) {
+            continue;
+        }
+        if (best == NULL ||                                     //
+            sched_before(t->deadline_at, best->deadline_at) ||  //
+            (t->deadline_at == best->deadline_at && t->priority < best->priority)) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+static void sched_update_window(uint32_t now_ms) {
+    sched_stats.acc_loops++;
+    if (time_elapsed(now_ms, sched_stats.window_ms) < 1000) {
+        return;
+    }
+    sched_stats.window_ms = now_ms;
+    sched_stats.busy_us = sched_stats.acc_busy_us;
+    sched_stats.idle_us = sched_stats.acc_idle_us;
+    sched_stats.loops = sched_stats.acc_loops;
+    uint32_t total = sched_stats.busy_us + sched_stats.idle_us;
+    sched_stats.idle_pct = total ? (uint8_t)(sched_stats.idle_us * 100 / total) : 0;
+    sched_stats.acc_busy_us = 0;
+    sched_stats.acc_idle_us = 0;
+    sched_stats.acc_loops = 0;
+}
+
+void sched_run(minyasx_context_t* ctx) {
+    uint32_t now_ms = sched_now_ms();
+    sched_update_window(now_ms);
+    sched_update_loop_hist();
+    sched_watchdog(now_ms);
+
+    sched_task_t* t = sched_pick(now_ms);
+    if (t == NULL) {
+        // 実行可能なタスクが無いので、割り込みが来るまでコアを止める
+        // (SysTick割り込みが100usec毎に来るので、次のリリース時刻は最大100usec遅れで拾える)
+        uint32_t start = time_us();
+        __WFI();
+        sched_stats.acc_idle_us += time_elapsed(time_us(), start);
+        return;
+    }
+
+    int8_t id = (int8_t)(t - sched_tasks);
+
+    wdt_mark_running(id);
+    uint32_t start = time_us();
+    t->func(ctx, now_ms);
+    uint32_t run_us = time_elapsed(time_us(), start);
+    uint32_t end_ms = sched_now_ms();
+    wdt_mark_running(WDT_NO_TASK);
+
+    t->runs++;
+    t->last_run_us = run_us;
+    if (run_us > t->max_run_us) {
+        t->max_run_us = run_us;
+    }
+    t->late = sched_before(t->deadline_at, end_ms);
+    if (t->late) {
+        t->overruns++;
+        wdt_mark_late(id);
+    }
+    sched_stats.acc_busy_us += run_us;
+    if (run_us > sched_stats.worst_run_us) {
+        sched_stats.worst_run_us = run_us;
+        sched_stats.worst_task = id;
+    }
+    if (run_us >= SCHED_STALL_LOG_US) {
+        LOG_WARN("STALL %s %dms\n", t->name, (int)(run_us / 1000));
+        if (!sched_stall_flashed || time_elapsed(end_ms, sched_stall_flash_ms) >= SCHED_STALL_FLASH_INTERVAL_MS) {
+            sched_stall_flashed = true;
+            sched_stall_flash_ms = end_ms;
+            flashlog_add(FLOG_STALL, ((uint32_t)id << 24) | (run_us / 1000));
+        }
+    }
+
+    // 次のリリース時刻を決める
+    // 周期を丸ごと取りこぼしていた場合は、遅れを積み上げずに現在時刻から数え直す
+    t->release_ms += t->period_ms;
+    if (sched_before(t->release_ms, end_ms)) {
+        t->skips++;
+        t->release_ms = end_ms + t->period_ms;
+    }
+    t->deadline_at = t->release_ms + t->deadline_ms;
+}
+
+int sched_task_count(void) {
+    return sched_num_tasks;
+}
+
+const sched_task_t* sched_get_task(int id) {
+    if (id < 0 || id >= sched_num_tasks) return NULL;
+    return &sched_tasks[id];
+}
+
+const sched_stats_t* sched_get_stats(void) {
+    return &sched_stats;
+}
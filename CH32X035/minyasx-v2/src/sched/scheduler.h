@@ -0,0 +1,105 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "minyasx.h"
+
+//
+// メインループ用の協調型タスクスケジューラ
+//
+// 各モジュールの xxx_poll() をタスクとして登録し、周期(period)、初回の位相(phase)、
+// 相対デッドライン(deadline)、優先度(priority)を指定する。
+// 実行可能なタスクのうち、デッドラインが最も近いもの(EDF)から1つずつ実行する。
+// 実行可能なタスクが無い場合は、次のリリース時刻か割り込みが来るまで WFI でコアを止める。
+//
+// ウォッチドッグ(IWDG)は、登録されたすべてのタスクがデッドラインを守れている場合にだけリフレッシュする。
+// ブロッキングする処理でループが止まり続けると、WDT_TIMEOUT_MS でリセットされる。
+//
+
+// タスク関数の型 (既存の xxx_poll() と同じ形)
+typedef void (*sched_task_func_t)(minyasx_context_t* ctx, uint32_t systick_ms);
+
+#define SCHED_MAX_TASKS 16
+
+// ウォッチドッグをリフレッシュする間隔
+#define SCHED_WDT_FEED_MS 100
+
+// この時間以上かかったタスクの実行はログに残す
+#define SCHED_STALL_LOG_US 50000
+// フラッシュログに残すのはこの間隔に1回まで (同じ原因で続けて書き込まないように)
+#define SCHED_STALL_FLASH_INTERVAL_MS 1000
+
+// ループ周期のヒストグラム (4倍刻み)
+// [0]:<128us [1]:<512us [2]:<2ms [3]:<8ms [4]:<32ms [5]:<128ms [6]:<512ms [7]:それ以上
+#define SCHED_LOOP_HIST_BUCKETS 8
+
+typedef struct {
+    const char* name;        // タスク名 (表示用)
+    sched_task_func_t func;  // タスク関数
+    uint16_t period_ms;      // 周期
+    uint16_t deadline_ms;    // リリースからの相対デッドライン
+    uint8_t priority;        // デッドラインが同じ場合の優先度 (小さいほど優先)
+    bool enabled;            // falseの場合はディスパッチしない
+    uint32_t release_ms;     // 次のリリース時刻
+    uint32_t deadline_at;    // 現在のジョブの絶対デッドライン
+    // 統計
+    uint32_t runs;         // 実行回数
+    uint32_t overruns;     // デッドラインまでに終わらなかった回数
+    uint32_t skips;        // 周期を丸ごと取りこぼした回数
+    uint32_t last_run_us;  // 直近の実行時間
+    uint32_t max_run_us;   // 最大実行時間
+    bool late;             // 直近のジョブがデッドラインを超過したか
+} sched_task_t;
+
+typedef struct {
+    uint32_t busy_us;      // 直近1秒間のタスク実行時間
+    uint32_t idle_us;      // 直近1秒間のWFI時間
+    uint32_t loops;        // 直近1秒間のスケジューラのループ回数
+    uint8_t idle_pct;      // 直近1秒間のアイドル率 (%)
+    uint32_t window_ms;    // 集計窓の開始時刻
+    uint32_t acc_busy_us;  // 集計中のタスク実行時間
+    uint32_t acc_idle_us;  // 集計中のWFI時間
+    uint32_t acc_loops;    // 集計中のループ回数
+    // ループ周期 (sched_run() の呼び出し間隔)
+    uint32_t loop_hist[SCHED_LOOP_HIST_BUCKETS];  // ヒストグラム (起動から累計)
+    uint32_t max_loop_us;                         // 最大ループ周期
+    // 最も長く実行したタスク
+    int8_t worst_task;      // タスクID (まだ無ければ-1)
+    uint32_t worst_run_us;  // その実行時間
+} sched_stats_t;
+
+void sched_init(void);
+
+/**
+ * タスクを登録します
+ * period_ms   : 周期 (最小1msec。0を指定すると1msecになる)
+ * phase_ms    : 最初のリリースまでの遅延 (同じ周期のタスクをずらすのに使う)
+ * deadline_ms : リリースからの相対デッドライン (0の場合はperiodと同じ)
+ * priority    : デッドラインが同じ場合の優先度 (小さいほど優先)
+ * 戻り値はタスクID。登録できない場合は -1
+ */
+int sched_add(const char* name, sched_task_func_t func, uint16_t period_ms, uint16_t phase_ms, uint16_t deadline_ms, uint8_t priority);
+
+void sched_set_enabled(int id, bool enabled);
+
+/**
+ * ウォッチドッグを開始します。タスクの登録が終わってから呼んでください
+ */
+void sched_start_watchdog(void);
+
+// ループ周期のヒストグラムと最大値をクリアする
+void sched_clear_loop_hist(void);
+
+/**
+ * 実行可能なタスクを1つ実行します。無ければWFIで待ちます
+ * メインループから繰り返し呼んでください
+ */
+void sched_run(minyasx_context_t* ctx);
+
+int sched_task_count(void);
+const sched_task_t* sched_get_task(int id);
+const sched_stats_t* sched_get_stats(void);
+
+#endif  // SCHEDULER_H
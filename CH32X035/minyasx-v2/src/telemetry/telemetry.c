@@ -0,0 +1,239 @@
+#include "telemetry/telemetry.h"
+
+#include "build_profile.h"
+#include "ch32fun.h"
+#include "i2c/i2c_stats.h"
+#include "log/flash_log.h"
+#include "log/log_ring.h"
+#include "print.h"
+#include "sched/scheduler.h"
+#include "timebase/timebase.h"
+
+#if FEATURE_TELEMETRY
+
+#if defined(FUNCONF_USE_DEBUGPRINTF) && FUNCONF_USE_DEBUGPRINTF
+#error "FEATURE_TELEMETRY uses DMDATA0/1 by itself. Disable FUNCONF_USE_DEBUGPRINTF"
+#endif
+
+#define TLM_BUF_MASK (TELEMETRY_BUF_SIZE - 1)
+
+// DMDATA0 の最下位バイト (ch32funのdebugprintfと同じ形式)
+// bit7: デバイスが書き込んだデータがある (ホストが読み取ると0に戻す), bit0-3: バイト数+4
+#define TLM_DM_FULL 0x80
+#define TLM_DM_CHUNK 7  // 1回に送れるバイト数 (DMDATA0の上位3バイト + DMDATA1の4バイト)
+
+static uint8_t tlm_buf[TELEMETRY_BUF_SIZE];  // 送出待ち
+static uint32_t tlm_head = 0;                // 次に積む位置 (単調増加)
+static uint32_t tlm_tail = 0;                // 次に送る位置 (単調増加)
+static bool tlm_written = false;             // DMDATAに書いたデータがあるか
+static uint32_t tlm_written_ms = 0;          // それを書いた時刻
+static uint32_t tlm_stats_ms = 0;            // 前回 $ST/$PW を作った時刻
+static uint32_t tlm_log_cursor = 0;          // ログリングのどこまで $LG で送ったか
+static int tlm_fl_left = 0;                  // $FL でまだ送っていないレコード数
+static uint32_t tlm_fl_added = 0;            // 送り始めた時点のフラッシュログの追加数
+static telemetry_stats_t tlm_stats;
+
+// 組み立て中のレコード ($からチェックサムの前まで)
+static char tlm_line[TELEMETRY_LINE_MAX];
+static int tlm_len = 0;
+static bool tlm_overflow = false;
+
+static void tlm_putc(char c) {
+    // チェックサムと改行 (*HH\n) の分を残す
+    if (tlm_len < TELEMETRY_LINE_MAX - 4) {
+        tlm_line[tlm_len++] = c;
+    } else {
+        tlm_overflow = true;
+    }
+}
+
+static void tlm_begin(void) {
+    tlm_len = 0;
+    tlm_overflow = false;
+}
+
+// 送出待ちのバッファの空き
+static uint32_t tlm_free(void) {
+    return TELEMETRY_BUF_SIZE - (tlm_head - tlm_tail);
+}
+
+// チェックサムを付けて送出待ちに積む。入りきらなければ丸ごと捨てる
+static void tlm_commit(void) {
+    static const char hex[] = "0123456789ABCDEF";
+    uint8_t cs = 0;
+    for (int i = 1; i < tlm_len; i++) {
+        cs ^= (uint8_t)tlm_line[i];
+    }
+    tlm_line[tlm_len++] = '*';
+    tlm_line[tlm_len++] = hex[cs >> 4];
+    tlm_line[tlm_len++] = hex[cs & 0x0f];
+    tlm_line[tlm_len++] = '\n';
+
+    if (tlm_overflow || tlm_free() < (uint32_t)tlm_len) {
+        tlm_stats.dropped++;
+        return;
+    }
+    for (int i = 0; i < tlm_len; i++) {
+        tlm_buf[(tlm_head + i) & TLM_BUF_MASK] = (uint8_t)tlm_line[i];
+    }
+    tlm_head += tlm_len;
+    tlm_stats.records++;
+}
+
+// 最大7バイトをDMDATAに書き込む (DMDATA0の書き込みでホストに通知されるので、DMDATA1を先に書く)
+static void tlm_write_chunk(const uint8_t* data, int n) {
+    uint8_t b[8] = {0};
+    b[0] = TLM_DM_FULL | (n + 4);
+    for (int i = 0; i < n; i++) {
+        b[1 + i] = data[i];
+    }
+    *DMDATA1 = b[4] | (b[5] << 8) | (b[6] << 16) | ((uint32_t)b[7] << 24);
+    *DMDATA0 = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+// log_format_line() の出力を $LG のレコードの中身にする
+static void tlm_log_putc(char c) {
+    if (c == '\n') {
+        return;  // 行の終わりは tlm_commit() が付ける
+    }
+    tlm_putc((c == '*' || c == '$') ? '_' : c);  // 区切りの文字は置き換える
+}
+
+// ログリングに増えた分を1件ずつ $LG にする (表示していなくても送る)
+// バッファに1行分の空きがある時だけ積み、積めた分だけカーソルを進める (残りは次の周期に送る)
+static void tlm_make_log(void) {
+    log_entry_t e;
+    while (tlm_free() >= TELEMETRY_LINE_MAX) {
+        uint32_t cursor = tlm_log_cursor;
+        if (!log_read(&cursor, &e, NULL)) {
+            break;
+        }
+        tlm_begin();
+        printF(tlm_putc, "$LG,");
+        log_format_line(tlm_log_putc, &e);
+        tlm_commit();
+        tlm_log_cursor = cursor;
+    }
+}
+
+static void tlm_make_stats(minyasx_context_t* ctx, uint32_t systick_ms) {
+    const sched_stats_t* ss = sched_get_stats();
+    const event_stats_t* es = event_get_stats();
+    uint32_t i2c_err = 0, i2c_rec = 0;
+    for (int dev = 0; dev < I2C_DEV_NUM; dev++) {
+        const i2c_dev_stats_t* is = i2c_stats_get(dev);
+        i2c_err += is->nacks + is->timeouts + is->errors;
+        i2c_rec += is->recoveries;
+    }
+    tlm_begin();
+    printF(tlm_putc, "$ST,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u",                      //
+           systick_ms, ss->idle_pct, ss->busy_us, ss->loops, ss->max_loop_us,  //
+           es->posted, es->dropped, i2c_err, i2c_rec, tlm_stats.dropped);
+    tlm_commit();
+
+    tlm_begin();
+    printF(tlm_putc, "$PW,%u,%u,%u,%u,%u,%u,%u",                //
+           systick_ms,                                          //
+           ctx->power[0].voltage_mv, ctx->power[0].current_ma,  //
+           ctx->power[1].voltage_mv, ctx->power[1].current_ma,  //
+           ctx->power[2].voltage_mv, ctx->power[2].current_ma);
+    tlm_commit();
+
+    tlm_make_log();
+}
+
+// フラッシュログを古い方から1件 $FL にする
+static void tlm_make_flashlog(void) {
+    // 送っている間に増えたレコードの分だけ、新しい方から数えた番号がずれる
+    int n = tlm_fl_left - 1 + (int)(flashlog_get_stats()->added - tlm_fl_added);
+    tlm_fl_left--;
+    flashlog_rec_t rec;
+    if (!flashlog_get(n, &rec)) {
+        return;  // 送っている間に消えた
+    }
+    tlm_begin();
+    printF(tlm_putc, "$FL,%u,%u,%u,%s,%x", rec.seq, rec.boot, rec.time_ms, flashlog_type_name(rec.type), rec.arg);
+    tlm_commit();
+}
+
+void telemetry_init(void) {
+    tlm_head = tlm_tail = 0;
+    tlm_written = false;
+    tlm_stats.attached = false;
+}
+
+void telemetry_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
+    uint32_t dm = *DMDATA0;
+    if (dm & TLM_DM_FULL) {
+        // 前のデータがまだ読み取られていない
+        if (tlm_stats.attached && time_elapsed(systick_ms, tlm_written_ms) >= TELEMETRY_DETACH_MS) {
+            tlm_stats.attached = false;
+        }
+    } else {
+        if (tlm_written) {
+            // 書いたデータが読み取られた = デバッガが繋がっている
+            tlm_stats.attached = true;
+        }
+        int n = tlm_head - tlm_tail;
+        if (n > 0) {
+            if (n > TLM_DM_CHUNK) n = TLM_DM_CHUNK;
+            uint8_t chunk[TLM_DM_CHUNK];
+            for (int i = 0; i < n; i++) {
+                chunk[i] = tlm_buf[(tlm_tail + i) & TLM_BUF_MASK];
+            }
+            tlm_write_chunk(chunk, n);
+            tlm_tail += n;
+            tlm_stats.bytes += n;
+            tlm_written = true;
+            tlm_written_ms = systick_ms;
+        } else if (!tlm_stats.attached && !tlm_written) {
+            // 未接続: 空行を1つ置いておき、読み取られたら接続されたとみなす
+            tlm_write_chunk((const uint8_t*)"\n", 1);
+            tlm_written = true;
+            tlm_written_ms = systick_ms;
+        }
+    }
+
+    // フラッシュログはバッファに1行分の空きがある時だけ積む (あふれて捨てないように)
+    if (tlm_fl_left > 0 && tlm_stats.attached && tlm_free() >= TELEMETRY_LINE_MAX) {
+        tlm_make_flashlog();
+    }
+
+    if (time_elapsed(systick_ms, tlm_stats_ms) >= TELEMETRY_STATS_MS) {
+        tlm_stats_ms = systick_ms;
+        if (tlm_stats.attached) {
+            tlm_make_stats(ctx, systick_ms);
+        }
+    }
+}
+
+bool telemetry_attached(void) {
+    return tlm_stats.attached;
+}
+
+void telemetry_event(const event_t* ev) {
+    if (!tlm_stats.attached) return;
+    tlm_begin();
+    printF(tlm_putc, "$EV,%u,%s,%d,%x", ev->timestamp, event_type_to_string(ev->type), ev->drive, ev->arg);
+    tlm_commit();
+}
+
+void telemetry_histogram(int drive, uint32_t c7, uint32_t c8, uint32_t c10, uint32_t c13, uint32_t c16, uint32_t other) {
+    if (!tlm_stats.attached) return;
+    tlm_begin();
+    printF(tlm_putc, "$HI,%u,%d,%u,%u,%u,%u,%u,%u", time_ms(), drive, c7, c8, c10, c13, c16, other);
+    tlm_commit();
+}
+
+bool telemetry_flashlog(void) {
+    if (!tlm_stats.attached) return false;
+    tlm_fl_left = flashlog_count();
+    tlm_fl_added = flashlog_get_stats()->added;
+    return true;
+}
+
+const telemetry_stats_t* telemetry_get_stats(void) {
+    return &tlm_stats;
+}
+
+#endif  // FEATURE_TELEMETRY
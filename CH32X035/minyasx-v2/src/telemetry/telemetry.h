@@ -0,0 +1,77 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event/event_queue.h"
+#include "minyasx.h"
+
+//
+// SWIO(SDI)のデバッグリンクへ流すテレメトリ
+//
+// ch32funのdebugprintfと同じ DMDATA0/DMDATA1 レジスタを使い、minichlink -T で受け取る。
+// ホスト側では tools/telemetry_decode.py でCSV/JSONに変換する。
+//
+// レコードは1行のテキストで、NMEAと同じく $ から * までのXORをチェックサムとして付ける。
+//   $EV,<usec>,<イベント>,<ドライブ>,<arg>*CS        イベントキューのイベント (発生時刻はtime_us())
+//   $ST,<ms>,<アイドル率>,<タスク時間>,...*CS        1秒ごとの統計 (スケジューラ/イベント/I2C/テレメトリ)
+//   $PW,<ms>,<VBUS mV>,<mA>,<12V mV>,<mA>,<5V mV>,<mA>*CS  1秒ごとの電圧/電流
+//   $HI,<ms>,<ドライブ>,<7>,<8>,<10>,<13>,<16>,<他>*CS  READ_DATAのパルス間隔の分類 (1秒分)
+//   $LG,<ms> <レベル> <メッセージ>*CS               ログリングのログ (1秒ごとに、前回送った続きから)
+//   $FL,<通し番号>,<起動回数>,<ms>,<種類>,<arg>*CS   フラッシュログのレコード (telemetry_flashlog()で古い順に全件)
+//
+// 送出は telemetry_poll() が、ホストが前のデータを読み取った時だけ7バイトずつ書き込む。待つことは無い。
+// デバッガが繋がっていない(読み取られない)間は未接続とみなし、レコードを作る処理自体を省く。
+// 送りきれずにバッファがあふれた時は、レコードを丸ごと捨てて数える (行が途中で切れることは無い)。
+//
+// レコードを作る関数はメインループからのみ呼ぶこと (割り込みルーチンからは呼べない)。
+//
+
+#ifndef TELEMETRY_BUF_SIZE
+#define TELEMETRY_BUF_SIZE 1024  // 送出待ちのバッファ (2のべき乗にすること)
+#endif
+#define TELEMETRY_LINE_MAX 96    // 1レコードの最大長
+#define TELEMETRY_STATS_MS 1000  // $ST/$PW の周期
+#define TELEMETRY_DETACH_MS 500  // この時間読み取られなければ未接続とみなす
+#define TELEMETRY_POLL_MS 2      // telemetry_pollのタスク周期 (7バイト/周期が上限)
+
+typedef struct {
+    uint32_t records;  // バッファに積んだレコード数
+    uint32_t dropped;  // バッファあふれで捨てたレコード数
+    uint32_t bytes;    // 送出したバイト数
+    bool attached;     // デバッガが読み取っているか
+} telemetry_stats_t;
+
+void telemetry_init(void);
+
+/**
+ * 送出待ちのデータをデバッグレジスタに書き込みます (TELEMETRY_POLL_MS 周期のタスクから呼ぶ)
+ * TELEMETRY_STATS_MS ごとに $ST/$PW のレコードも作ります
+ */
+void telemetry_poll(minyasx_context_t* ctx, uint32_t systick_ms);
+
+/**
+ * デバッガが繋がっていて、レコードを作る意味があるか
+ */
+bool telemetry_attached(void);
+
+/**
+ * イベントキューから取り出したイベントを $EV として送ります
+ */
+void telemetry_event(const event_t* ev);
+
+/**
+ * READ_DATAのパルス間隔の分類を $HI として送ります
+ */
+void telemetry_histogram(int drive, uint32_t c7, uint32_t c8, uint32_t c10, uint32_t c13, uint32_t c16, uint32_t other);
+
+/**
+ * フラッシュログの全レコードを $FL として古い順に送ります (telemetry_poll() がバッファの空きに合わせて少しずつ送る)
+ * デバッガが繋がっていなければ何もせず false を返します
+ */
+bool telemetry_flashlog(void);
+
+const telemetry_stats_t* telemetry_get_stats(void);
+
+#endif  // TELEMETRY_H
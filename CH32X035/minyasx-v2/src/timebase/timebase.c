@@ -0,0 +1,184 @@
+#include "timebase/timebase.h"
+
+#include <stddef.h>
+
+// タイマーホイールのスロット数 (2のべき乗にすること)
+#define TIMER_WHEEL_SLOTS 16
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+static sw_timer_t* timer_wheel[TIMER_WHEEL_SLOTS];
+
+// SysTick割り込みで更新する時刻
+static volatile uint32_t tb_tick = 0;       // tick数
+static volatile uint32_t tb_ms = 0;         // msec
+static volatile uint32_t tb_us = 0;         // 直近のtick時点のusec
+static volatile uint32_t tb_tick_cntl = 0;  // 直近のtick時点のSysTick->CNTL
+static uint32_t tb_sub_us = 0;              // msecに繰り上がっていない端数
+
+static timebase_stats_t tb_stats;
+
+void timebase_init(void) {
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        timer_wheel[i] = NULL;
+    }
+
+    // Reset any pre-existing configuration
+    SysTick->CTLR = 0x0000;
+
+    // TIMEBASE_TICK_US 単位で割り込みをかける
+    SysTick->CMP = TIMEBASE_TICK_CYCLES - 1;
+
+    // Reset the Count Register
+    SysTick->CNT = 0x00000000;
+    tb_tick_cntl = 0;
+
+    // Set the SysTick Configuration
+    // NOTE: By not setting SYSTICK_CTLR_STRE, we maintain compatibility with
+    // busywait delay funtions used by ch32v003_fun.
+    SysTick->CTLR |= SYSTICK_CTLR_STE |   // Enable Counter
+                     SYSTICK_CTLR_STIE |  // Enable Interrupts
+                     SYSTICK_CTLR_STCLK;  // Set Clock Source to HCLK/1
+
+    // Enable the SysTick IRQ
+    NVIC_EnableIRQ(SysTicK_IRQn);
+}
+
+uint32_t time_ms(void) {
+    return tb_ms;
+}
+
+uint32_t time_us(void) {
+    uint32_t us, base;
+    // 読んでいる途中でtickが進んだら読み直す
+    do {
+        us = tb_us;
+        base = tb_tick_cntl;
+    } while (us != tb_us);
+    return us + (SysTick->CNTL - base) / SYSTICK_ONE_MICROSECOND;
+}
+
+// 満了tickに対応するスロットへ登録する (割り込み禁止中に呼ぶこと)
+static void timer_insert(sw_timer_t* t) {
+    sw_timer_t** slot = &timer_wheel[t->expires & TIMER_WHEEL_MASK];
+    t->next = *slot;
+    *slot = t;
+    t->active = true;
+}
+
+// ホイールから外す (割り込み禁止中に呼ぶこと)
+static void timer_remove(sw_timer_t* t) {
+    sw_timer_t** pp = &timer_wheel[t->expires & TIMER_WHEEL_MASK];
+    while (*pp != NULL) {
+        if (*pp == t) {
+            *pp = t->next;
+            break;
+        }
+        pp = &(*pp)->next;
+    }
+    t->next = NULL;
+    t->active = false;
+}
+
+static inline uint32_t us_to_ticks(uint32_t us) {
+    return (us + TIMEBASE_TICK_US - 1) / TIMEBASE_TICK_US;
+}
+
+void timer_start(sw_timer_t* t, uint32_t delay_us, uint32_t period_us, sw_timer_callback_t func, void* arg) {
+    uint32_t delay_ticks = us_to_ticks(delay_us);
+    if (delay_ticks == 0) delay_ticks = 1;
+
+    uint32_t mstatus = irq_save();
+    if (t->active) {
+        timer_remove(t);
+    }
+    t->func = func;
+    t->arg = arg;
+    t->period_ticks = us_to_ticks(period_us);
+    t->expires = tb_tick + delay_ticks;
+    timer_insert(t);
+    irq_restore(mstatus);
+}
+
+void timer_stop(sw_timer_t* t) {
+    uint32_t mstatus = irq_save();
+    if (t->active) {
+        timer_remove(t);
+    }
+    irq_restore(mstatus);
+}
+
+// 1スロット分の満了したタイマーを処理する
+static void timer_wheel_process(uint32_t tick) {
+    sw_timer_t** pp = &timer_wheel[tick & TIMER_WHEEL_MASK];
+    while (*pp != NULL) {
+        sw_timer_t* t = *pp;
+        if (!time_reached(tick, t->expires)) {
+            // ホイールを1周以上先のタイマー
+            pp = &t->next;
+            continue;
+        }
+        // リストから外してからコールバックを呼ぶ (コールバック内での再設定・停止を許す)
+        *pp = t->next;
+        t->next = NULL;
+        t->active = false;
+        if (t->period_ticks != 0) {
+            t->expires += t->period_ticks;
+            if (!time_after(t->expires, tick)) {
+                t->expires = tick + t->period_ticks;
+            }
+            timer_insert(t);
+        }
+        tb_stats.fired++;
+        t->func(t->arg);
+    }
+}
+
+const timebase_stats_t* timebase_get_stats(void) {
+    return &tb_stats;
+}
+
+/*
+ * SysTick ISR - must be lightweight to prevent the CPU from bogging down.
+ * コンペア値は CNT からではなく前回のコンペア値から進めるので、周期がずれない
+ * NOTE: the `__attribute__((interrupt))` attribute is very important
+ */
+void SysTick_Handler(void) __attribute__((interrupt));
+void SysTick_Handler(void) {
+    // Increment the Compare Register for the next trigger
+    SysTick->CMP += TIMEBASE_TICK_CYCLES;
+
+    // Clear the trigger state for the next IRQ
+    SysTick->SR = 0x00000000;
+
+    uint32_t now = SysTick->CNTL;
+    uint32_t ticks = 1;
+    int32_t ahead = (int32_t)((uint32_t)SysTick->CMP - now);
+    if (ahead > 0) {
+        tb_tick_cntl = (uint32_t)SysTick->CMP - TIMEBASE_TICK_CYCLES;
+    } else {
+        // 割り込み禁止などで次のコンペア時刻を過ぎてしまった
+        // 取りこぼした分を数えて、最後に過ぎたコンペア時刻の次に合わせる (位相はずらさない)
+        ticks += (uint32_t)(-ahead) / TIMEBASE_TICK_CYCLES + 1;
+        tb_stats.missed_ticks += ticks - 1;
+        SysTick->CMP += (ticks - 1) * TIMEBASE_TICK_CYCLES;
+        tb_tick_cntl = (uint32_t)SysTick->CMP - TIMEBASE_TICK_CYCLES;
+    }
+
+    tb_us += ticks * TIMEBASE_TICK_US;
+    tb_sub_us += ticks * TIMEBASE_TICK_US;
+    while (tb_sub_us >= 1000) {
+        tb_sub_us -= 1000;
+        tb_ms++;
+    }
+
+    // 取りこぼした分も含めて、ホイールのスロットを順に処理する
+    // (1周分処理すれば満了済みのタイマーはすべて拾える)
+    uint32_t n = (ticks < TIMER_WHEEL_SLOTS) ? ticks : TIMER_WHEEL_SLOTS;
+    uint32_t tick = tb_tick + ticks - n;
+    for (uint32_t i = 0; i < n; i++) {
+        tick++;
+        timer_wheel_process(tick);
+    }
+    tb_tick += ticks;
+    tb_stats.ticks += ticks;
+}
@@ -0,0 +1,116 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ch32fun.h"
+#include "minyasx.h"
+
+//
+// 時刻管理とソフトウェアタイマー
+//
+// SysTickのコンペア割り込み(TIMEBASE_TICK_US周期)1本だけを使い、以下を提供する
+//  - msec/usec 単位の現在時刻 (どちらも uint32_t でラップアラウンドする)
+//  - ラップアラウンドを考慮した時間比較のヘルパー
+//  - ワンショット/周期のソフトウェアタイマー (タイマーホイール)
+// ホットパスで64bit演算を使わないように、時刻はすべて32bitで扱う。
+//
+
+// SysTick割り込みの周期 (タイマーの分解能)
+#define TIMEBASE_TICK_US 100
+#define TIMEBASE_TICK_CYCLES (TIMEBASE_TICK_US * SYSTICK_ONE_MICROSECOND)
+
+// サイクル(48MHz)との変換
+#define TIME_US_TO_CYCLES(us) ((uint32_t)(us) * SYSTICK_ONE_MICROSECOND)
+#define TIME_MS_TO_CYCLES(ms) ((uint32_t)(ms) * SYSTICK_ONE_MILLISECOND)
+
+void timebase_init(void);
+
+/**
+ * 起動からの経過時間 (msec, 約49.7日でラップアラウンド)
+ */
+uint32_t time_ms(void);
+
+/**
+ * 起動からの経過時間 (usec, 約71.6分でラップアラウンド)
+ */
+uint32_t time_us(void);
+
+/**
+ * SysTickのカウンタ下位32bit (48MHz, 約89秒でラップアラウンド)
+ * 割り込み禁止中でも進むので、短い区間の計測や割り込み禁止中の待ちに使う
+ */
+static inline uint32_t time_cycles(void) {
+    return SysTick->CNTL;
+}
+
+// since から now までの経過時間 (ラップアラウンドを考慮)
+static inline uint32_t time_elapsed(uint32_t now, uint32_t since) {
+    return now - since;
+}
+
+// a が b より後かどうか (ラップアラウンドを考慮)
+static inline bool time_after(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) > 0;
+}
+
+// now が deadline に達しているかどうか (ラップアラウンドを考慮)
+static inline bool time_reached(uint32_t now, uint32_t deadline) {
+    return (int32_t)(now - deadline) >= 0;
+}
+
+//
+// 割り込み禁止区間 (割り込みルーチンからも呼べるように、元のMIEを保存して戻す)
+//
+static inline uint32_t irq_save(void) {
+    uint32_t mstatus;
+    __asm__ volatile("csrrci %0, mstatus, 8" : "=r"(mstatus));
+    return mstatus;
+}
+
+static inline void irq_restore(uint32_t mstatus) {
+    __asm__ volatile("csrs mstatus, %0" ::"r"(mstatus & 8));
+}
+
+// 割り込みが禁止されているか
+static inline bool irq_disabled(void) {
+    uint32_t mstatus;
+    __asm__ volatile("csrr %0, mstatus" : "=r"(mstatus));
+    return (mstatus & 8) == 0;
+}
+
+//
+// ソフトウェアタイマー
+// コールバックはSysTick割り込みのコンテキストで呼ばれるので、軽い処理にすること
+//
+typedef void (*sw_timer_callback_t)(void* arg);
+
+typedef struct sw_timer {
+    struct sw_timer* next;     // 同じスロットの次のタイマー
+    uint32_t expires;          // 満了するtick
+    uint32_t period_ticks;     // 周期 (0ならワンショット)
+    sw_timer_callback_t func;  // コールバック
+    void* arg;                 // コールバックの引数
+    bool active;               // ホイールに登録中か
+} sw_timer_t;
+
+/**
+ * タイマーを開始します (動作中の場合は再設定されます)
+ * delay_us  : 最初に満了するまでの時間
+ * period_us : 周期 (0ならワンショット)
+ * どちらも TIMEBASE_TICK_US 単位に切り上げられます
+ */
+void timer_start(sw_timer_t* t, uint32_t delay_us, uint32_t period_us, sw_timer_callback_t func, void* arg);
+
+void timer_stop(sw_timer_t* t);
+
+typedef struct {
+    uint32_t ticks;         // 処理したtick数
+    uint32_t missed_ticks;  // 割り込みの遅れで取りこぼしたtick数
+    uint32_t fired;         // コールバックを呼んだ回数
+} timebase_stats_t;
+
+const timebase_stats_t* timebase_get_stats(void);
+
+#endif  // TIMEBASE_H
@@ -0,0 +1,60 @@
+#include "trend/trend.h"
+
+#include "build_profile.h"
+#include "pcfdd/pcfdd_control.h"
+#include "sched/scheduler.h"
+#include "timebase/timebase.h"
+
+#if FEATURE_DASHBOARD
+
+static uint16_t trend_ring[TREND_CH_NUM][TREND_SAMPLES];
+static uint8_t trend_head = 0;         // 次に書く位置
+static uint8_t trend_num = 0;          // 記録されているサンプル数
+static uint32_t trend_isr_cycles = 0;  // 前回記録した時点の割り込みの実行サイクル数
+static uint32_t trend_isr_ms = 0;      // 前回記録した時刻
+
+static uint16_t trend_clip(uint32_t v) {
+    return (v > 0xffff) ? 0xffff : (uint16_t)v;
+}
+
+void trend_sample(minyasx_context_t* ctx, uint32_t systick_ms) {
+    uint16_t v[TREND_CH_NUM];
+    v[TREND_INDEX_A] = trend_clip(pcfdd_index_period_ms(0));
+    v[TREND_INDEX_B] = trend_clip(pcfdd_index_period_ms(1));
+    // データレートは読んでいるドライブの方 (読んでいない方はBPS_UNKNOWNで0になる)
+    uint32_t bps0 = fdd_bps_mode_to_value(ctx->drive[0].bps_measured);
+    uint32_t bps1 = fdd_bps_mode_to_value(ctx->drive[1].bps_measured);
+    v[TREND_BPS] = trend_clip(((bps0 > bps1) ? bps0 : bps1) / 1000);
+    v[TREND_I_VBUS] = ctx->power[0].current_ma;
+    v[TREND_I_12V] = ctx->power[1].current_ma;
+    v[TREND_I_5V] = ctx->power[2].current_ma;
+    // 直近1秒間のタスク実行時間(usec)を1000で割ると0.1%単位になる
+    v[TREND_LOOP] = trend_clip(sched_get_stats()->busy_us / 1000);
+    // 前回からの割り込みの実行サイクル数を経過時間で割る (48サイクル/usec)
+    uint32_t cycles = pcfdd_capture_isr_cycles();
+    uint32_t elapsed_ms = time_elapsed(systick_ms, trend_isr_ms);
+    v[TREND_ISR] = elapsed_ms ? trend_clip((cycles - trend_isr_cycles) / (48 * elapsed_ms)) : 0;
+    trend_isr_cycles = cycles;
+    trend_isr_ms = systick_ms;
+
+    for (int ch = 0; ch < TREND_CH_NUM; ch++) {
+        trend_ring[ch][trend_head] = v[ch];
+    }
+    trend_head = (trend_head + 1) % TREND_SAMPLES;
+    if (trend_num < TREND_SAMPLES) {
+        trend_num++;
+    }
+}
+
+int trend_count(void) {
+    return trend_num;
+}
+
+uint16_t trend_get(trend_ch_t ch, int n) {
+    if (ch >= TREND_CH_NUM || n < 0 || n >= trend_num) {
+        return 0;
+    }
+    return trend_ring[ch][(trend_head + TREND_SAMPLES - trend_num + n) % TREND_SAMPLES];
+}
+
+#endif  // FEATURE_DASHBOARD
@@ -0,0 +1,47 @@
+#ifndef TREND_H
+#define TREND_H
+
+#include <stdint.h>
+
+#include "minyasx.h"
+
+//
+// ダッシュボードのグラフ用に、計測値を一定周期でチャンネルごとのリングバッファに記録する
+//
+// 回転の立ち上がりや回転数の切り替えの様子を、オシロスコープ無しに本体の画面で見るためのもの。
+// 記録はスケジューラのタスク(trend_sample)で行い、描画は表示している間だけ行う。
+//
+
+#ifndef TREND_SAMPLES
+#define TREND_SAMPLES 60  // 1チャンネルあたりのサンプル数 (グラフの横幅のドット数)
+#endif
+#define TREND_SAMPLE_MS 200  // 記録の周期
+
+typedef enum {
+    TREND_INDEX_A,  // ドライブAのINDEX周期 (ms)
+    TREND_INDEX_B,  // ドライブBのINDEX周期 (ms)
+    TREND_BPS,      // 計測したデータレート (kbps)
+    TREND_I_VBUS,   // VBUSの電流 (mA)
+    TREND_I_12V,    // FDDの+12Vの電流 (mA)
+    TREND_I_5V,     // FDDの+5Vの電流 (mA)
+    TREND_LOOP,     // メインループの負荷 (0.1%)
+    TREND_ISR,      // READ_DATAのキャプチャ割り込みの負荷 (0.1%)
+    TREND_CH_NUM,
+} trend_ch_t;
+
+/**
+ * 計測値を1サンプル記録します (TREND_SAMPLE_MS 周期のタスクから呼ぶ)
+ */
+void trend_sample(minyasx_context_t* ctx, uint32_t systick_ms);
+
+/**
+ * 記録されているサンプル数 (最大 TREND_SAMPLES)
+ */
+int trend_count(void);
+
+/**
+ * 古い方からn番目(0始まり)のサンプルを返します
+ */
+uint16_t trend_get(trend_ch_t ch, int n);
+
+#endif  // TREND_H
@@ -1,21 +1,75 @@
 #include "ui_control.h"
 
+#include "build_profile.h"
 #include "greenpak/greenpak_control.h"
+#include "i2c/i2c_stats.h"
+#include "timebase/timebase.h"
 
 static ui_page_context_t ui_pages[UI_PAGE_MAX];
 
 static ui_page_type_t current_page = UI_PAGE_MAIN;
 
+// 常駐バッファを持たないページが表示中に使う画面バッファ (全ページで共有)
+static uint8_t ui_screen[8][21];  // 128x64dot with 6x8font = 21x8char
+
+// 書き込み先のバッファがあるか (常駐バッファを持つか、表示中か)
+static bool ui_has_buffer(ui_page_context_t *pcon) {
+    return pcon->store != NULL || pcon->page == current_page;
+}
+
+static uint8_t (*ui_store(ui_page_context_t *pcon))[21] {
+    return pcon->store ? pcon->store : ui_screen;
+}
+
+static int ui_store_rows(ui_page_context_t *pcon) {
+    return pcon->store ? pcon->store_rows : 8;
+}
+
+// 循環させる行数 (ヘッダー行を残す場合はそれを除く)
+static int ui_ring_rows(ui_page_context_t *pcon) {
+    return ui_store_rows(pcon) - (pcon->scroll_keepheader ? 1 : 0);
+}
+
+// 画面の行yに対応するバッファ
+// スクロールするページは循環バッファで、ヘッダー行を残す場合は2行目以降を回す
+// 画面には循環バッファの最新の行から(scroll_back行遡って)下端が揃うように表示する
+static uint8_t *ui_row(ui_page_context_t *pcon, int y) {
+    uint8_t(*store)[21] = ui_store(pcon);
+    if (!pcon->scroll_enable) {
+        return store[y];
+    }
+    int head = pcon->scroll_keepheader ? 1 : 0;
+    if (y < head) {
+        return store[0];
+    }
+    int ring = ui_ring_rows(pcon);
+    int hidden = ring - (8 - head) - pcon->scroll_back;  // 画面より上に隠れている行数
+    return store[head + (pcon->scroll_top + hidden + y - head) % ring];
+}
+
+static void ui_fill_blank(uint8_t (*store)[21], int rows) {
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < 21; x++) {
+            store[y][x] = ' ';  // スペースでクリア
+        }
+    }
+}
+
+// 1行だけOLEDに描き直す
+static void ui_redraw_line(ui_page_context_t *pcon, int y) {
+    uint8_t *row = ui_row(pcon, y);
+    OLED_cursor(0, y);
+    for (int x = 0; x < 21; x++) {
+        OLED_write(row[x]);
+    }
+}
+
 void ui_refresh(void) {
     // 現在のページに対応するバッファを取得
     ui_page_context_t *pcon = &ui_pages[current_page];
     // OLEDをバッファの内容で更新
     for (int y = 0; y < 8; y++) {
-        OLED_cursor(0, y);
-        for (int x = 0; x < 21; x++) {
-            char c = pcon->buf[y][x];
-            OLED_write(c);
-        }
+        ui_redraw_line(pcon, y);
     }
     // カーソル位置に移動
     OLED_cursor(pcon->x * 6, pcon->y);
@@ -23,6 +77,27 @@ void ui_refresh(void) {
     if (pcon->scroll_enable) {
         OLED_plot_cursor(true);
     }
+    // フレームバッファの変わった所だけを送る
+    OLED_flush();
+}
+
+// ページを表示して、enterコールバックで描かせる
+static void ui_show_page(ui_page_type_t page) {
+    current_page = page;
+    ui_page_context_t *pcon = &ui_pages[page];
+    if (pcon->store == NULL) {
+        // 常駐バッファの無いページは空の画面から描き直す (enterで現在の状態を描く)
+        ui_fill_blank(ui_screen, 8);
+        pcon->x = 0;
+        pcon->y = 0;
+        pcon->scroll_top = 0;
+    }
+    // 画面を更新
+    ui_refresh();
+    // ページのenterコールバックを呼び出す
+    if (ui_pages[page].enter) {
+        ui_pages[page].enter(&ui_pages[page]);
+    }
 }
 
 void ui_change_page(ui_page_type_t page) {
@@ -32,14 +107,11 @@ void ui_change_page(ui_page_type_t page) {
     if (current_page == page) {
         return;  // すでにそのページがアクティブ
     }
-    // ページを変更
-    current_page = page;
-    // 画面を更新
-    ui_refresh();
-    // ページのenterコールバックを呼び出す
-    if (ui_pages[page].enter) {
-        ui_pages[page].enter(&ui_pages[page]);
+    if (ui_pages[page].enter == NULL && ui_pages[page].keyin == NULL) {
+        return;  // このビルドプロファイルに含まれていないページ
     }
+    // ページを変更
+    ui_show_page(page);
 }
 
 ui_page_type_t ui_get_current_page(void) {
@@ -52,17 +124,18 @@ void ui_clear(ui_page_type_t page) {
     }
     ui_page_context_t *pcon = &ui_pages[page];
     // バッファをクリア
-    for (int y = 0; y < 8; y++) {
-        for (int x = 0; x < 21; x++) {
-            pcon->buf[y][x] = ' ';  // スペースでクリア
-        }
+    if (ui_has_buffer(pcon)) {
+        ui_fill_blank(ui_store(pcon), ui_store_rows(pcon));
     }
     pcon->x = 0;
     pcon->y = 0;
+    pcon->scroll_top = 0;
+    pcon->scroll_back = 0;
     if (current_page == page) {
         // 現在のページがアクティブならOLEDもクリア
         OLED_clear();
         OLED_cursor(0, 0);
+        OLED_flush();
     }
 }
 
@@ -86,6 +159,18 @@ void ui_print(ui_page_type_t page, char *str) {
     while (*str) ui_write(page, *str++);
 }
 
+void ui_draw_bitmap(ui_page_type_t page, uint8_t x, uint8_t y, const uint8_t *bmp, uint8_t w, uint8_t h) {
+    if (current_page != page) {
+        return;  // 表示していないページには描かない
+    }
+    ui_page_context_t *pcon = &ui_pages[page];
+    OLED_cursor(x, y);
+    OLED_drawBitmap(bmp, w, h);
+    // 文字のカーソル位置に戻しておく
+    OLED_cursor(pcon->x * 6, pcon->y);
+    OLED_flush();
+}
+
 static void ui_show_cursor(ui_page_context_t *pcon) {
     if (!pcon->scroll_enable) {
         // スクロールしない場合はカーソルを表示しない
@@ -109,18 +194,20 @@ static void ui_check_scroll(ui_page_context_t *pcon) {
     }
 
     // スクロールする場合
-    int start_line = pcon->scroll_keepheader ? 1 : 0;
-    for (int y = start_line + 1; y < 8; y++) {
-        for (int x = 0; x < 21; x++) {
-            pcon->buf[y - 1][x] = pcon->buf[y][x];
-        }
-    }
+    // 循環バッファの先頭を進めて、新しい最下行をクリアする (バッファ内のコピーはしない)
+    pcon->scroll_top = (pcon->scroll_top + 1) % ui_ring_rows(pcon);
+    uint8_t *bottom = ui_row(pcon, 7);
     for (int x = 0; x < 21; x++) {
-        pcon->buf[7][x] = ' ';  // 最下行をクリア
+        bottom[x] = ' ';  // 最下行をクリア
     }
     pcon->y = 7;
     if (current_page == pcon->page) {
-        ui_refresh();  // OLEDを更新
+        // OLEDの表示オフセットで画面全体を1行上げ、変わる行(最下行と、残すヘッダー行)だけを描き直す
+        OLED_scrollLines(1);
+        ui_redraw_line(pcon, 7);
+        if (pcon->scroll_keepheader) {
+            ui_redraw_line(pcon, 0);
+        }
         ui_cursor(pcon->page, pcon->x, pcon->y);
     }
     ui_show_cursor(pcon);
@@ -130,6 +217,16 @@ static void ui_check_scroll(ui_page_context_t *pcon) {
 void ui_write(ui_page_type_t page, char c) {
     // 現在のページに対応するバッファを取得
     ui_page_context_t *pcon = &ui_pages[page];
+    if (!ui_has_buffer(pcon)) {
+        return;  // 非表示のページは、表示される時にenterで描き直すので捨てる
+    }
+    if (pcon->scroll_back) {
+        // 遡って表示している時に書き込まれたら最新の表示に戻す
+        pcon->scroll_back = 0;
+        if (current_page == page) {
+            ui_refresh();
+        }
+    }
     // バッファに文字を書き込む
     if (c == '\n') {
         // スクロール有効の場合はカーソルが出ているので消す
@@ -146,7 +243,7 @@ void ui_write(ui_page_type_t page, char c) {
         pcon->x = 0;
     } else {
         if (pcon->x < 21 && pcon->y < 8) {
-            pcon->buf[pcon->y][pcon->x] = c;
+            ui_row(pcon, pcon->y)[pcon->x] = c;
             if (current_page == page) {
                 // 現在のページがアクティブならOLEDに反映
                 OLED_cursor(pcon->x * 6, pcon->y);  // Xは6ドット幅で計算
@@ -160,6 +257,10 @@ void ui_write(ui_page_type_t page, char c) {
         }
     }
     ui_check_scroll(pcon);
+    if (current_page == page) {
+        // 送信中なら、書き換えた分は完了割り込みで続けて送られる
+        OLED_flush();
+    }
     return;
 }
 
@@ -199,15 +300,48 @@ void ui_write_10(char c) {
 void ui_write_11(char c) {
     ui_write(11, c);
 }
+void ui_write_12(char c) {
+    ui_write(12, c);
+}
+void ui_write_13(char c) {
+    ui_write(13, c);
+}
+void ui_write_14(char c) {
+    ui_write(14, c);
+}
+void ui_write_15(char c) {
+    ui_write(15, c);
+}
 void ui_write_null(char c) {
     // 何もしない
     (void)c;
 }
 
+void ui_scroll_back(ui_page_type_t page, int lines) {
+    if (page < 0 || page >= UI_PAGE_MAX) {
+        return;  // 無効なページ番号
+    }
+    ui_page_context_t *pcon = &ui_pages[page];
+    if (pcon->store == NULL || !pcon->scroll_enable) {
+        return;  // 遡れるのは常駐バッファを持つスクロールページだけ
+    }
+    int max = ui_ring_rows(pcon) - (8 - (pcon->scroll_keepheader ? 1 : 0));
+    if (lines < 0) lines = 0;
+    if (lines > max) lines = max;
+    if (pcon->scroll_back == lines) {
+        return;
+    }
+    pcon->scroll_back = (uint8_t)lines;
+    if (current_page == page) {
+        ui_refresh();
+    }
+}
+
 ui_write_t writers[UI_PAGE_MAX] = {
-    ui_write_0, ui_write_1, ui_write_2,  ui_write_3,   //
-    ui_write_4, ui_write_5, ui_write_6,  ui_write_7,   //
-    ui_write_8, ui_write_9, ui_write_10, ui_write_11,  //
+    ui_write_0,  ui_write_1,  ui_write_2,  ui_write_3,   //
+    ui_write_4,  ui_write_5,  ui_write_6,  ui_write_7,   //
+    ui_write_8,  ui_write_9,  ui_write_10, ui_write_11,  //
+    ui_write_12, ui_write_13, ui_write_14, ui_write_15,  //
 };
 
 ui_write_t ui_get_writer(ui_page_type_t page) {
@@ -218,16 +352,50 @@ ui_write_t ui_get_writer(ui_page_type_t page) {
     return writers[page];
 }
 
+// 書式関数の出力先
+static char ui_field_text[21];
+static uint8_t ui_field_len;
+
+static void ui_field_sink(char c) {
+    if (ui_field_len < sizeof(ui_field_text)) {
+        ui_field_text[ui_field_len++] = c;
+    }
+}
+
+int ui_fields_update(ui_page_type_t page, const ui_field_t *fields, int count) {
+    if (page < 0 || page >= UI_PAGE_MAX) {
+        return 0;  // 無効なページ番号
+    }
+    ui_page_context_t *pcon = &ui_pages[page];
+    if (!ui_has_buffer(pcon)) {
+        return 0;  // 非表示のページ
+    }
+    int changed = 0;
+    for (int i = 0; i < count; i++) {
+        const ui_field_t *f = &fields[i];
+        ui_field_len = 0;
+        f->format(ui_field_sink, f->src);
+        uint8_t *row = ui_row(pcon, f->y);
+        for (int j = 0; j < f->width && f->x + j < 21; j++) {
+            char c = (j < ui_field_len) ? ui_field_text[j] : ' ';
+            if (row[f->x + j] == (uint8_t)c) {
+                continue;  // 表示済みの文字と同じ
+            }
+            ui_cursor(page, f->x + j, f->y);
+            ui_write(page, c);
+            changed++;
+        }
+    }
+    return changed;
+}
+
 void ui_init(minyasx_context_t *ctx) {
     // 各ウィンドウの初期化
     for (int i = 0; i < UI_PAGE_MAX; i++) {
         ui_pages[i].ctx = ctx;
         ui_pages[i].page = (ui_page_type_t)i;
-        for (int y = 0; y < 8; y++) {
-            for (int x = 0; x < 21; x++) {
-                ui_pages[i].buf[y][x] = ' ';  // バッファをクリア
-            }
-        }
+        ui_pages[i].store = NULL;  // 常駐バッファを持つページはinitで設定する
+        ui_pages[i].store_rows = 0;
         ui_pages[i].x = 0;
         ui_pages[i].y = 0;
         ui_pages[i].enter = NULL;
@@ -235,16 +403,21 @@ void ui_init(minyasx_context_t *ctx) {
         ui_pages[i].keyin = NULL;
         ui_pages[i].scroll_enable = false;
         ui_pages[i].scroll_keepheader = false;
+        ui_pages[i].scroll_top = 0;
+        ui_pages[i].scroll_back = 0;
     }
+    ui_fill_blank(ui_screen, 8);
     // OLEDの初期化
     OLED_init();
     OLED_display(1);  // ディスプレイをオンにする
     // OLED_flip(1, 1);  // 必要に応じて画面を反転
     OLED_flip(0, 0);  // 必要に応じて画面を反転
     OLED_clear();     // 画面をクリア
+    OLED_flush();
     current_page = UI_PAGE_MAIN;
 
     // 各ページの初期化
+    ui_page_boot_init(&ui_pages[UI_PAGE_BOOT]);
     ui_page_main_init(&ui_pages[UI_PAGE_MAIN]);
     ui_page_menu_init(&ui_pages[UI_PAGE_MENU]);
     ui_page_about_init(&ui_pages[UI_PAGE_ABOUT]);
@@ -252,55 +425,130 @@ void ui_init(minyasx_context_t *ctx) {
     ui_page_setting_common_init(&ui_pages[UI_PAGE_SETTING_COMMON]);
     ui_page_setting_fdda_init(&ui_pages[UI_PAGE_SETTING_FDDA]);
     ui_page_setting_fddb_init(&ui_pages[UI_PAGE_SETTING_FDDB]);
+#if FEATURE_DEBUG_PAGES
     ui_page_setting_debug_init(&ui_pages[UI_PAGE_SETTING_DEBUG]);
     ui_page_debug_init(&ui_pages[UI_PAGE_DEBUG]);
     ui_page_debug_init_pcfdd(&ui_pages[UI_PAGE_DEBUG_PCFDD]);
+    ui_page_debug_init_sched(&ui_pages[UI_PAGE_DEBUG_SCHED]);
+    ui_page_debug_init_i2c(&ui_pages[UI_PAGE_DEBUG_I2C]);
+#endif
     ui_page_log_init(&ui_pages[UI_PAGE_LOG]);
+    ui_page_flashlog_init(&ui_pages[UI_PAGE_FLASHLOG]);
+#if FEATURE_DASHBOARD
+    ui_page_dash_init(&ui_pages[UI_PAGE_DASH]);
+#endif
+
+    // 最初のページを描く
+    ui_show_page(UI_PAGE_MAIN);
+}
+
+// キー入力から画面更新完了までの時間 (キー読み出し開始からkeyinコールバック終了まで)
+static uint32_t key_latency_last_us = 0;
+static uint32_t key_latency_max_us = 0;
+
+void ui_get_key_latency(uint32_t *last_us, uint32_t *max_us) {
+    if (last_us) *last_us = key_latency_last_us;
+    if (max_us) *max_us = key_latency_max_us;
 }
 
 void ui_poll(minyasx_context_t *ctx, uint32_t systick_ms) {
-    // 各ページのポーリング処理
-    for (int i = 0; i < UI_PAGE_MAX; i++) {
-        ui_page_context_t *pcon = &ui_pages[i];
-        if (pcon->poll) {
-            pcon->poll(pcon, systick_ms);
-        }
+    // 表示中のページだけをポーリングする (非表示のページは表示される時にenterで描き直す)
+    ui_page_context_t *pcon = &ui_pages[current_page];
+    if (pcon->poll) {
+        pcon->poll(pcon, systick_ms);
     }
+}
 
-    // ここでキー入力のポーリングを行い、必要に応じてコールバックを呼び出す
-    // 例えば、キー状態を読み取る関数があると仮定
-    ui_key_mask_t keys = UI_KEY_NONE;
-    static ui_key_mask_t last_keys = UI_KEY_NONE;
-
-    // キー入力はGP4のIO端子をI2Cで読める
-    // GPのIO端子の入力状態はレジスタ0x74,0x75で読める
-    // 0x74:
-    // - bit1: IO0 (UP)
-    // - bit2: IO1 (DOWN)
-    // - bit3: IO2 (LEFT)
-    // - bit4: IO3 (RIGHT)
-    // - bit5: IO4 (ENTER)
-    // 0x75:
-    // - bit4: IO13 (EJECT_B)
-    // - bit5: IO14 (EJECT_A)
-    uint8_t gp4_io0_7 = gp_reg_get(gp_target_addr[3], 0x74);
-    uint8_t gp4_io8_15 = gp_reg_get(gp_target_addr[3], 0x75);
-    if ((gp4_io0_7 & (1 << 1)) == 0) keys |= UI_KEY_UP;
-    if ((gp4_io0_7 & (1 << 2)) == 0) keys |= UI_KEY_DOWN;
-    if ((gp4_io0_7 & (1 << 3)) == 0) keys |= UI_KEY_LEFT;
-    if ((gp4_io0_7 & (1 << 4)) == 0) keys |= UI_KEY_RIGHT;
-    if ((gp4_io0_7 & (1 << 5)) == 0) keys |= UI_KEY_ENTER;
-    if ((gp4_io8_15 & (1 << 4)) == 0) keys |= UI_KEY_EJECT_B;
-    if ((gp4_io8_15 & (1 << 5)) == 0) keys |= UI_KEY_EJECT_A;
-
-    if (keys == last_keys) {
-        // キー状態が変化していない
-        return;
+// キーの状態 (スキャンタスクだけが触る)
+static ui_key_mask_t key_raw = UI_KEY_NONE;     // 前回読んだ状態
+static ui_key_mask_t key_stable = UI_KEY_NONE;  // チャタリングを除いて確定した状態
+static uint32_t key_raw_ms = 0;                 // 読んだ状態が最後に変化した時刻
+static uint32_t key_press_ms = 0;               // 確定した押下の時刻
+static uint32_t key_repeat_ms = 0;              // 次にオートリピートする時刻
+static bool key_long_sent = false;              // 今の押下で長押しを通知したか
+
+// キー入力はGP4のIO端子をI2Cで読める
+// GPのIO端子の入力状態はレジスタ0x74,0x75で読める (1回のトランザクションで2バイト読む)
+// 0x74:
+// - bit1: IO0 (UP)
+// - bit2: IO1 (DOWN)
+// - bit3: IO2 (LEFT)
+// - bit4: IO3 (RIGHT)
+// - bit5: IO4 (ENTER)
+// 0x75:
+// - bit4: IO13 (EJECT_B)
+// - bit5: IO14 (EJECT_A)
+static bool ui_key_read(ui_key_mask_t *keys) {
+    uint8_t io[2];
+    i2c_class_t prev_class = i2c_set_class(I2C_CLASS_KEY);
+    int err = gp_reg_read_burst(gp_target_addr[3], 0x74, io, 2);
+    i2c_set_class(prev_class);
+    if (err != I2C_ERR_NONE) {
+        return false;  // 読めなかった時は前回の状態のままにする
     }
-    last_keys = keys;
+    *keys = UI_KEY_NONE;
+    if ((io[0] & (1 << 1)) == 0) *keys |= UI_KEY_UP;
+    if ((io[0] & (1 << 2)) == 0) *keys |= UI_KEY_DOWN;
+    if ((io[0] & (1 << 3)) == 0) *keys |= UI_KEY_LEFT;
+    if ((io[0] & (1 << 4)) == 0) *keys |= UI_KEY_RIGHT;
+    if ((io[0] & (1 << 5)) == 0) *keys |= UI_KEY_ENTER;
+    if ((io[1] & (1 << 4)) == 0) *keys |= UI_KEY_EJECT_B;
+    if ((io[1] & (1 << 5)) == 0) *keys |= UI_KEY_EJECT_A;
+    return true;
+}
+
+static void ui_key_dispatch(ui_key_mask_t keys, uint32_t key_start) {
     ui_page_context_t *page = &ui_pages[current_page];
     if (page->keyin) {
-        page->keyin(&ui_pages[current_page], keys);
+        page->keyin(page, keys);
+    }
+    key_latency_last_us = time_elapsed(time_us(), key_start);
+    if (key_latency_last_us > key_latency_max_us) {
+        key_latency_max_us = key_latency_last_us;
+    }
+}
+
+void ui_key_scan(minyasx_context_t *ctx, uint32_t systick_ms) {
+    uint32_t key_start = time_us();
+    ui_key_mask_t keys = key_raw;
+    if (!ui_key_read(&keys)) {
+        return;
+    }
+    if (keys != key_raw) {
+        // 変化した直後はチャタリングかもしれないので、落ち着くまで待つ
+        key_raw = keys;
+        key_raw_ms = systick_ms;
+        return;
+    }
+
+    if (keys != key_stable) {
+        if (time_elapsed(systick_ms, key_raw_ms) < UI_KEY_DEBOUNCE_MS) {
+            return;
+        }
+        // 状態が確定した。新たに押されたキーだけを通知する (離した時は通知しない)
+        ui_key_mask_t pressed = keys & ~key_stable;
+        key_stable = keys;
+        key_press_ms = systick_ms;
+        key_repeat_ms = systick_ms + UI_KEY_REPEAT_DELAY_MS;
+        key_long_sent = false;
+        if (pressed) {
+            ui_key_dispatch(pressed, key_start);
+        }
+        return;
+    }
+
+    if (key_stable == UI_KEY_NONE) {
+        return;
+    }
+    // 押し続けている
+    if (!key_long_sent && time_elapsed(systick_ms, key_press_ms) >= UI_KEY_LONG_MS) {
+        key_long_sent = true;
+        ui_key_dispatch(UI_KEY_LONG(key_stable), key_start);
+    }
+    ui_key_mask_t repeat = key_stable & UI_KEY_REPEAT_MASK;
+    if (repeat && time_reached(systick_ms, key_repeat_ms)) {
+        key_repeat_ms += UI_KEY_REPEAT_MS;
+        ui_key_dispatch(repeat, key_start);
     }
 }
 
@@ -353,30 +601,3 @@ void ui_select_keyin(ui_select_t *select, ui_key_mask_t keys) {
     // 選択肢の表示を更新
     ui_select_print(select, true);
 }
-
-static ui_log_level_t current_log_level = UI_LOG_LEVEL_INFO;
-
-void ui_log_set_level(ui_log_level_t level) {
-    current_log_level = level;
-}
-
-ui_log_level_t ui_log_get_level(void) {
-    return current_log_level;
-}
-
-void ui_log_print(ui_log_level_t level, const char *message) {
-    if (level < current_log_level) {
-        return;  // 現在のログレベルより低いログは無視
-    }
-    ui_printf(UI_PAGE_LOG, message);
-}
-
-void ui_log_printf(ui_log_level_t level, const char *format, ...) {
-    if (level < current_log_level) {
-        return;  // 現在のログレベルより低いログは無視
-    }
-    va_list args;
-    va_start(args, format);
-    ui_printf(UI_PAGE_LOG, format, args);
-    va_end(args);
-}
\ No newline at end of file
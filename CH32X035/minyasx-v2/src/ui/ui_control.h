@@ -20,7 +20,11 @@ typedef enum {
     UI_PAGE_SETTING_DEBUG = 8,   // Debug settings page
     UI_PAGE_DEBUG = 9,           // Debug page
     UI_PAGE_DEBUG_PCFDD = 10,    // PCFDD debug page
-    UI_PAGE_LOG = 11,            // Log page
+    UI_PAGE_DEBUG_SCHED = 11,    // Scheduler/WDT debug page
+    UI_PAGE_DEBUG_I2C = 12,      // I2C device debug page
+    UI_PAGE_LOG = 13,            // Log page
+    UI_PAGE_FLASHLOG = 14,       // Flash event log page
+    UI_PAGE_DASH = 15,           // Dashboard (graph) page
     UI_PAGE_MAX,
 } ui_page_type_t;
 
@@ -37,6 +41,25 @@ typedef enum {
 
 typedef uint32_t ui_key_mask_t;  // 同時押し表現用
 
+// 長押しは、キーのビットを UI_KEY_LONG_SHIFT だけずらして通知する (例: UI_KEY_LONG(UI_KEY_ENTER))
+// 通常の押下とはビットが重ならないので、長押しを使わないページには影響しない
+#define UI_KEY_LONG_SHIFT 8
+#define UI_KEY_LONG(keys) ((ui_key_mask_t)(keys) << UI_KEY_LONG_SHIFT)
+
+// キー入力のスキャン
+#define UI_KEY_SCAN_MS 20                            // スキャン周期 (ui_key_scanのタスク周期)
+#define UI_KEY_DEBOUNCE_MS 30                        // この時間同じ状態が続いたら確定する
+#define UI_KEY_LONG_MS 700                           // 長押しと判定する時間
+#define UI_KEY_REPEAT_DELAY_MS 500                   // オートリピートが始まるまでの時間
+#define UI_KEY_REPEAT_MS 120                         // オートリピートの間隔
+#define UI_KEY_REPEAT_MASK (UI_KEY_UP | UI_KEY_DOWN)  // オートリピートするキー
+
+// ログページの常駐バッファの行数 (8以上。8行を超えた分は上下キーで遡って表示できる)
+// ログ以外のページは常駐バッファを持たず、表示中だけ共有の画面バッファに描く
+#ifndef UI_LOG_ROWS
+#define UI_LOG_ROWS 8
+#endif
+
 // コールバック関数の型（キーが押されたら呼ばれる）
 // ui_page_context_tのプロトタイプ宣言
 struct ui_page_context_t;  // 構造体の前方宣言
@@ -48,19 +71,23 @@ typedef void (*ui_page_keyin_t)(struct ui_page_context_t* pctx, ui_key_mask_t ke
 typedef struct ui_page_context_t {
     minyasx_context_t* ctx;
     ui_page_type_t page;
-    uint8_t buf[8][21];  // 128x64dot with 6x8font = 21x8char
+    uint8_t (*store)[21];  // 常駐バッファ (NULLなら表示中だけ共有の画面バッファ 21x8char を使う)
+    uint8_t store_rows;    // 常駐バッファの行数 (8以上)
     uint8_t x;
     uint8_t y;
     bool scroll_enable;      // true: 画面下端でスクロールする, false: しない
     bool scroll_keepheader;  // true: スクロール時にヘッダー行を維持する
-    ui_page_enter_t enter;
-    ui_page_poll_t poll;
+    uint8_t scroll_top;      // スクロールするページの循環バッファの先頭行
+    uint8_t scroll_back;     // 最新から何行遡って表示しているか
+    ui_page_enter_t enter;   // 表示されるたびに呼ばれる。常駐バッファが無いページはここで画面全体を描く
+    ui_page_poll_t poll;     // 表示中だけ呼ばれる
     ui_page_keyin_t keyin;
 } ui_page_context_t;
 
 void ui_change_page(ui_page_type_t page);
 ui_page_type_t ui_get_current_page(void);
 
+void ui_page_boot_init(ui_page_context_t* win);
 void ui_page_main_init(ui_page_context_t* win);
 void ui_page_menu_init(ui_page_context_t* win);
 void ui_page_about_init(ui_page_context_t* win);
@@ -71,7 +98,11 @@ void ui_page_setting_fddb_init(ui_page_context_t* win);
 void ui_page_setting_debug_init(ui_page_context_t* win);
 void ui_page_debug_init(ui_page_context_t* win);
 void ui_page_debug_init_pcfdd(ui_page_context_t* win);
+void ui_page_debug_init_sched(ui_page_context_t* win);
+void ui_page_debug_init_i2c(ui_page_context_t* win);
 void ui_page_log_init(ui_page_context_t* win);
+void ui_page_flashlog_init(ui_page_context_t* win);
+void ui_page_dash_init(ui_page_context_t* win);
 
 typedef void (*ui_write_t)(char c);  // Write a character or handle control characters
 
@@ -82,6 +113,18 @@ void ui_cursor(ui_page_type_t page, uint8_t x, uint8_t y);
 void ui_print(ui_page_type_t page, char* str);
 void ui_write(ui_page_type_t page, char c);
 
+/**
+ * ビットマップを描きます (表示中のページのみ。文字のバッファには残らないので、enterで描き直すこと)
+ * x: ドット単位の横位置, y: 行, bmp: 1行(8ドット)ごとにw バイトずつ並べたデータ, h: 行数
+ */
+void ui_draw_bitmap(ui_page_type_t page, uint8_t x, uint8_t y, const uint8_t* bmp, uint8_t w, uint8_t h);
+
+/**
+ * 常駐バッファを持つスクロールページを、最新からlines行遡った所まで表示します
+ * 新しい文字が書かれると最新の表示に戻ります
+ */
+void ui_scroll_back(ui_page_type_t page, int lines);
+
 #include "print.h"
 #define ui_printD(p, n) printD(ui_get_writer(p), n)  // print decimal as string
 #define ui_printW(p, n) printW(ui_get_writer(p), n)  // print word as string
@@ -92,10 +135,38 @@ void ui_write(ui_page_type_t page, char c);
 #define ui_newline() ui_get_writer(p)('\n')          // send newline
 #define ui_printf(p, f, ...) printF(ui_get_writer(p), f, ##__VA_ARGS__)
 
+// 表示フィールドのバインディング
+// ページは表示する値ごとに位置/幅/書式/値の場所を宣言しておき、ui_fields_update() を呼ぶ。
+// 書式関数が出力した文字列を画面のバッファと比べ、変わった文字だけをOLEDに送る。
+typedef void (*ui_field_format_t)(ui_write_t out, const void* src);  // srcの値をoutに出力する
+
+typedef struct {
+    uint8_t x;                 // 表示位置X (文字単位)
+    uint8_t y;                 // 表示位置Y (行)
+    uint8_t width;             // 表示幅 (足りない分は空白で埋める)
+    ui_field_format_t format;  // 書式関数
+    const void* src;           // 表示する値の場所 (書式関数に渡す)
+} ui_field_t;
+
+/**
+ * フィールドを描画します。画面のバッファと違う文字だけを書き込みます
+ * 戻り値は書き換えた文字数
+ */
+int ui_fields_update(ui_page_type_t page, const ui_field_t* fields, int count);
+
 void ui_init(minyasx_context_t* ctx);
 
 void ui_poll(minyasx_context_t* ctx, uint32_t systick_ms);
 
+/**
+ * キー入力をスキャンします (UI_KEY_SCAN_MS 周期のタスクから呼ぶ)
+ * チャタリングを除いて確定したキーの押下、長押し、オートリピートを表示中のページのkeyinに通知します
+ */
+void ui_key_scan(minyasx_context_t* ctx, uint32_t systick_ms);
+
+// キー入力から画面更新完了までの時間 (直近/最大, usec)
+void ui_get_key_latency(uint32_t* last_us, uint32_t* max_us);
+
 // 複数の選択肢を上下キーで選択し、Enterキーで決定するUIを表示する
 // 選択肢はNULL終端の文字列配列で与える
 // 戻り値は選択されたインデックス（0から始まる）
@@ -115,18 +186,4 @@ typedef struct {
 void ui_select_init(ui_select_t* select);
 void ui_select_keyin(ui_select_t* select, ui_key_mask_t keys);
 
-// ログ表示用
-
-typedef enum {
-    UI_LOG_LEVEL_TRACE = 0,  // トレース（詳細情報、デバッグ用）
-    UI_LOG_LEVEL_INFO = 1,   // 情報
-    UI_LOG_LEVEL_WARN = 2,   // 警告
-    UI_LOG_LEVEL_ERROR = 3,  // エラー
-} ui_log_level_t;
-
-void ui_log_set_level(ui_log_level_t level);
-ui_log_level_t ui_log_get_level(void);
-void ui_log_print(ui_log_level_t level, const char* message);
-void ui_log_printf(ui_log_level_t level, const char* format, ...);
-
 #endif  // UI_CONTROL_H
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include "build_profile.h"
 #include "pcfdd/pcfdd_control.h"
 #include "ui_control.h"
 
@@ -10,8 +11,11 @@ void ui_page_about_init(ui_page_context_t* win) {
     win->enter = ui_page_about_enter;
     win->poll = NULL;
     win->keyin = ui_page_about_keyin;
+}
 
-    ui_page_type_t page = win->page;
+void ui_page_about_enter(ui_page_context_t* pctx) {
+    ui_page_type_t page = pctx->page;
+    minyasx_context_t* ctx = pctx->ctx;
 
     ui_cursor(page, 0, 0);
     ui_print(page, "[About]\n");
@@ -20,14 +24,10 @@ void ui_page_about_init(ui_page_context_t* win) {
     ui_print(page, " Firm Version 2.0.0\n");
     ui_print(page, " FDD A:\n");
     ui_print(page, " FDD B:\n");
+    ui_print(page, " Build " BUILD_PROFILE "\n");
     ui_cursor(page, 0, 7);
     ui_print(page, ">RETURN");
-}
-
-void ui_page_about_enter(ui_page_context_t* pctx) {
-    ui_page_type_t page = pctx->page;
-    minyasx_context_t* ctx = pctx->ctx;
-    // Aboutページのポーリング処理
+    // ドライブの状態
     for (int i = 0; i < 2; i++) {
         ui_cursor(page, 7, 4 + i);
         drive_state_t state = ctx->drive[i].state;
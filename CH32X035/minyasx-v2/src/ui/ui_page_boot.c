@@ -0,0 +1,17 @@
+#include "ui/ui_control.h"
+
+// Boot page (X68000の電源が入るまで表示する)
+static void ui_page_boot_enter(ui_page_context_t* pctx);
+
+void ui_page_boot_init(ui_page_context_t* win) {
+    win->enter = ui_page_boot_enter;
+    win->poll = NULL;
+    win->keyin = NULL;
+}
+
+void ui_page_boot_enter(ui_page_context_t* pctx) {
+    ui_page_type_t page = pctx->page;
+    ui_cursor(page, 0, 2);
+    ui_print(page, "      Minyas X\n");
+    ui_print(page, "    - Sleeping -\n");
+}
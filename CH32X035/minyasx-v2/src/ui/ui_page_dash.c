@@ -0,0 +1,135 @@
+#include "build_profile.h"
+#include "timebase/timebase.h"
+#include "trend/trend.h"
+#include "ui_control.h"
+
+#if FEATURE_DASHBOARD
+
+// dashboard page
+static void ui_page_dash_enter(ui_page_context_t* pctx);
+void ui_page_dash_poll(ui_page_context_t* pctx, uint32_t systick_ms);
+void ui_page_dash_keyin(ui_page_context_t* pctx, ui_key_mask_t keys);
+
+// 1つのグラフは2行(16ドット)。左に名前と現在値、右に表示範囲の最大値と最小値を出す
+#define DASH_GRAPHS 4               // 1画面のグラフ数
+#define DASH_GRAPH_X 42             // グラフの左端 (ドット)
+#define DASH_GRAPH_W TREND_SAMPLES  // グラフの幅 (ドット)
+#define DASH_SCALE_X 17             // 最大値/最小値の表示位置 (文字)
+#define DASH_SCREENS 2              // 画面数 (上下キーで切り替え)
+
+#if DASH_GRAPH_X + DASH_GRAPH_W > DASH_SCALE_X * 6
+#error "TREND_SAMPLES is too large for the dashboard"
+#endif
+
+typedef struct {
+    const char* name;  // 名前 (7文字)
+    bool permille;     // 0.1%単位の値か
+} dash_ch_info_t;
+
+static const dash_ch_info_t dash_ch_info[TREND_CH_NUM] = {
+    [TREND_INDEX_A] = {"IDX Ams", false},
+    [TREND_INDEX_B] = {"IDX Bms", false},
+    [TREND_BPS] = {"BPS   k", false},
+    [TREND_I_VBUS] = {"VBUS mA", false},
+    [TREND_I_12V] = {"12V  mA", false},
+    [TREND_I_5V] = {"5V   mA", false},
+    [TREND_LOOP] = {"LOOP  %", true},
+    [TREND_ISR] = {"ISR   %", true},
+};
+
+static const uint8_t dash_screens[DASH_SCREENS][DASH_GRAPHS] = {
+    {TREND_INDEX_A, TREND_INDEX_B, TREND_BPS, TREND_ISR},  // 回転とデータレート
+    {TREND_I_VBUS, TREND_I_12V, TREND_I_5V, TREND_LOOP},   // 電流とループ負荷
+};
+
+static uint8_t dash_screen = 0;
+static uint32_t dash_last_ms = 0;
+
+void ui_page_dash_init(ui_page_context_t* win) {
+    win->enter = ui_page_dash_enter;
+    win->poll = ui_page_dash_poll;
+    win->keyin = ui_page_dash_keyin;
+}
+
+// 1チャンネル分のグラフ(2行)を描く
+static void ui_page_dash_draw(ui_page_type_t page, int slot, trend_ch_t ch) {
+    static uint8_t bmp[2][DASH_GRAPH_W];
+    int count = trend_count();
+    int y = slot * 2;
+
+    // 表示範囲は記録されている区間の最小〜最大
+    uint16_t lo = 0xffff, hi = 0;
+    for (int n = 0; n < count; n++) {
+        uint16_t v = trend_get(ch, n);
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+    }
+    if (count == 0) lo = 0;
+    uint16_t range = (hi > lo) ? (hi - lo) : 1;
+
+    // 古いサンプルが左。前のサンプルとの間を縦線でつなぐ (下端が最小値)
+    for (int x = 0; x < DASH_GRAPH_W; x++) {
+        bmp[0][x] = 0;
+        bmp[1][x] = 0;
+    }
+    int prev = -1;
+    for (int n = 0; n < count; n++) {
+        int level = (int)(trend_get(ch, n) - lo) * 15 / range;  // 0〜15
+        int from = (prev < 0) ? level : prev;
+        int a = (from < level) ? from : level;
+        int b = (from < level) ? level : from;
+        for (int l = a; l <= b; l++) {
+            int row = 15 - l;  // 上端が0
+            bmp[row / 8][DASH_GRAPH_W - count + n] |= 1 << (row % 8);
+        }
+        prev = level;
+    }
+    ui_draw_bitmap(page, DASH_GRAPH_X, y, &bmp[0][0], DASH_GRAPH_W, 2);
+
+    // 名前と現在値
+    const dash_ch_info_t* info = &dash_ch_info[ch];
+    uint16_t now = count ? trend_get(ch, count - 1) : 0;
+    ui_cursor(page, 0, y);
+    ui_print(page, (char*)info->name);
+    ui_cursor(page, 0, y + 1);
+    if (info->permille) {
+        ui_printf(page, "%3d.%1d", now / 10, now % 10);
+    } else {
+        ui_printf(page, "%5d", now);
+    }
+    // 表示範囲 (0.1%単位のものは%に丸める)
+    int div = info->permille ? 10 : 1;
+    ui_cursor(page, DASH_SCALE_X, y);
+    ui_printf(page, "%4d", (hi / div) % 10000);
+    ui_cursor(page, DASH_SCALE_X, y + 1);
+    ui_printf(page, "%4d", (lo / div) % 10000);
+}
+
+static void ui_page_dash_enter(ui_page_context_t* pctx) {
+    for (int slot = 0; slot < DASH_GRAPHS; slot++) {
+        ui_page_dash_draw(pctx->page, slot, dash_screens[dash_screen][slot]);
+    }
+}
+
+void ui_page_dash_poll(ui_page_context_t* pctx, uint32_t systick_ms) {
+    if (time_elapsed(systick_ms, dash_last_ms) < TREND_SAMPLE_MS) {
+        return;
+    }
+    dash_last_ms = systick_ms;
+    // 描き直しても、変わったドットの範囲しかOLEDには送られない
+    ui_page_dash_enter(pctx);
+}
+
+void ui_page_dash_keyin(ui_page_context_t* pctx, ui_key_mask_t keys) {
+    if (keys & (UI_KEY_UP | UI_KEY_DOWN)) {
+        // 表示するグラフの組を切り替える
+        dash_screen = (dash_screen + 1) % DASH_SCREENS;
+        ui_page_dash_enter(pctx);
+    }
+    if (keys & (UI_KEY_LEFT | UI_KEY_ENTER)) {
+        // メインページに戻る
+        ui_change_page(UI_PAGE_MAIN);
+    }
+}
+
+#endif  // FEATURE_DASHBOARD
@@ -1,12 +1,33 @@
+#include "build_profile.h"
+#include "greenpak/greenpak_control.h"
+#include "i2c/i2c_async.h"
+#include "i2c/i2c_profile.h"
+#include "i2c/i2c_stats.h"
+#include "led/led_control.h"
+#include "sched/scheduler.h"
+#include "timebase/timebase.h"
 #include "ui/ui_control.h"
+#include "wdt/wdt_control.h"
+
+#if FEATURE_DEBUG_PAGES
 
 // Debug page
+static void ui_page_debug_enter(ui_page_context_t* pctx);
 static void ui_page_debug_poll(ui_page_context_t* ctx, uint32_t systick_ms);
 static void ui_page_debug_keyin(ui_page_context_t* pctx, ui_key_mask_t keys);
 static void ui_page_debug_keyin_pcfdd(ui_page_context_t* pctx, ui_key_mask_t keys);
+static void ui_page_debug_enter_sched(ui_page_context_t* pctx);
+static void ui_page_debug_poll_sched(ui_page_context_t* pctx, uint32_t systick_ms);
+static void ui_page_debug_keyin_sched(ui_page_context_t* pctx, ui_key_mask_t keys);
+static void ui_page_debug_enter_i2c(ui_page_context_t* pctx);
+static void ui_page_debug_poll_i2c(ui_page_context_t* pctx, uint32_t systick_ms);
+
+// 表示された直後は集計窓の更新を待たずに描く
+static bool debug_redraw = false;
+static void ui_page_debug_keyin_i2c(ui_page_context_t* pctx, ui_key_mask_t keys);
 
 void ui_page_debug_init(ui_page_context_t* win) {
-    win->enter = NULL;
+    win->enter = ui_page_debug_enter;
     win->poll = ui_page_debug_poll;
     win->keyin = ui_page_debug_keyin;
 }
@@ -16,11 +37,61 @@ void ui_page_debug_init_pcfdd(ui_page_context_t* win) {
     win->keyin = ui_page_debug_keyin_pcfdd;
 }
 
+void ui_page_debug_init_sched(ui_page_context_t* win) {
+    win->enter = ui_page_debug_enter_sched;
+    win->poll = ui_page_debug_poll_sched;
+    win->keyin = ui_page_debug_keyin_sched;
+}
+
+void ui_page_debug_init_i2c(ui_page_context_t* win) {
+    win->enter = ui_page_debug_enter_i2c;
+    win->poll = ui_page_debug_poll_i2c;
+    win->keyin = ui_page_debug_keyin_i2c;
+}
+
+void ui_page_debug_enter(ui_page_context_t* pctx) {
+    // 1行目は電源の状態が変わった時にだけ書かれるので、ここで現在の状態を描く
+    ui_cursor(UI_PAGE_DEBUG, 0, 0);
+    ui_print(UI_PAGE_DEBUG, pctx->ctx->power_on ? "X68K PWR ON \n" : "X68K PWR OFF\n");
+    debug_redraw = true;
+}
+
 void ui_page_debug_poll(ui_page_context_t* ctx, uint32_t systick_ms) {
     if (ui_get_current_page() != UI_PAGE_DEBUG) {
         return;
     }
     // Debugページのポーリング処理
+    // スケジューラの集計窓(1秒)が更新されたらアイドル率とループ回数を表示する
+    static uint32_t last_window_ms = 0;
+    const sched_stats_t* st = sched_get_stats();
+    if (st->window_ms == last_window_ms && !debug_redraw) {
+        return;
+    }
+    last_window_ms = st->window_ms;
+    debug_redraw = false;
+    uint32_t key_last_us, key_max_us;
+    ui_get_key_latency(&key_last_us, &key_max_us);
+    uint32_t led_started, led_deferred;
+    WS2812_SPI_get_stats(&led_started, NULL, &led_deferred);
+    // GreenPAK Matrix Inputの問い合わせ数と、実際のI2Cトランザクション数 (毎秒)
+    static gp_matrix_stats_t last_mtx;
+    const gp_matrix_stats_t* mtx = greenpak_get_matrix_stats();
+    ui_cursor(UI_PAGE_DEBUG, 0, 2);
+    ui_printf(UI_PAGE_DEBUG, "MTX Q%3d T%3d %5dus",    //
+              (int)(mtx->queries - last_mtx.queries),  //
+              (int)(mtx->bursts - last_mtx.bursts),    //
+              (int)(int32_t)(mtx->saved_bus_us - last_mtx.saved_bus_us));
+    last_mtx = *mtx;
+
+    const timebase_stats_t* tb = timebase_get_stats();
+    ui_cursor(UI_PAGE_DEBUG, 0, 3);
+    ui_printf(UI_PAGE_DEBUG, "TMR%6d MISS%5d", (int)tb->fired, (int)tb->missed_ticks);
+    ui_cursor(UI_PAGE_DEBUG, 0, 4);
+    ui_printf(UI_PAGE_DEBUG, "LED%6d DEFER%5d", (int)led_started, (int)led_deferred);
+    ui_cursor(UI_PAGE_DEBUG, 0, 5);
+    ui_printf(UI_PAGE_DEBUG, "KEY%5dus MAX%5dus", (int)key_last_us, (int)key_max_us);
+    ui_cursor(UI_PAGE_DEBUG, 0, 6);
+    ui_printf(UI_PAGE_DEBUG, "IDLE%3d%% LOOP%6d", st->idle_pct, (int)st->loops);
 }
 
 void ui_page_debug_keyin(ui_page_context_t* pctx, ui_key_mask_t keys) {
@@ -29,8 +100,8 @@ void ui_page_debug_keyin(ui_page_context_t* pctx, ui_key_mask_t keys) {
         ui_change_page(UI_PAGE_DEBUG_PCFDD);
     }
     if (keys & UI_KEY_RIGHT) {
-        // ログページに遷移
-        ui_change_page(UI_PAGE_LOG);
+        // スケジューラのデバッグページに遷移
+        ui_change_page(UI_PAGE_DEBUG_SCHED);
     }
     if (keys & UI_KEY_ENTER) {
         // メインページに戻る
@@ -48,3 +119,224 @@ void ui_page_debug_keyin_pcfdd(ui_page_context_t* pctx, ui_key_mask_t keys) {
         ui_change_page(UI_PAGE_MAIN);
     }
 }
+
+// ループ周期ヒストグラムのラベル (SCHED_LOOP_HIST_BUCKETS と対応)
+static const char* const loop_hist_labels[SCHED_LOOP_HIST_BUCKETS] = {
+    "<128u", "<512u", "  <2m", "  <8m", " <32m", "<128m", "<512m", ">512m",
+};
+
+// タスク名を5文字幅で表示する (printFの%sは幅指定に対応していないため)
+static void print_task_name(ui_page_type_t page, const sched_task_t* task) {
+    const char* name = task ? task->name : "-";
+    int i = 0;
+    for (; name[i] != 0 && i < 5; i++) {
+        ui_write(page, name[i]);
+    }
+    for (; i < 5; i++) {
+        ui_write(page, ' ');
+    }
+}
+
+void ui_page_debug_enter_sched(ui_page_context_t* pctx) {
+    ui_cursor(pctx->page, 0, 0);
+    ui_print(pctx->page, "=====[Sched/WDT]=====");
+    debug_redraw = true;
+}
+
+void ui_page_debug_poll_sched(ui_page_context_t* pctx, uint32_t systick_ms) {
+    if (ui_get_current_page() != UI_PAGE_DEBUG_SCHED) {
+        return;
+    }
+    // スケジューラの集計窓(1秒)が更新されたら表示する
+    static uint32_t last_window_ms = 0;
+    const sched_stats_t* st = sched_get_stats();
+    if (st->window_ms == last_window_ms && !debug_redraw) {
+        return;
+    }
+    last_window_ms = st->window_ms;
+    debug_redraw = false;
+    ui_page_type_t page = pctx->page;
+
+    // ループ周期のヒストグラム
+    for (int i = 0; i < SCHED_LOOP_HIST_BUCKETS; i += 2) {
+        ui_cursor(page, 0, 1 + i / 2);
+        ui_printf(page, "%s%5d %s%5d",                                     //
+                  loop_hist_labels[i], (int)(st->loop_hist[i] % 100000),  //
+                  loop_hist_labels[i + 1], (int)(st->loop_hist[i + 1] % 100000));
+    }
+
+    // 最も長く実行したタスク
+    const sched_task_t* worst = sched_get_task(st->worst_task);
+    ui_cursor(page, 0, 5);
+    ui_print(page, "WORST ");
+    print_task_name(page, worst);
+    ui_printf(page, "%7dus", (int)(st->worst_run_us % 10000000));
+
+    // ウォッチドッグ
+    const wdt_info_t* wdt = wdt_get_info();
+    const sched_task_t* offender = sched_get_task(wdt->offender);
+    ui_cursor(page, 0, 6);
+    ui_printf(page, "WDT RST%3d ", wdt->reset_count);
+    print_task_name(page, offender);
+    ui_cursor(page, 0, 7);
+    ui_printf(page, "FEED%6d HOLD%5d", (int)(wdt->feeds % 1000000), (int)(wdt->withheld % 100000));
+}
+
+void ui_page_debug_keyin_sched(ui_page_context_t* pctx, ui_key_mask_t keys) {
+    if (keys & UI_KEY_LEFT) {
+        // 通常のデバッグページに遷移
+        ui_change_page(UI_PAGE_DEBUG);
+    }
+    if (keys & UI_KEY_RIGHT) {
+        // I2Cのデバッグページに遷移
+        ui_change_page(UI_PAGE_DEBUG_I2C);
+    }
+    if (keys & UI_KEY_UP) {
+        // ヒストグラムをクリア
+        sched_clear_loop_hist();
+    }
+    if (keys & UI_KEY_ENTER) {
+        // メインページに戻る
+        ui_change_page(UI_PAGE_MAIN);
+    }
+}
+
+// I2Cページの表示内容
+typedef enum {
+    I2C_VIEW_ERRORS,   // デバイスごとのエラー回数
+    I2C_VIEW_LATENCY,  // デバイスごとの所要時間
+    I2C_VIEW_SPEED,    // デバイスごとのバスクロックとスループット
+    I2C_VIEW_QUEUE,    // 優先度ごとのキュー待ち時間
+    I2C_VIEW_CLASS,    // 呼び出し元の分類ごとのバス使用量 (毎秒)
+    I2C_VIEW_NUM,
+} i2c_view_t;
+static uint8_t i2c_view = I2C_VIEW_ERRORS;
+static bool i2c_redraw = false;
+
+static const char* const i2c_prio_names[I2C_PRIO_NUM] = {"NRM", "URG", "BLK"};
+
+void ui_page_debug_enter_i2c(ui_page_context_t* pctx) {
+    i2c_redraw = true;  // ヘッダーも含めて描く
+}
+
+void ui_page_debug_poll_i2c(ui_page_context_t* pctx, uint32_t systick_ms) {
+    if (ui_get_current_page() != UI_PAGE_DEBUG_I2C) {
+        return;
+    }
+    static uint32_t last_window_ms = 0;
+    const sched_stats_t* st = sched_get_stats();
+    if (st->window_ms == last_window_ms && !i2c_redraw) {
+        return;
+    }
+    last_window_ms = st->window_ms;
+    ui_page_type_t page = pctx->page;
+    if (i2c_redraw) {
+        ui_cursor(page, 0, 0);
+        ui_print(page, (i2c_view == I2C_VIEW_CLASS) ? "=====[I2C Bus]=======" : "=====[I2C Dev]=======");
+    }
+    i2c_redraw = false;
+
+    if (i2c_view == I2C_VIEW_CLASS) {
+        // 分類ごとに1行 (毎秒のトランザクション数 バイト数 バス使用率 エラー数)
+        for (int cls = 0; cls < I2C_CLASS_NUM; cls++) {
+            const i2c_class_count_t* r = &i2c_class_stats_get((i2c_class_t)cls)->rate;
+            ui_cursor(page, 0, 1 + cls);
+            ui_printf(page, "%s%3dt%5dB%3d%%%2de",                                                         //
+                      i2c_class_name((i2c_class_t)cls), (int)(r->xfers % 1000), (int)(r->bytes % 100000),  //
+                      (int)(r->busy_us / 10000), (int)(r->errors % 100));
+        }
+        return;
+    }
+
+    if (i2c_view == I2C_VIEW_QUEUE) {
+        // 優先度ごとに1行 (開始数 A:平均 M:最大 usec)
+        const i2c_async_stats_t* as = i2c_async_get_stats();
+        for (int prio = 0; prio < I2C_PRIO_NUM; prio++) {
+            const i2c_prio_stats_t* ps = &as->prio[prio];
+            uint32_t avg_us = ps->count ? ps->total_wait_us / ps->count : 0;
+            ui_cursor(page, 0, 1 + prio);
+            ui_printf(page, "%s%5d A%4d M%5d",                                                 //
+                      i2c_prio_names[prio], (int)(ps->count % 100000), (int)(avg_us % 10000),  //
+                      (int)(ps->max_wait_us % 100000));
+        }
+        for (int y = 1 + I2C_PRIO_NUM; y < 8; y++) {
+            ui_cursor(page, 0, y);
+            ui_print(page, "                     ");
+        }
+        return;
+    }
+
+    // デバイスごとに1行 (N:NACK T:タイムアウト R:バス復旧 / 成功数 A:平均 M:最大 usec /
+    //                   クロック(*は起動時に検証済み) スループット エラーでクロックを下げた回数)
+    for (int dev = 0; dev < I2C_DEV_NUM; dev++) {
+        const i2c_dev_stats_t* ds = i2c_stats_get((i2c_dev_t)dev);
+        ui_cursor(page, 0, 1 + dev);
+        const char* name = i2c_dev_name((i2c_dev_t)dev);
+        if (i2c_view == I2C_VIEW_SPEED) {
+            const i2c_profile_t* prof = i2c_profile_get((i2c_dev_t)dev);
+            uint32_t total_ms = ds->total_us / 1000;
+            uint32_t bps = 0;
+            if (total_ms > 0) {
+                // 32bitで溢れないように、バイト数が大きい時は先に割る
+                bps = (ds->bytes < 4000000) ? ds->bytes * 1000 / total_ms : ds->bytes / total_ms * 1000;
+            }
+            ui_printf(page, "%s%4dk%c%6dB/s%2d",                                                   //
+                      name, (int)(i2c_speed_hz(prof->speed) / 1000), prof->validated ? '*' : ' ',  //
+                      (int)(bps % 1000000), (int)(prof->fallbacks % 100));
+        } else if (i2c_view == I2C_VIEW_LATENCY) {
+            uint32_t avg_us = ds->xfers ? ds->total_us / ds->xfers : 0;
+            ui_printf(page, "%s%4d A%4d M%5d",                                //
+                      name, (int)(ds->xfers % 10000), (int)(avg_us % 10000),  //
+                      (int)ds->max_us);
+        } else {
+            ui_printf(page, "%sN%4d T%4d R%4d",                                     //
+                      name, (int)(ds->nacks % 10000), (int)(ds->timeouts % 10000),  //
+                      (int)(ds->recoveries % 10000));
+        }
+    }
+}
+
+// 分類ごとの累計をログに書き出す
+static void ui_page_debug_dump_i2c(void) {
+    ui_print(UI_PAGE_LOG, "I2C total t/B/ms/e\n");
+    for (int cls = 0; cls < I2C_CLASS_NUM; cls++) {
+        const i2c_class_count_t* t = &i2c_class_stats_get((i2c_class_t)cls)->total;
+        ui_printf(UI_PAGE_LOG, "%s%5d%6d%4d%2d\n",                                                        //
+                  i2c_class_name((i2c_class_t)cls), (int)(t->xfers % 100000), (int)(t->bytes % 1000000),  //
+                  (int)(t->busy_us / 1000 % 10000), (int)(t->errors % 100));
+    }
+}
+
+void ui_page_debug_keyin_i2c(ui_page_context_t* pctx, ui_key_mask_t keys) {
+    if (keys & UI_KEY_LEFT) {
+        // スケジューラのデバッグページに遷移
+        ui_change_page(UI_PAGE_DEBUG_SCHED);
+    }
+    if (keys & UI_KEY_RIGHT) {
+        // フラッシュログページに遷移
+        ui_change_page(UI_PAGE_FLASHLOG);
+    }
+    if (keys & UI_KEY_DOWN) {
+        // エラー回数/所要時間/クロック/キュー待ち時間/バス使用量の表示を切り替える
+        i2c_view = (i2c_view + 1) % I2C_VIEW_NUM;
+        i2c_redraw = true;
+    }
+    if (keys & UI_KEY_UP) {
+        // 統計をクリア
+        i2c_stats_clear();
+        i2c_async_clear_wait_stats();
+        i2c_redraw = true;
+    }
+    if (keys & UI_KEY_ENTER) {
+        if (i2c_view == I2C_VIEW_CLASS) {
+            // バス使用量の表示中は、累計をログに書き出してログページに遷移
+            ui_page_debug_dump_i2c();
+            ui_change_page(UI_PAGE_LOG);
+            return;
+        }
+        // メインページに戻る
+        ui_change_page(UI_PAGE_MAIN);
+    }
+}
+
+#endif  // FEATURE_DEBUG_PAGES
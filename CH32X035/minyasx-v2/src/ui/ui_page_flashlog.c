@@ -0,0 +1,92 @@
+#include "build_profile.h"
+#include "log/flash_log.h"
+#include "telemetry/telemetry.h"
+#include "ui_control.h"
+
+// flash log page
+static void ui_page_flashlog_enter(ui_page_context_t* pctx);
+void ui_page_flashlog_poll(ui_page_context_t* pctx, uint32_t systick_ms);
+void ui_page_flashlog_keyin(ui_page_context_t* pctx, ui_key_mask_t keys);
+
+#define FLOG_VIEW_ROWS 7  // 見出しを除いて表示できるレコード数
+
+static int flog_view_top = 0;    // 一番上に表示するレコード (新しい方から数えた番号)
+static int flog_view_count = 0;  // 表示した時点のレコード数
+
+void ui_page_flashlog_init(ui_page_context_t* win) {
+    win->enter = ui_page_flashlog_enter;
+    win->poll = ui_page_flashlog_poll;
+    win->keyin = ui_page_flashlog_keyin;
+}
+
+// 画面に出す引数の値 (複数の値を詰めているものは主な値だけにする)
+static uint32_t flog_view_arg(const flashlog_rec_t* rec) {
+    switch (rec->type) {
+    case FLOG_PD_12V:
+        return rec->arg & 0xffff;
+    case FLOG_STALL:
+        return rec->arg & 0xffffff;
+    default:
+        return rec->arg;
+    }
+}
+
+static void ui_page_flashlog_enter(ui_page_context_t* pctx) {
+    ui_page_type_t page = pctx->page;
+    flog_view_count = flashlog_count();
+
+    ui_cursor(page, 0, 0);
+    ui_printf(page, "==[Flash Log]==%5d", flog_view_count % 100000);
+    // 1行: 起動回数 時刻(秒) 種類 引数
+    for (int i = 0; i < FLOG_VIEW_ROWS; i++) {
+        flashlog_rec_t rec;
+        ui_cursor(page, 0, 1 + i);
+        if (!flashlog_get(flog_view_top + i, &rec)) {
+            ui_print(page, "                    ");
+            continue;
+        }
+        ui_printf(page, "%2d%6d %s%6d",                                 //
+                  rec.boot % 100, (int)(rec.time_ms / 1000 % 1000000),  //
+                  flashlog_type_name(rec.type), (int)(flog_view_arg(&rec) % 1000000));
+    }
+}
+
+void ui_page_flashlog_poll(ui_page_context_t* pctx, uint32_t systick_ms) {
+    if (flashlog_count() != flog_view_count) {
+        // レコードが増えたら描き直す
+        ui_page_flashlog_enter(pctx);
+    }
+}
+
+void ui_page_flashlog_keyin(ui_page_context_t* pctx, ui_key_mask_t keys) {
+    if (keys & UI_KEY_UP) {
+        // 新しい方へ
+        if (flog_view_top > 0) {
+            flog_view_top--;
+            ui_page_flashlog_enter(pctx);
+        }
+    }
+    if (keys & UI_KEY_DOWN) {
+        // 古い方へ
+        if (flog_view_top + FLOG_VIEW_ROWS < flashlog_count()) {
+            flog_view_top++;
+            ui_page_flashlog_enter(pctx);
+        }
+    }
+    if (keys & UI_KEY_LEFT) {
+        // I2Cのデバッグページに遷移
+        ui_change_page(UI_PAGE_DEBUG_I2C);
+    }
+    if (keys & UI_KEY_RIGHT) {
+        // ログページに遷移
+        ui_change_page(UI_PAGE_LOG);
+    }
+#if FEATURE_TELEMETRY
+    if (keys & UI_KEY_ENTER) {
+        // 全レコードをテレメトリ($FL)で書き出す。見出しの件数の所に結果を出す
+        bool ok = telemetry_flashlog();
+        ui_cursor(pctx->page, 0, 0);
+        ui_printf(pctx->page, "==[Flash Log]=>%5s", ok ? "$FL" : "NoDbg");
+    }
+#endif
+}
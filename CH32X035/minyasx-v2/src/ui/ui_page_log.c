@@ -1,26 +1,65 @@
+#include "log/log_ring.h"
 #include "ui_control.h"
 
 // log page
+void ui_page_log_poll(ui_page_context_t* pctx, uint32_t systick_ms);
 void ui_page_log_keyin(ui_page_context_t* pctx, ui_key_mask_t keys);
 
+#define LOG_DRAIN_PER_POLL 8  // 1回のポーリングで書式化するログの最大件数
+
+// ログは非表示の間も書かれるので、このページだけ常駐バッファを持つ
+#if UI_LOG_ROWS < 8
+#error "UI_LOG_ROWS must be 8 or more"
+#endif
+static uint8_t log_store[UI_LOG_ROWS][21];
+
 void ui_page_log_init(ui_page_context_t* pcon) {
     pcon->enter = NULL;
-    pcon->poll = NULL;
+    pcon->poll = ui_page_log_poll;
     pcon->keyin = ui_page_log_keyin;
     pcon->scroll_enable = true;
     pcon->scroll_keepheader = true;
+    pcon->store = log_store;
+    pcon->store_rows = UI_LOG_ROWS;
+    ui_clear(pcon->page);
     ui_cursor(pcon->page, 0, 0);
     ui_print(pcon->page, "========[Log]======\n");
 }
 
+// ログリングに溜まったログを、表示している間だけ書式化してページに書き出す
+// (非表示の間もリングは上書きしながら書かれ続けるので、戻ってきた時は残っている分から続ける)
+void ui_page_log_poll(ui_page_context_t* pctx, uint32_t systick_ms) {
+    if (pctx->scroll_back) {
+        return;  // 遡って見ている間は書き出さない (書くと最新の表示に戻ってしまう)
+    }
+    static uint32_t cursor = 0;  // 次に表示するログの位置
+    uint32_t lost = 0;
+    log_entry_t e;
+    for (int i = 0; i < LOG_DRAIN_PER_POLL && log_read(&cursor, &e, &lost); i++) {
+        if (lost != 0) {
+            // 表示する前に上書きされたログがあったことを示しておく
+            ui_printf(pctx->page, "[lost %d]\n", (int)lost);
+            lost = 0;
+        }
+        log_format(ui_get_writer(pctx->page), &e);
+    }
+}
+
 void ui_page_log_keyin(ui_page_context_t* pctx, ui_key_mask_t keys) {
+    if (keys & UI_KEY_UP) {
+        // 古いログを遡る
+        ui_scroll_back(pctx->page, pctx->scroll_back + 1);
+    }
+    if (keys & UI_KEY_DOWN) {
+        ui_scroll_back(pctx->page, pctx->scroll_back - 1);
+    }
     if (keys & UI_KEY_RIGHT) {
         // メインページに戻る
         ui_change_page(UI_PAGE_MAIN);
     }
     if (keys & UI_KEY_LEFT) {
-        // デバッグページに遷移
-        ui_change_page(UI_PAGE_DEBUG);
+        // フラッシュログページに遷移
+        ui_change_page(UI_PAGE_FLASHLOG);
     }
     if (keys & UI_KEY_ENTER) {
         // メニューページに戻る
@@ -1,4 +1,5 @@
 #include "pcfdd/pcfdd_control.h"
+#include "timebase/timebase.h"
 #include "ui/ui_control.h"
 
 // main page
@@ -6,60 +7,93 @@ static void ui_page_main_enter(ui_page_context_t* pctx);
 void ui_page_main_poll(ui_page_context_t* pctx, uint32_t systick_ms);
 void ui_page_main_keyin(ui_page_context_t* pctx, ui_key_mask_t keys);
 
+//
+// 表示フィールドの書式
+//
+static void fmt_voltage(ui_write_t out, const void* src) {
+    const power_status_t* pw = src;
+    printF(out, "%4s:%2d.%02dV", pw->label, pw->voltage_mv / 1000, (pw->voltage_mv % 1000) / 10);
+}
+
+static void fmt_current(ui_write_t out, const void* src) {
+    const power_status_t* pw = src;
+    printF(out, "     %4dmA", pw->current_ma);
+}
+
+static void fmt_state(ui_write_t out, const void* src) {
+    const drive_status_t* drv = src;
+    printF(out, "[%s]", pcfdd_state_to_string(drv->state));
+}
+
+static void fmt_rpm_setting(ui_write_t out, const void* src) {
+    const drive_status_t* drv = src;
+    printF(out, " S:%3drpm", drv->rpm_setting == FDD_RPM_300 ? 300 : 360);
+}
+
+static void fmt_rpm_measured(ui_write_t out, const void* src) {
+    const drive_status_t* drv = src;
+    if (drv->rpm_measured == FDD_RPM_UNKNOWN) {
+        printS(out, " M:---rpm");
+    } else {
+        printF(out, " M:%3drpm", drv->rpm_measured == FDD_RPM_300 ? 300 : 360);
+    }
+}
+
+static void fmt_bps_measured(ui_write_t out, const void* src) {
+    const drive_status_t* drv = src;
+    if (drv->bps_measured == BPS_UNKNOWN) {
+        printS(out, " M:---k");
+    } else {
+        printF(out, " M:%3dk", (int)(fdd_bps_mode_to_value(drv->bps_measured) / 1000));
+    }
+}
+
+// 電源3系統 x 2行 + ドライブ2台 x 4行
+#define MAIN_NUM_FIELDS (3 * 2 + 2 * 4)
+static ui_field_t main_fields[MAIN_NUM_FIELDS];
+
 void ui_page_main_init(ui_page_context_t* pctx) {
     pctx->enter = ui_page_main_enter;
     pctx->poll = ui_page_main_poll;
     pctx->keyin = ui_page_main_keyin;
-    ui_clear(UI_PAGE_MAIN);
-    ui_cursor(UI_PAGE_MAIN, 10, 0);
-    ui_print(UI_PAGE_MAIN, "-Minyas X-");
+
+    // 値の場所はコンテキスト内で固定なので、起動時に一度だけ結び付けておく
+    minyasx_context_t* ctx = pctx->ctx;
+    ui_field_t* f = main_fields;
+    for (int i = 0; i < 3; i++) {
+        *f++ = (ui_field_t){10, 1 + i * 2, 11, fmt_voltage, &ctx->power[i]};
+        *f++ = (ui_field_t){10, 2 + i * 2, 11, fmt_current, &ctx->power[i]};
+    }
+    for (int i = 0; i < 2; i++) {
+        *f++ = (ui_field_t){1, 0 + i * 4, 9, fmt_state, &ctx->drive[i]};
+        *f++ = (ui_field_t){0, 1 + i * 4, 9, fmt_rpm_setting, &ctx->drive[i]};
+        *f++ = (ui_field_t){0, 2 + i * 4, 9, fmt_rpm_measured, &ctx->drive[i]};
+        *f++ = (ui_field_t){0, 3 + i * 4, 9, fmt_bps_measured, &ctx->drive[i]};
+    }
 }
 
 void ui_page_main_enter(ui_page_context_t* pctx) {
+    ui_page_type_t page = pctx->page;
+    ui_cursor(page, 10, 0);
+    ui_print(page, "-Minyas X-");
+    // ドライブ名は変わらないので、ここで描いておく
+    for (int i = 0; i < 2; i++) {
+        ui_cursor(page, 0, i * 4);
+        ui_write(page, i == 0 ? 'A' : 'B');
+    }
+    ui_fields_update(page, main_fields, MAIN_NUM_FIELDS);
 }
 
 void ui_page_main_poll(ui_page_context_t* pctx, uint32_t systick_ms) {
-    static uint64_t last_tick = 0;
-    ui_page_type_t page = pctx->page;
-    minyasx_context_t* ctx = pctx->ctx;
+    static uint32_t last_tick = 0;
 
-    if (systick_ms - last_tick < 500) {
+    if (time_elapsed(systick_ms, last_tick) < 500) {
         return;
     }
     last_tick = systick_ms;
 
-    // 電源情報の表示
-    for (int i = 0; i < 3; i++) {
-        ui_cursor(page, 10, 1 + i * 2);
-        ui_printf(page, "%4s:%2d.%02dV",            //
-                  ctx->power[i].label,              //
-                  ctx->power[i].voltage_mv / 1000,  //
-                  (ctx->power[i].voltage_mv % 1000) / 10);
-        ui_cursor(page, 10, 2 + i * 2);
-        ui_printf(page, "     %4dmA", ctx->power[i].current_ma);
-    }
-    // ドライブ情報の表示
-    for (int i = 0; i < 2; i++) {
-        ui_cursor(page, 0, 0 + i * 4);
-        ui_printf(page, "%c[%s]", (i == 0 ? 'A' : 'B'), pcfdd_state_to_string(ctx->drive[i].state));
-        ui_cursor(page, 0, 1 + i * 4);
-        ui_printf(page, " S:%3drpm", ctx->drive[i].rpm_setting == FDD_RPM_300 ? 300 : 360);
-        //
-        ui_cursor(page, 0, 2 + i * 4);
-        if (ctx->drive[i].rpm_measured == FDD_RPM_UNKNOWN) {
-            ui_print(page, " M:---rpm");
-        } else {
-            ui_printf(page, " M:%3drpm", ctx->drive[i].rpm_measured == FDD_RPM_300 ? 300 : 360);
-        }
-        //
-        ui_cursor(page, 0, 3 + i * 4);
-        if (ctx->drive[i].bps_measured == BPS_UNKNOWN) {
-            ui_print(page, " M:---k");
-        } else {
-            int bps = fdd_bps_mode_to_value(ctx->drive[i].bps_measured) / 1000;
-            ui_printf(page, " M:%3dk", bps);
-        }
-    }
+    // 値が変わったフィールドの、変わった文字だけが書き換わる
+    ui_fields_update(pctx->page, main_fields, MAIN_NUM_FIELDS);
 }
 
 void ui_page_main_keyin(ui_page_context_t* pctx, ui_key_mask_t keys) {
@@ -71,6 +105,19 @@ void ui_page_main_keyin(ui_page_context_t* pctx, ui_key_mask_t keys) {
         // ログページに遷移
         ui_change_page(UI_PAGE_LOG);
     }
+    if (keys & UI_KEY_RIGHT) {
+        // ダッシュボードに遷移
+        ui_change_page(UI_PAGE_DASH);
+    }
+    if (keys & UI_KEY_LONG(UI_KEY_EJECT_A | UI_KEY_EJECT_B)) {
+        // イジェクトボタンの長押しは、EJECT_MASKに関わらず強制的にイジェクトする
+        for (int i = 0; i < 2; i++) {
+            if ((keys & UI_KEY_LONG(i == 0 ? UI_KEY_EJECT_A : UI_KEY_EJECT_B)) && pctx->ctx->drive[i].state == DRIVE_STATE_READY) {
+                pcfdd_force_eject(pctx->ctx, i);
+            }
+        }
+        return;
+    }
     if (keys & UI_KEY_EJECT_A) {
         // ドライブAのイジェクトボタン
         if (pctx->ctx->drive[0].state == DRIVE_STATE_READY) {
@@ -1,31 +1,36 @@
+#include "build_profile.h"
 #include "ui/ui_control.h"
 
+static void ui_page_menu_enter(ui_page_context_t* pctx);
 static void ui_page_menu_keyin(ui_page_context_t* pctx, ui_key_mask_t keys);
 
 static int position = 1;  // メニューの選択行
 
-#define DEBUG_MENU_ENABLED 1  // デバッグメニューを有効にする場合はコメントアウトを外す
-#define NUM_MENU_ITEMS (DEBUG_MENU_ENABLED ? 7 : 6)
+#define NUM_MENU_ITEMS (FEATURE_DEBUG_PAGES ? 7 : 6)  // デバッグメニューはビルドプロファイルで有無が決まる
 
 void ui_page_menu_init(ui_page_context_t* win) {
-    win->enter = NULL;
+    win->enter = ui_page_menu_enter;
     win->poll = NULL;
     win->keyin = ui_page_menu_keyin;
+}
 
-    // メニューページの初期化処理
+static void ui_page_menu_enter(ui_page_context_t* pctx) {
+    // メニューページの描画
     ui_cursor(UI_PAGE_MENU, 0, 0);
     ui_print(UI_PAGE_MENU, "[Menu]\n");
-    ui_print(UI_PAGE_MENU, ">About\n");
+    ui_print(UI_PAGE_MENU, " About\n");
     ui_print(UI_PAGE_MENU, " USB-PD Status\n");
     ui_print(UI_PAGE_MENU, " Common Setting\n");
     ui_print(UI_PAGE_MENU, " FDD A Setting\n");
     ui_print(UI_PAGE_MENU, " FDD B Setting\n");
-#ifdef DEBUG_MENU_ENABLED
+#if FEATURE_DEBUG_PAGES
     ui_print(UI_PAGE_MENU, " Debug Setting\n");
 #else
     ui_print(UI_PAGE_MENU, " \n");
 #endif
     ui_print(UI_PAGE_MENU, " RETURN");
+    ui_cursor(UI_PAGE_MENU, 0, position);
+    ui_print(UI_PAGE_MENU, ">");
 }
 
 static void set_position(int pos) {
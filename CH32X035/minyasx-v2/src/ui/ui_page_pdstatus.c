@@ -6,11 +6,13 @@ void ui_page_pdstatus_poll(ui_page_context_t* pctx, uint32_t systick_ms);
 void ui_page_pdstatus_keyin(ui_page_context_t* pctx, ui_key_mask_t keys);
 
 void ui_page_pdstatus_init(ui_page_context_t* win) {
-    win->enter = NULL;
+    win->enter = ui_page_pdstatus_enter;
     win->poll = ui_page_pdstatus_poll;
     win->keyin = ui_page_pdstatus_keyin;
+}
 
-    ui_page_type_t page = win->page;
+void ui_page_pdstatus_enter(ui_page_context_t* pctx) {
+    ui_page_type_t page = pctx->page;
     ui_cursor(page, 0, 0);
     ui_print(page, "[USB-PD Status]\n");
     ui_cursor(page, 0, 7);
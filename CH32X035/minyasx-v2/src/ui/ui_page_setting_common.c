@@ -1,3 +1,4 @@
+#include "greenpak/greenpak_auto.h"
 #include "power/power_control.h"
 #include "ui/ui_control.h"
 
@@ -6,6 +7,25 @@ static void ui_page_setting_common_enter(ui_page_context_t* pctx);
 static void ui_page_setting_common_poll(ui_page_context_t* pctx, uint32_t systick_ms);
 static void ui_page_setting_common_keyin(ui_page_context_t* pctx, ui_key_mask_t keys);
 
+static int position = 1;  // 現在の選択位置 (1-7)
+
+static int gp_verify_result = -1;  // GP VERIFYの結果 (-1:未実行, 0:一致, 1以上:不一致の台数)
+
+static void fmt_verify(ui_write_t out, const void* src) {
+    int result = *(const int*)src;
+    if (result < 0) {
+        printS(out, "----");
+    } else if (result == 0) {
+        printS(out, "OK");
+    } else {
+        printF(out, "NG %d", result);
+    }
+}
+
+static const ui_field_t common_fields[] = {
+    {12, 2, 4, fmt_verify, &gp_verify_result},  //
+};
+
 void ui_page_setting_common_init(ui_page_context_t* win) {
     win->enter = ui_page_setting_common_enter;
     win->poll = ui_page_setting_common_poll;
@@ -16,13 +36,16 @@ void ui_page_setting_common_enter(ui_page_context_t* pctx) {
     ui_page_type_t page = pctx->page;
     ui_cursor(page, 0, 0);
     ui_print(page, "[Common Setting]\n");
-    ui_print(page, ">Speaker   [----]\n");
-    ui_print(page, "\n");
+    ui_print(page, " Speaker   [----]\n");
+    ui_print(page, " GP VERIFY [----]\n");
     ui_print(page, "\n");
     ui_print(page, "\n");
     ui_print(page, "\n");
     ui_print(page, "\n");
     ui_print(page, " RETURN");
+    ui_cursor(page, 0, position);
+    ui_print(page, ">");
+    ui_fields_update(page, common_fields, sizeof(common_fields) / sizeof(common_fields[0]));
 }
 
 void ui_page_setting_common_poll(ui_page_context_t* pctx, uint32_t systick_ms) {
@@ -34,7 +57,6 @@ void ui_page_setting_common_poll(ui_page_context_t* pctx, uint32_t systick_ms) {
 //
 // Key callback
 //
-static int position = 1;  // 現在の選択位置 (1-7)
 
 static void set_position(int pos) {
     ui_page_type_t page = UI_PAGE_SETTING_COMMON;
@@ -43,7 +65,7 @@ static void set_position(int pos) {
     int new_pos = pos;
     if (new_pos < 1) new_pos = 1;
     if (new_pos > 7) new_pos = 7;
-    while ((new_pos >= 2) && (new_pos <= 6)) {
+    while ((new_pos >= 3) && (new_pos <= 6)) {
         new_pos = (new_pos < position) ? new_pos - 1 : new_pos + 1;  // 空行を飛ばす
     }
     position = new_pos;
@@ -70,6 +92,12 @@ void ui_page_setting_common_keyin(ui_page_context_t* pctx, ui_key_mask_t keys) {
             // Speaker
             // SpeakerのON/OFFをトグルする
             break;
+        case 2:
+            // GP VERIFY
+            // スタンプを使わずにNVMを全数検証する。不一致ならスタンプを消し、次回の起動時に書き換えさせる
+            gp_verify_result = greenpak_verify_all();
+            ui_fields_update(pctx->page, common_fields, sizeof(common_fields) / sizeof(common_fields[0]));
+            break;
         case 7:
             // RETURN
             ui_change_page(UI_PAGE_MENU);
@@ -1,14 +1,56 @@
+#include "build_profile.h"
 #include "pcfdd/pcfdd_control.h"
 #include "power/power_control.h"
 #include "ui/ui_control.h"
 
+#if FEATURE_DEBUG_PAGES
+
 #define NUM_MENU_ITEMS 5
 
 // debug Setting page
+
 static void ui_page_setting_debug_enter(ui_page_context_t* pctx);
 static void ui_page_setting_debug_poll(ui_page_context_t* pctx, uint32_t systick_ms);
 static void ui_page_setting_debug_keyin(ui_page_context_t* pctx, ui_key_mask_t keys);
 
+static int position = 1;  // 現在の選択位置 (1-7)
+
+//
+// 表示フィールドの書式
+//
+typedef struct {
+    volatile uint32_t* indr;  // 入力データレジスタ
+    uint8_t bit;              // ビット番号 (High=ON)
+} debug_pin_t;
+
+// PB4 : MOTOR_ON_DOSV, PC6 : GP_ENABLE, PB2 : FDD_DS_A, PB3 : FDD_DS_B (いずれもアクティブHigh)
+static const debug_pin_t pin_motor = {&GPIOB->INDR, 4};
+static const debug_pin_t pin_gp_enable = {&GPIOC->INDR, 6};
+static const debug_pin_t pin_ds_a = {&GPIOB->INDR, 2};
+static const debug_pin_t pin_ds_b = {&GPIOB->INDR, 3};
+
+static void fmt_on_off(ui_write_t out, bool on) {
+    printS(out, on ? "ON" : "OFF");
+}
+
+static void fmt_pin(ui_write_t out, const void* src) {
+    const debug_pin_t* pin = src;
+    fmt_on_off(out, (*pin->indr & (1 << pin->bit)) != 0);
+}
+
+static void fmt_fdd_power(ui_write_t out, const void* src) {
+    (void)src;
+    fmt_on_off(out, fdd_power_is_enabled());
+}
+
+static const ui_field_t debug_fields[] = {
+    {12, 1, 4, fmt_pin, &pin_motor},      //
+    {12, 2, 4, fmt_pin, &pin_gp_enable},  //
+    {12, 3, 4, fmt_fdd_power, NULL},      //
+    {12, 4, 4, fmt_pin, &pin_ds_a},       //
+    {12, 5, 4, fmt_pin, &pin_ds_b},       //
+};
+
 void ui_page_setting_debug_init(ui_page_context_t* win) {
     win->enter = ui_page_setting_debug_enter;
     win->poll = ui_page_setting_debug_poll;
@@ -19,49 +61,29 @@ void ui_page_setting_debug_enter(ui_page_context_t* pctx) {
     ui_page_type_t page = pctx->page;
     ui_cursor(page, 0, 0);
     ui_print(page, "[Debug Setting]\n");
-    ui_print(page, ">MOTOR     [----]\n");
+    ui_print(page, " MOTOR     [----]\n");
     ui_print(page, " GP ENABLE [----]\n");
     ui_print(page, " FDDPW ENA [----]\n");
     ui_print(page, " DS A      [----]\n");
     ui_print(page, " DS B      [----]\n");
     ui_print(page, "\n");
     ui_print(page, " RETURN");
+    ui_cursor(page, 0, position);
+    ui_print(page, ">");
+    ui_fields_update(page, debug_fields, sizeof(debug_fields) / sizeof(debug_fields[0]));
 }
 
 void ui_page_setting_debug_poll(ui_page_context_t* pctx, uint32_t systick_ms) {
     if (ui_get_current_page() != pctx->page) {
         return;
     }
-    // debug Settingページのポーリング処理
-    // PB4 : MOTOR_ON_DOSV output
-    // PBN4の出力状態を読み取り、MOTORのON/OFFを表示する
-    uint32_t portb = GPIOB->INDR;
-    bool motor_enabled = (portb & (1 << 4));  // MOTOR_ON_DOSV is active high
-    ui_cursor(pctx->page, 12, 1);
-    ui_printf(pctx->page, "%4s", motor_enabled ? "ON  " : "OFF ");
-    // PCFDDのGP ENABLE出力 (PC6) の状態を読み取り、表示する
-    uint32_t portc = GPIOC->INDR;
-    bool gp_enabled = (portc & (1 << 6));  // GP_ENABLE is active high
-    ui_cursor(pctx->page, 12, 2);
-    ui_printf(pctx->page, "%4s", gp_enabled ? "ON  " : "OFF ");
-    // FDD Power Enableの状態を読み取り、表示する
-    bool fddpw_enabled = fdd_power_is_enabled();
-    ui_cursor(pctx->page, 12, 3);
-    ui_printf(pctx->page, "%4s", fddpw_enabled ? "ON  " : "OFF ");
-    // DS A (PB2) の状態を読み取り、表示する
-    bool ds_a_enabled = (portb & (1 << 2));  // FDD_DS_A is active high
-    ui_cursor(pctx->page, 12, 4);
-    ui_printf(pctx->page, "%4s", ds_a_enabled ? "ON  " : "OFF ");
-    // DS B (PB3) の状態を読み取り、表示する
-    bool ds_b_enabled = (portb & (1 << 3));  // FDD_DS_B is active high
-    ui_cursor(pctx->page, 12, 5);
-    ui_printf(pctx->page, "%4s", ds_b_enabled ? "ON  " : "OFF ");
+    // 出力ピンの状態などを表示する。変わった文字だけが書き換わる
+    ui_fields_update(pctx->page, debug_fields, sizeof(debug_fields) / sizeof(debug_fields[0]));
 }
 
 //
 // Key callback
 //
-static int position = 1;  // 現在の選択位置 (1-7)
 
 static void set_position(int pos) {
     ui_page_type_t page = UI_PAGE_SETTING_DEBUG;
@@ -164,4 +186,6 @@ void ui_page_setting_debug_keyin(ui_page_context_t* pctx, ui_key_mask_t keys) {
             break;
         }
     }
-}
\ No newline at end of file
+}
+
+#endif  // FEATURE_DEBUG_PAGES
@@ -46,35 +46,20 @@ ui_select_t in_use_select = {
     .selection_made = true,  // ここをfalseにすると選択モードに入る
 };
 
-void ui_page_setting_fdd_init(ui_page_context_t* win, int drive);
-
 void ui_page_setting_fdda_init(ui_page_context_t* win) {
     win->enter = ui_page_setting_fdda_enter;
     win->poll = NULL;
     win->keyin = ui_page_setting_fdda_keyin;
-    ui_page_setting_fdd_init(win, 0);
 }
 void ui_page_setting_fddb_init(ui_page_context_t* win) {
     win->enter = ui_page_setting_fddb_enter;
     win->poll = NULL;
     win->keyin = ui_page_setting_fddb_keyin;
-    ui_page_setting_fdd_init(win, 1);
 }
 
 #define DRIVE_LETTER(drive) ((drive) == 0 ? 'A' : 'B')
 
-void ui_page_setting_fdd_init(ui_page_context_t* win, int drive) {
-    ui_page_type_t page = win->page;
-    ui_cursor(page, 0, 0);
-    ui_printf(page, "[FDD %c Setting]\n", DRIVE_LETTER(drive));
-    ui_print(page, ">RPM        [----]\n");
-    ui_print(page, " MODE SEL   [----]\n");
-    ui_print(page, " IN-USE pin [----]\n");
-    ui_print(page, "\n");
-    ui_print(page, "\n");
-    ui_print(page, "\n");
-    ui_print(page, " RETURN");
-}
+int position = 1;  // 現在の選択位置 (1-7)
 
 void ui_page_setting_fdda_enter(ui_page_context_t* pctx) {
     ui_page_setting_fdd_enter(pctx, 0);
@@ -87,6 +72,17 @@ void ui_page_setting_fddb_enter(ui_page_context_t* pctx) {
 void ui_page_setting_fdd_enter(ui_page_context_t* pctx, int drive) {
     ui_page_type_t page = (drive == 0) ? UI_PAGE_SETTING_FDDA : UI_PAGE_SETTING_FDDB;
     minyasx_context_t* ctx = pctx->ctx;
+    ui_cursor(page, 0, 0);
+    ui_printf(page, "[FDD %c Setting]\n", DRIVE_LETTER(drive));
+    ui_print(page, " RPM        [----]\n");
+    ui_print(page, " MODE SEL   [----]\n");
+    ui_print(page, " IN-USE pin [----]\n");
+    ui_print(page, "\n");
+    ui_print(page, "\n");
+    ui_print(page, "\n");
+    ui_print(page, " RETURN");
+    ui_cursor(page, 0, position);
+    ui_print(page, ">");
     // RPM
     ui_cursor(page, 13, 1);
     switch (ctx->drive[drive].rpm_control) {
@@ -132,7 +128,6 @@ void ui_page_setting_fdd_enter(ui_page_context_t* pctx, int drive) {
 //
 // Key callback
 //
-int position = 1;  // 現在の選択位置 (1-7)
 
 static void set_position(int pos, int drive) {
     ui_page_type_t page = (drive == 0) ? UI_PAGE_SETTING_FDDA : UI_PAGE_SETTING_FDDB;
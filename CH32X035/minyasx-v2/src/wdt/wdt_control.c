@@ -0,0 +1,96 @@
+#include "wdt/wdt_control.h"
+
+// IWDGのキー
+#define WDT_KEY_UNLOCK 0x5555  // PSCR/RLDRへの書き込みを許可
+#define WDT_KEY_RELOAD 0xAAAA  // カウンタをリロード
+#define WDT_KEY_START 0xCCCC   // ウォッチドッグを開始
+
+#define WDT_PRESCALER_256 6
+#define WDT_RELOAD ((uint32_t)WDT_TIMEOUT_MS * (WDT_LSI_HZ / 256) / 1000)
+
+#define WDT_NOINIT_MAGIC 0x57445430  // "WDT0"
+
+// リセットをまたいで保持する記録 (スタートアップコードでゼロクリアされない)
+typedef struct {
+    uint32_t magic;
+    uint16_t reset_count;
+    int8_t running;  // 実行中のタスク
+    int8_t late;     // 直近にデッドラインを超過したタスク
+    uint32_t check;  // 上記の簡易チェックサム
+} wdt_noinit_t;
+
+static wdt_noinit_t wdt_noinit __attribute__((section(".noinit")));
+
+static wdt_info_t wdt_info;
+
+static inline uint32_t wdt_noinit_checksum(const wdt_noinit_t* n) {
+    return n->magic ^ ((uint32_t)n->reset_count << 16) ^ ((uint32_t)(uint8_t)n->running << 8) ^ (uint8_t)n->late;
+}
+
+static inline void wdt_noinit_update(void) {
+    wdt_noinit.check = wdt_noinit_checksum(&wdt_noinit);
+}
+
+void wdt_init(void) {
+    uint32_t flags = RCC->RSTSCKR;
+    // リセット要因フラグをクリアしておく
+    RCC->RSTSCKR |= RCC_RMVF;
+
+    bool valid = (wdt_noinit.magic == WDT_NOINIT_MAGIC) && (wdt_noinit.check == wdt_noinit_checksum(&wdt_noinit));
+    if (!valid) {
+        // 電源投入直後はRAMの内容が不定なので初期化する
+        wdt_noinit.magic = WDT_NOINIT_MAGIC;
+        wdt_noinit.reset_count = 0;
+        wdt_noinit.running = WDT_NO_TASK;
+        wdt_noinit.late = WDT_NO_TASK;
+    }
+
+    wdt_info = (wdt_info_t){0};
+    wdt_info.offender = WDT_NO_TASK;
+    if (valid && (flags & RCC_IWDGRSTF)) {
+        wdt_info.wdt_reset = true;
+        wdt_noinit.reset_count++;
+        // タスクの実行中に止まったならそのタスク、そうでなければ直近にデッドラインを超過したタスク
+        wdt_info.offender = (wdt_noinit.running != WDT_NO_TASK) ? wdt_noinit.running : wdt_noinit.late;
+    }
+    wdt_info.reset_count = wdt_noinit.reset_count;
+
+    wdt_noinit.running = WDT_NO_TASK;
+    wdt_noinit.late = WDT_NO_TASK;
+    wdt_noinit_update();
+}
+
+void wdt_start(void) {
+    // IWDGのクロック(LSI)を有効にする
+    RCC->RSTSCKR |= RCC_LSION;
+    while ((RCC->RSTSCKR & RCC_LSIRDY) == 0);
+
+    IWDG->CTLR = WDT_KEY_UNLOCK;
+    IWDG->PSCR = WDT_PRESCALER_256;
+    IWDG->RLDR = WDT_RELOAD;
+    IWDG->CTLR = WDT_KEY_RELOAD;
+    IWDG->CTLR = WDT_KEY_START;
+}
+
+void wdt_feed(void) {
+    IWDG->CTLR = WDT_KEY_RELOAD;
+    wdt_info.feeds++;
+}
+
+void wdt_withhold(void) {
+    wdt_info.withheld++;
+}
+
+void wdt_mark_running(int8_t task_id) {
+    wdt_noinit.running = task_id;
+    wdt_noinit_update();
+}
+
+void wdt_mark_late(int8_t task_id) {
+    wdt_noinit.late = task_id;
+    wdt_noinit_update();
+}
+
+const wdt_info_t* wdt_get_info(void) {
+    return &wdt_info;
+}
@@ -0,0 +1,53 @@
+#ifndef WDT_CONTROL_H
+#define WDT_CONTROL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "minyasx.h"
+
+//
+// 独立ウォッチドッグ(IWDG)の制御
+//
+// メインループが止まったまま WDT_TIMEOUT_MS が経過するとリセットがかかる。
+// ウォッチドッグによるリセットの回数と、その直前に問題を起こしていたタスクのIDは
+// 初期化されないRAM(.noinit)に記録しておき、リセット後に参照できるようにする。
+//
+
+#define WDT_TIMEOUT_MS 4000  // ウォッチドッグのタイムアウト
+#define WDT_LSI_HZ 128000    // LSIの周波数 (typ.)
+
+#define WDT_NO_TASK (-1)
+
+typedef struct {
+    bool wdt_reset;        // 今回の起動がウォッチドッグによるリセットか
+    uint16_t reset_count;  // ウォッチドッグによるリセットの累計回数 (電源投入でクリア)
+    int8_t offender;       // 直前のウォッチドッグリセットの原因となったタスクID (不明ならWDT_NO_TASK)
+    uint32_t feeds;        // ウォッチドッグをリフレッシュした回数
+    uint32_t withheld;     // デッドライン超過のためリフレッシュを見送った回数
+} wdt_info_t;
+
+/**
+ * リセット要因を調べ、.noinit領域の記録を更新します
+ * (ウォッチドッグ自体はまだ開始しません)
+ */
+void wdt_init(void);
+
+/**
+ * ウォッチドッグを開始します。一度開始すると止められません
+ */
+void wdt_start(void);
+
+void wdt_feed(void);
+void wdt_withhold(void);
+
+/**
+ * 実行中のタスクと、直近にデッドラインを超過したタスクを記録します
+ * (ウォッチドッグリセット時の原因特定用)
+ */
+void wdt_mark_running(int8_t task_id);
+void wdt_mark_late(int8_t task_id);
+
+const wdt_info_t* wdt_get_info(void);
+
+#endif  // WDT_CONTROL_H
@@ -3,9 +3,12 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "build_profile.h"
+#include "event/event_queue.h"
 #include "greenpak/greenpak_control.h"
 #include "minyasx.h"
 #include "pcfdd/pcfdd_control.h"
+#include "timebase/timebase.h"
 #include "ui/ui_control.h"
 
 volatile uint32_t exti_int_counter = 0;
@@ -16,11 +19,13 @@ const bool double_option_B_always = false;  // 強制的にOPTION_SELECT_Bが両
 volatile bool double_option_A = double_option_A_always;
 volatile bool double_option_B = double_option_B_always;
 
-#define SYSTICK_INT_USEC 100  // SysTickの割り込み周期
-
 // 割り込みルーチンからコンテキストを参照できるようにする
 static minyasx_context_t* g_ctx = NULL;
 
+// GPIO割り込みだけでは対応できない処理のための周期タイマー
+static sw_timer_t x68fdd_tick_timer;
+static void x68fdd_tick(void* arg);
+
 void x68fdd_init(minyasx_context_t* ctx) {
     g_ctx = ctx;
     // X68000側からのアクセスに割り込みで応答するために、以下のGPIOの割り込みを設定する
@@ -73,32 +78,42 @@ void x68fdd_init(minyasx_context_t* ctx) {
     NVIC_SetPriority(EXTI15_8_IRQn, 1);  // 優先度を高くする
 
     //
-    // GPIO割り込みだけでは対応できない処理のために、SysTick割り込みを100usec単位で発生させる
+    // GPIO割り込みだけでは対応できない処理のために、タイマーを100usec周期で動かす
+    // (SysTick自体の設定は timebase_init() で行う)
     //
-    // Reset any pre-existing configuration
-    SysTick->CTLR = 0x0000;
-
-    // 100usec 単位で割り込みをかける、
-    SysTick->CMP = SYSTICK_INT_USEC * SYSTICK_ONE_MICROSECOND - 1;
-
-    // Reset the Count Register, and the global millis counter to 0
-    SysTick->CNT = 0x00000000;
-
-    // Set the SysTick Configuration
-    // NOTE: By not setting SYSTICK_CTLR_STRE, we maintain compatibility with
-    // busywait delay funtions used by ch32v003_fun.
-    SysTick->CTLR |= SYSTICK_CTLR_STE |   // Enable Counter
-                     SYSTICK_CTLR_STIE |  // Enable Interrupts
-                     SYSTICK_CTLR_STCLK;  // Set Clock Source to HCLK/1
-
-    // Enable the SysTick IRQ
-    NVIC_EnableIRQ(SysTicK_IRQn);
+    timer_start(&x68fdd_tick_timer, TIMEBASE_TICK_US, TIMEBASE_TICK_US, x68fdd_tick, NULL);
 
     // GP ENABLE
     // GPIOC->BSHR = (1 << 6);  // GP_ENABLE (High=Enable)
     GPIOC->BCR = (1 << 6);  // GP_ENABLE (Low=Disable)
 }
 
+// OPTION_SELECT時にサンプリングした EJECT_MASK / LED_BLINK の前回値 (割り込みルーチン専用)
+static uint16_t option_flags[2] = {0, 0};
+
+/**
+ * OPTION_SELECTの立ち上がりで EJECT(PA4), EJECT_MASK(PA5), LED_BLINK(PA8) をサンプリングし、
+ * 変化をイベントとしてメインループに通知する
+ */
+static inline void option_select_sampled(int drive, uint32_t porta) {
+    if ((porta & (1 << 4)) == 0) {  // EJECT (Low=Eject)
+        event_post(EVENT_EJECT_REQUEST, drive, 0);
+    }
+    uint16_t flags = 0;
+    if ((porta & (1 << 5)) == 0) {  // EJECT_MASK (Low=Mask)
+        flags |= EVENT_MASK_EJECT_MASKED;
+    }
+    if ((porta & (1 << 8)) == 0) {  // LED_BLINK (Low=Blink)
+        flags |= EVENT_MASK_LED_BLINK;
+    }
+    if (flags != option_flags[drive]) {
+        // 取りこぼした場合に再送できるよう、積めた場合のみ前回値を更新する
+        if (event_post(EVENT_MASK_CHANGE, drive, flags)) {
+            option_flags[drive] = flags;
+        }
+    }
+}
+
 /*
   EXTI 7-0 Global Interrupt Handler
  */
@@ -116,6 +131,7 @@ void EXTI7_0_IRQHandler(void) {
             // DRIVE_SELECT_A_nがHigh(無効)になった
             GPIOB->BCR = (1 << 2);                // DRIVE_SELECT_DOSV_A inactive (Low)
             pcfdd_set_current_ds(PCFDD_DS_NONE);  // 現在のドライブ選択をNoneにセット
+            event_post(EVENT_DRIVE_DESELECT, 0, 0);
         } else {
             // DRIVE_SELECT_A_nがLow(有効)になった
             if (double_option_A) {
@@ -126,6 +142,7 @@ void EXTI7_0_IRQHandler(void) {
             GPIOB->BCR = (1 << 3);            // DRIVE_SELECT_DOSV_B inactive (Low) to avoid both selected
             GPIOB->BSHR = (1 << 2);           // DRIVE_SELECT_DOSV_A active (High)
             pcfdd_set_current_ds(PCFDD_DS0);  // 現在のドライブ選択をAにセット
+            event_post(EVENT_DRIVE_SELECT, 0, 0);
         }
     }
     if (intfr & EXTI_INTF_INTF1) {
@@ -135,6 +152,7 @@ void EXTI7_0_IRQHandler(void) {
             // DRIVE_SELECT_B_nがHigh(無効)になった
             GPIOB->BCR = (1 << 3);                // DRIVE_SELECT_DOSV_B inactive (Low)
             pcfdd_set_current_ds(PCFDD_DS_NONE);  // 現在のドライブ選択をNoneにセット
+            event_post(EVENT_DRIVE_DESELECT, 1, 0);
         } else {
             // DRIVE_SELECT_B_nがLow(有効)になった
             if (double_option_B) {
@@ -145,45 +163,20 @@ void EXTI7_0_IRQHandler(void) {
             GPIOB->BCR = (1 << 2);            // DRIVE_SELECT_DOSV_A inactive (Low) to avoid both selected
             GPIOB->BSHR = (1 << 3);           // DRIVE_SELECT_DOSV_B active (High)
             pcfdd_set_current_ds(PCFDD_DS1);  // 現在のドライブ選択をBにセット
+            event_post(EVENT_DRIVE_SELECT, 1, 0);
         }
     }
     if (intfr & EXTI_INTF_INTF2) {
         // PA2 (OPTION_SELECT_A) の割り込み (立ち上がりのみ)
         EXTI->INTFR = EXTI_INTF_INTF2;  // フラグをクリア
-        // このタイミングで EJECT(PA4), EJECT_MASK(PA5), LED_BLINK(PA8)の状態を確認する
-        drive_status_t* drive = &g_ctx->drive[0];  // Aドライブ
-        if ((porta & (1 << 4)) == 0) {             // EJECT (Low=Eject)
-            pcfdd_force_eject(g_ctx, 0);           // Aドライブを強制排出
-        }
-        if ((porta & (1 << 5)) == 0) {  // EJECT_MASK (Low=Mask)
-            drive->eject_masked = true;
-        } else {
-            drive->eject_masked = false;
-        }
-        if ((porta & (1 << 8)) == 0) {  // LED_BLINK (Low=Blink)
-            drive->led_blink = true;    // LEDが点滅中
-        } else {
-            drive->led_blink = false;  // LEDが点滅中でない
-        }
+        // このタイミングで EJECT(PA4), EJECT_MASK(PA5), LED_BLINK(PA8)の状態を確認し、イベントとして通知する
+        option_select_sampled(0, porta);
     }
     if (intfr & EXTI_INTF_INTF3) {
         // PA3 (OPTION_SELECT_B) の割り込み (立ち上がりのみ)
         EXTI->INTFR = EXTI_INTF_INTF3;  // フラグをクリア
-        // このタイミングで EJECT(PA4), EJECT_MASK(PA5), LED_BLINK(PA8)の状態を確認する
-        drive_status_t* drive = &g_ctx->drive[1];  // Bドライブ
-        if ((porta & (1 << 4)) == 0) {             // EJECT (Low=Eject)
-            pcfdd_force_eject(g_ctx, 1);           // Bドライブを強制排出
-        }
-        if ((porta & (1 << 5)) == 0) {  // EJECT_MASK (Low=Mask)
-            drive->eject_masked = true;
-        } else {
-            drive->eject_masked = false;
-        }
-        if ((porta & (1 << 8)) == 0) {  // LED_BLINK (Low=Blink)
-            drive->led_blink = true;    // LEDが点滅中
-        } else {
-            drive->led_blink = false;  // LEDが点滅中でない
-        }
+        // このタイミングで EJECT(PA4), EJECT_MASK(PA5), LED_BLINK(PA8)の状態を確認し、イベントとして通知する
+        option_select_sampled(1, porta);
     }
 }
 
@@ -216,25 +209,19 @@ volatile uint32_t double_option_A_time = 0;
 volatile uint32_t double_option_B_time = 0;
 
 /*
- * SysTick ISR - must be lightweight to prevent the CPU from bogging down.
- * Increments Compare Register and systick_millis when triggered (every 1ms)
- * NOTE: the `__attribute__((interrupt))` attribute is very important
+ * 100usec周期のタイマー処理 (SysTick割り込みのコンテキストで呼ばれる)
+ * must be lightweight to prevent the CPU from bogging down.
  */
-void SysTick_Handler(void) __attribute__((interrupt));
-void SysTick_Handler(void) {
+static void x68fdd_tick(void* arg) {
+    (void)arg;
     systick_irq_counter++;
-    // Increment the Compare Register for the next trigger
-    // If more than this number of ticks elapse before the trigger is reset,
-    // you may miss your next interrupt trigger
-    // (Make sure the IQR is lightweight and CMP value is reasonable)
-    SysTick->CMP = SysTick->CNT + SYSTICK_INT_USEC * SYSTICK_ONE_MICROSECOND;
-
-    // Clear the trigger state for the next IRQ
-    SysTick->SR = 0x00000000;
 
     // GPIO割り込み(EXTI)の取りこぼしがあっても反映されるように保険をいれておく
     copy_drive_signals_to_dosv();
 
+    // INDEXタイムアウトとDISK_CHANGEの監視
+    pcfdd_systick_handler(time_cycles());
+
     // 9SCDRVサポート
     // OPTION SELECT 信号の同時アサートによる回転数変更に対応する
     // ●戦略
@@ -260,15 +247,15 @@ void SysTick_Handler(void) {
     //
     // OPTION_SELECT 同時アサートのローパスフィルタ
     //
-    const uint32_t min_duration_assert = SYSTICK_ONE_MICROSECOND * 300;      // usec
-    const uint32_t min_duration_deassert = SYSTICK_ONE_MICROSECOND * 30000;  // 30msec
+    const uint32_t min_duration_assert = TIME_US_TO_CYCLES(300);      // usec
+    const uint32_t min_duration_deassert = TIME_US_TO_CYCLES(30000);  // 30msec
     if (!double_option_A) {
         if (opt_a && opt_a_pair) {
             // OPTION SELECT Aとペアの両方がアサートされたので、計測
             if (double_option_A_time == 0) {
                 // 最初のアサート
-                double_option_A_time = SysTick->CNTL;
-            } else if ((SysTick->CNTL - double_option_A_time) > min_duration_assert) {
+                double_option_A_time = time_cycles();
+            } else if (time_elapsed(time_cycles(), double_option_A_time) > min_duration_assert) {
                 // 一定期間継続している
                 double_option_A = true;
                 double_option_A_time = 0;
@@ -283,8 +270,8 @@ void SysTick_Handler(void) {
             // OPTION SELECT Aのどちらかがディアサートされたので、計測
             if (double_option_A_time == 0) {
                 // 最初のディアサート
-                double_option_A_time = SysTick->CNTL;
-            } else if ((SysTick->CNTL - double_option_A_time) > min_duration_deassert) {
+                double_option_A_time = time_cycles();
+            } else if (time_elapsed(time_cycles(), double_option_A_time) > min_duration_deassert) {
                 // 一定期間継続している
                 double_option_A = double_option_A_always || false;
                 double_option_A_time = 0;
@@ -301,8 +288,8 @@ void SysTick_Handler(void) {
             // OPTION SELECT Bとペアの両方がアサートされたので、計測
             if (double_option_B_time == 0) {
                 // 最初のアサート
-                double_option_B_time = SysTick->CNTL;
-            } else if ((SysTick->CNTL - double_option_B_time) > min_duration_assert) {
+                double_option_B_time = time_cycles();
+            } else if (time_elapsed(time_cycles(), double_option_B_time) > min_duration_assert) {
                 // 一定期間継続している
                 double_option_B = true;
                 double_option_B_time = 0;
@@ -317,8 +304,8 @@ void SysTick_Handler(void) {
             // OPTION SELECT Bのどちらかがディアサートされたので、計測
             if (double_option_B_time == 0) {
                 // 最初のディアサート
-                double_option_B_time = SysTick->CNTL;
-            } else if ((SysTick->CNTL - double_option_B_time) > min_duration_deassert) {
+                double_option_B_time = time_cycles();
+            } else if (time_elapsed(time_cycles(), double_option_B_time) > min_duration_deassert) {
                 // 一定期間継続している
                 double_option_B = double_option_B_always || false;
                 double_option_B_time = 0;
@@ -330,6 +317,18 @@ void SysTick_Handler(void) {
         }
     }
 
+    // 回転数切り替えの判定結果が変わったらメインループに通知する
+    static bool last_double_option_A = double_option_A_always;
+    static bool last_double_option_B = double_option_B_always;
+    if (double_option_A != last_double_option_A) {
+        last_double_option_A = double_option_A;
+        event_post(EVENT_SPEED_CHANGE, 0, double_option_A ? FDD_RPM_300 : FDD_RPM_360);
+    }
+    if (double_option_B != last_double_option_B) {
+        last_double_option_B = double_option_B;
+        event_post(EVENT_SPEED_CHANGE, 1, double_option_B ? FDD_RPM_300 : FDD_RPM_360);
+    }
+
     //
     // DRIVE_SELECTの状態に応じてMODE_SELECT_DOSVを切り替える
     //
@@ -351,18 +350,17 @@ void SysTick_Handler(void) {
 }
 
 void x68fdd_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
-    // ポーリング処理をここに追加
-    static uint32_t last_tick = 0;
-    if (systick_ms - last_tick < 1000) {
-        return;
-    }
-    last_tick = systick_ms;
+    // 1秒周期のタスクとしてスケジューラから呼ばれる
 
     // OLEDに割り込み回数を表示する
     // ui_cursor(UI_PAGE_DEBUG, 0, 6);
     // ui_printf(UI_PAGE_DEBUG, "EXTI:%d", (int)exti_int_counter);
 
+#if FEATURE_DEBUG_PAGES
     // OPTION_SELECT_A/Bの状態をOLEDに表示する
+    if (ui_get_current_page() != UI_PAGE_DEBUG) {
+        return;
+    }
     ui_cursor(UI_PAGE_DEBUG, 0, 7);
     uint8_t opt_a = (GPIOA->INDR & GPIO_Pin_2) ? 1 : 0;
     uint8_t opt_b = (GPIOA->INDR & GPIO_Pin_3) ? 1 : 0;
@@ -371,6 +369,7 @@ void x68fdd_poll(minyasx_context_t* ctx, uint32_t systick_ms) {
     uint8_t amode = double_option_A ? 'Q' : 'D';
     uint8_t bmode = double_option_B ? 'Q' : 'D';
     ui_printf(UI_PAGE_DEBUG, "OP A%d%d%c B%d%d%c %d", opt_a, opt_a_pair, amode, opt_b, opt_b_pair, bmode, systick_irq_counter);
+#endif
 
     // EJECT, EJECT_MASK, LED_BLINKの監視はGPIO割り込みで行うのでここでは不要
 }
\ No newline at end of file
@@ -45,7 +45,22 @@ def parse_ihex(lines):
     for a,v in mem.items(): buf[a-mn]=v
     return mn, buf
 
+# 末尾16バイト(0xF0..0xFF)は書き込み保護などの領域なので検証しない (greenpak_auto.c と合わせる)
+VERIFY_TAIL = 0x10
+
+def crc16_ccitt(data, crc=0xFFFF):
+    # CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if (crc & 0x8000) else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
 def emit(idx, base, image):
+    verify_size = max(0, len(image) - VERIFY_TAIL)
+    # イメージ全体の短いハッシュ。書き込み時にGreenPAKのEEPROMに記録し、起動時はこれだけを読んで比較する
+    stamp = crc16_ccitt(image) if image else 0
     h = outdir / f"greenpak{idx}.h"
     c = outdir / f"greenpak{idx}.c"
     with h.open("w") as fh:
@@ -53,6 +68,8 @@ def emit(idx, base, image):
 #include <stdint.h>
 #define GREENPAK{idx}_BASE 0x{base:04X}
 #define GREENPAK{idx}_SIZE {len(image)}
+#define GREENPAK{idx}_VERIFY_SIZE {verify_size}
+#define GREENPAK{idx}_STAMP 0x{stamp:04X}
 extern const uint8_t GREENPAK{idx}_IMAGE[GREENPAK{idx}_SIZE];
 """)
     def rows(b):
@@ -66,7 +83,7 @@ const uint8_t GREENPAK{idx}_IMAGE[GREENPAK{idx}_SIZE] = {{
 {rows(image)}
 }};
 """)
-    print(f"[hex4] greenpak{idx}: base=0x{base:04X} size={len(image)} -> {h.name}, {c.name}")
+    print(f"[hex4] greenpak{idx}: base=0x{base:04X} size={len(image)} stamp=0x{stamp:04X} -> {h.name}, {c.name}")
 
 for i in range(1,5):
     ip = pick_input(i)
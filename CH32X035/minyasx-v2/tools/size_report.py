@@ -0,0 +1,93 @@
+# tools/size_report.py
+#
+# ビルドしたファームウェアのフラッシュ/RAMの使用量を表示する
+#
+# PlatformIOの extra_scripts (post:) から読み込むと、リンクの後にその環境の使用量を表示する。
+# 単体で実行すると、複数のビルドプロファイルの使用量を並べて比較できる:
+#   python tools/size_report.py .pio/build/CH32X035-release .pio/build/CH32X035-diagnostic .pio/build/CH32X035-lab
+#
+# ループ時間は実機でしか測れないので、フラッシュログの LOOPM レコード(電源OFF時点の最大ループ周期)か、
+# labプロファイルのスケジューラのデバッグページで確認する。
+import os
+import subprocess
+import sys
+from pathlib import Path
+
+FLASH_SIZE = 60 * 1024  # ld/ch32x035.ld の FLASH (末尾2Kはフラッシュログ)
+RAM_SIZE = 20 * 1024
+TOP_SYMBOLS = 10  # 大きいシンボルを何個表示するか
+
+FLASH_SECTIONS = (".init", ".vector", ".text", ".rodata", ".data")
+RAM_SECTIONS = (".data", ".bss")
+
+
+def section_sizes(size_tool, elf):
+    # size -A の出力から セクション名 → バイト数 を作る
+    out = subprocess.run([size_tool, "-A", str(elf)], capture_output=True, text=True, check=True).stdout
+    sizes = {}
+    for line in out.splitlines():
+        cols = line.split()
+        if len(cols) >= 2 and cols[0].startswith(".") and cols[1].isdigit():
+            sizes[cols[0]] = int(cols[1])
+    return sizes
+
+
+def top_symbols(nm_tool, elf, n):
+    # nm --size-sort で大きい順に n 個
+    out = subprocess.run([nm_tool, "-S", "--size-sort", "-r", "-C", str(elf)], capture_output=True, text=True)
+    syms = []
+    for line in out.stdout.splitlines():
+        cols = line.split()
+        if len(cols) >= 4:
+            syms.append((int(cols[1], 16), cols[2], cols[3]))
+        if len(syms) >= n:
+            break
+    return syms
+
+
+def usage(sizes):
+    flash = sum(sizes.get(s, 0) for s in FLASH_SECTIONS)
+    ram = sum(sizes.get(s, 0) for s in RAM_SECTIONS)
+    return flash, ram
+
+
+def report(name, size_tool, nm_tool, elf):
+    sizes = section_sizes(size_tool, elf)
+    flash, ram = usage(sizes)
+    print(f"[size] {name}")
+    print(f"[size]   FLASH {flash:6d} / {FLASH_SIZE} ({flash * 100 / FLASH_SIZE:5.1f}%)")
+    print(f"[size]   RAM   {ram:6d} / {RAM_SIZE} ({ram * 100 / RAM_SIZE:5.1f}%)  data={sizes.get('.data', 0)} bss={sizes.get('.bss', 0)}")
+    for size, kind, sym in top_symbols(nm_tool, elf, TOP_SYMBOLS):
+        print(f"[size]   {size:6d} {kind} {sym}")
+    if flash > FLASH_SIZE:
+        print("[size]   ERROR: FLASH overflow (the flash log area would be overwritten)")
+
+
+def tool_path(prefix, name):
+    return f"{prefix}{name}" if prefix else name
+
+
+if __name__ == "__main__":
+    # 単体で実行: 引数はビルドディレクトリかELFファイル
+    prefix = os.environ.get("CROSS_PREFIX", "riscv-none-elf-")
+    rows = []
+    for arg in sys.argv[1:]:
+        p = Path(arg)
+        elf = p / "firmware.elf" if p.is_dir() else p
+        name = p.name if p.is_dir() else p.stem
+        flash, ram = usage(section_sizes(tool_path(prefix, "size"), elf))
+        rows.append((name, flash, ram))
+    print(f"{'profile':24s} {'FLASH':>7s} {'RAM':>7s}")
+    for name, flash, ram in rows:
+        print(f"{name:24s} {flash:7d} {ram:7d}")
+else:
+    # PlatformIOから読み込まれた: リンクの後に表示する
+    Import("env")
+
+    def after_link(source, target, env):
+        elf = Path(str(target[0]))
+        size_tool = env.subst("$SIZETOOL")
+        nm_tool = size_tool[: -len("size")] + "nm" if size_tool.endswith("size") else "nm"
+        report(env["PIOENV"], size_tool, nm_tool, elf)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", after_link)
@@ -0,0 +1,114 @@
+# tools/telemetry_decode.py
+#
+# デバッグリンク(SWIO)に流れるテレメトリ(src/telemetry/telemetry.h)を、CSVかJSONに変換する
+#
+# minichlink の端末モードの出力をそのまま読む。チェックサムが合わない行とレコード以外の行は捨てる。
+#   minichlink -T | python tools/telemetry_decode.py --json > run.jsonl
+#   minichlink -T > run.log    (長時間の記録はファイルに残しておき、後で変換する)
+#   python tools/telemetry_decode.py --csv out/ run.log
+#
+# --json (既定): 1レコード1行のJSON (JSON Lines)。"type" にレコードの種類が入る
+# --csv DIR    : レコードの種類ごとに DIR/<種類>.csv を作る (列が種類ごとに違うため)
+import argparse
+import csv
+import json
+import sys
+from pathlib import Path
+
+# レコードの種類ごとの列名 (telemetry.c の printF の順番と合わせること)
+FIELDS = {
+    "EV": ["time_us", "event", "drive", "arg"],
+    "ST": ["time_ms", "idle_pct", "busy_us", "loops", "max_loop_us",
+           "ev_posted", "ev_dropped", "i2c_errors", "i2c_recoveries", "tlm_dropped"],
+    "PW": ["time_ms", "vbus_mv", "vbus_ma", "v12_mv", "v12_ma", "v5_mv", "v5_ma"],
+    "HI": ["time_ms", "drive", "c7", "c8", "c10", "c13", "c16", "other"],
+    "LG": ["time_ms", "level", "message"],
+    "FL": ["seq", "boot", "time_ms", "kind", "arg"],
+}
+HEX_FIELDS = {"arg"}  # 16進で送られる列
+TEXT_FIELDS = {"event", "level", "message", "kind"}
+
+
+def parse_line(line):
+    # "$TYP,a,b,...*CS" を (種類, 値のリスト) にする。壊れていれば None
+    start = line.find("$")
+    star = line.rfind("*")
+    if start < 0 or star < start or len(line) < star + 3:
+        return None
+    body = line[start + 1:star]
+    cs = 0
+    for ch in body:
+        cs ^= ord(ch)
+    try:
+        if cs != int(line[star + 1:star + 3], 16):
+            return None
+    except ValueError:
+        return None
+    cols = body.split(",")
+    return cols[0], cols[1:]
+
+
+def to_record(typ, values):
+    if typ == "LG":
+        # ログは "<ms> <レベル> <メッセージ>" の1列 (メッセージに , が入ることがある)
+        values = ",".join(values).split(" ", 2)
+        if len(values) == 2:
+            values.append("")
+    names = FIELDS.get(typ)
+    if names is None or len(names) != len(values):
+        return None
+    rec = {"type": typ}
+    for name, v in zip(names, values):
+        if name in TEXT_FIELDS:
+            rec[name] = v
+        else:
+            rec[name] = int(v, 16 if name in HEX_FIELDS else 10)
+    return rec
+
+
+def records(stream, counts):
+    for line in stream:
+        line = line.strip()
+        if not line:
+            continue
+        parsed = parse_line(line)
+        rec = to_record(*parsed) if parsed else None
+        if rec is None:
+            counts["bad"] += 1
+            continue
+        counts["ok"] += 1
+        yield rec
+
+
+def main():
+    ap = argparse.ArgumentParser(description="MinyasX telemetry decoder")
+    ap.add_argument("input", nargs="?", help="minichlink -T の出力 (省略時は標準入力)")
+    ap.add_argument("--json", action="store_true", help="JSON Lines で標準出力に書く (既定)")
+    ap.add_argument("--csv", metavar="DIR", help="種類ごとのCSVをDIRに書く")
+    args = ap.parse_args()
+
+    stream = open(args.input, encoding="utf-8", errors="replace") if args.input else sys.stdin
+    counts = {"ok": 0, "bad": 0}
+    if args.csv:
+        outdir = Path(args.csv)
+        outdir.mkdir(parents=True, exist_ok=True)
+        files, writers = {}, {}
+        try:
+            for rec in records(stream, counts):
+                typ = rec.pop("type")
+                if typ not in writers:
+                    files[typ] = open(outdir / f"{typ}.csv", "w", newline="")
+                    writers[typ] = csv.DictWriter(files[typ], fieldnames=FIELDS[typ])
+                    writers[typ].writeheader()
+                writers[typ].writerow(rec)
+        finally:
+            for f in files.values():
+                f.close()
+    else:
+        for rec in records(stream, counts):
+            print(json.dumps(rec), flush=True)
+    print(f"[telemetry] {counts['ok']} records, {counts['bad']} bad lines", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()